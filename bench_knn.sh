@@ -0,0 +1,3 @@
+#!/usr/bin/env bash
+
+cd build/cmake_unix; cmake ../..; make bench_knn; ./bench_knn "$@";
@@ -0,0 +1,184 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "hnswindex.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+static inline double seconds_since(bench_clock::time_point start) {
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+// Names of the Java `Metrics` and `Precision` constants
+static inline std::string distance_name(Distance distance) {
+    switch (distance) {
+        case Euclidean: return "Euclidean";
+        case Angular: return "Angular";
+        case InnerProduct: return "DotProduct";
+        case Kendall: return "Kendall";
+        default: return std::to_string(distance);
+    }
+}
+
+static inline std::string precision_name(Precision precision) {
+    switch (precision) {
+        case Float32: return "float32";
+        case Float16: return "float16";
+        case Float8: return "float8";
+        case PQ: return "pq";
+        case Float4: return "float4";
+        case BFloat16: return "bfloat16";
+        case Int8Symmetric: return "int8";
+        case Binary: return "binary";
+        default: return std::to_string(precision);
+    }
+}
+
+/**
+ * One result per line as a JSON object, written when the result goes out of scope, so that runs
+ * can be compared with `jq` or loaded in a dataframe.
+ **/
+class BenchResult {
+    std::ostringstream fields_;
+
+    std::ostringstream &next(const std::string &key) {
+        if (fields_.tellp() > 0)
+            fields_ << ',';
+        fields_ << '"' << key << "\":";
+        return fields_;
+    }
+
+public:
+    explicit BenchResult(const std::string &group) {
+        add("group", group);
+    }
+
+    BenchResult &add(const std::string &key, const std::string &value) {
+        next(key) << '"' << value << '"';
+        return *this;
+    }
+
+    BenchResult &add(const std::string &key, const char *value) {
+        return add(key, std::string(value));
+    }
+
+    BenchResult &add(const std::string &key, double value) {
+        next(key) << value;
+        return *this;
+    }
+
+    BenchResult &add(const std::string &key, size_t value) {
+        next(key) << value;
+        return *this;
+    }
+
+    ~BenchResult() {
+        printf("{%s}\n", fields_.str().c_str());
+        fflush(stdout);
+    }
+};
+
+// Sorted in place
+static inline double percentile(std::vector<double> &values, double p) {
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    const auto index = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    return values[index];
+}
+
+static inline std::vector<std::vector<float>> random_vectors(size_t nb, size_t dim, size_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(-1, 1);
+    std::vector<std::vector<float>> vectors(nb, std::vector<float>(dim));
+    for (auto &vector: vectors) {
+        for (auto &x: vector) {
+            x = uniform(rng);
+        }
+    }
+    return vectors;
+}
+
+/**
+ * Vectors of a dataset file, at most `limit` of them:
+ *
+ *  * `fvecs` / `bvecs` - each vector is its int32 dimension followed by its float32 / uint8 components
+ *  * `raw` - float32 components of `dim` dimensions, back to back
+ **/
+static inline std::vector<std::vector<float>>
+read_vectors(const std::string &path, const std::string &format, size_t dim, size_t limit) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input.is_open())
+        throw std::runtime_error("Cannot open file " + path);
+    if (format != "fvecs" && format != "bvecs" && format != "raw")
+        throw std::runtime_error("Unknown vectors format " + format);
+    std::vector<std::vector<float>> vectors;
+    std::vector<uint8_t> bytes;
+    while (vectors.size() < limit) {
+        if (format != "raw") {
+            int32_t header;
+            if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)))
+                break;
+            if (header <= 0 || (dim != 0 && static_cast<size_t>(header) != dim))
+                throw std::runtime_error("Unexpected dimension " + std::to_string(header) + " in " + path);
+            dim = header;
+        } else if (dim == 0) {
+            throw std::runtime_error("The dimension of raw vectors must be given");
+        }
+        std::vector<float> vector(dim);
+        if (format == "bvecs") {
+            bytes.resize(dim);
+            if (!input.read(reinterpret_cast<char *>(bytes.data()), dim))
+                break;
+            std::copy(bytes.begin(), bytes.end(), vector.begin());
+        } else if (!input.read(reinterpret_cast<char *>(vector.data()), dim * sizeof(float))) {
+            break;
+        }
+        vectors.push_back(std::move(vector));
+    }
+    return vectors;
+}
+
+// Format from the extension, raw float32 for any other
+static inline std::string vectors_format(const std::string &path) {
+    for (auto format: {"fvecs", "bvecs"}) {
+        const std::string extension = std::string(".") + format;
+        if (path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0)
+            return format;
+    }
+    return "raw";
+}
+
+// Trained precisions learn their ranges or codebooks from the vectors, normalized as they will be added
+static inline void train_space(Index<float> &index, const std::vector<std::vector<float>> &vectors) {
+    if (!index.space->needs_initialization())
+        return;
+    std::vector<float> normalized;
+    for (auto &vector: vectors) {
+        index.space->train(index.normalizeItem(const_cast<float *>(vector.data()), normalized));
+    }
+}
+
+// Items added from `nb_threads` threads, labelled by their position
+static inline void add_items(Index<float> &index, const std::vector<std::vector<float>> &vectors, size_t nb_threads) {
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nb_threads; t++) {
+        threads.emplace_back([&index, &vectors, &next]() {
+            for (size_t id = next++; id < vectors.size(); id = next++) {
+                index.addItem(const_cast<float *>(vectors[id].data()), id);
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+}
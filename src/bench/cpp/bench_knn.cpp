@@ -0,0 +1,255 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include "bench_common.h"
+
+/**
+ * Native benchmarks of the kernels and of the index, without the JNI and allocations measured by
+ * the JMH ones. Results are written to stdout as JSON lines, progress to stderr.
+ *
+ *   bench_knn [--only distance,encoding,search,build,load] [--quick] [--items N] [--queries N]
+ *             [--dim D] [--threads T] [--path index_file]
+ *
+ *  * `distance` - ns per distance for every Distance x Precision x dimension, stored against
+ *    stored (`dist`) and prepared query against stored (`search`)
+ *  * `encoding` - ns per vector encoded and decoded by every precision
+ *  * `search` - latency percentiles and QPS of k=10 searches at several ef
+ *  * `build` - items inserted per second with 1 to T threads
+ *  * `load` - seconds to load a saved index, as is or converted from float32
+ **/
+
+struct BenchOptions {
+    std::set<std::string> groups {"distance", "encoding", "search", "build", "load"};
+    double min_seconds = 0.2;
+    size_t nb_items = 20000;
+    size_t nb_queries = 1000;
+    size_t dim = 128;
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string path = "./bench_knn.bin";
+    std::vector<size_t> kernel_dims {32, 64, 100, 128, 256, 384, 768};
+    std::vector<size_t> efs {10, 20, 40, 80, 160, 320};
+    const size_t k = 10;
+    const size_t M = 16;
+    const size_t ef_construction = 200;
+    const size_t seed = 42;
+};
+
+// Calls `func(i)` in batches until `min_seconds` passed, returns ns per call
+template<typename FUNC>
+static double ns_per_call(double min_seconds, FUNC func) {
+    const size_t batch = 256;
+    size_t calls = 0;
+    const auto start = bench_clock::now();
+    double elapsed = 0;
+    do {
+        for (size_t i = 0; i < batch; i++) {
+            func(calls + i);
+        }
+        calls += batch;
+        elapsed = seconds_since(start);
+    } while (elapsed < min_seconds);
+    return 1e9 * elapsed / calls;
+}
+
+static bool supports(Distance distance, Precision precision, size_t dim) {
+    if (distance != Kendall)
+        return true;
+    return precision == Float32 || precision == Float16 || (precision == Float8 && dim <= 256);
+}
+
+// Keeps the compiler from dropping the distances
+static volatile float sink;
+
+static void bench_distances(const BenchOptions &options) {
+    const size_t nb_vectors = 256;
+    for (auto dim: options.kernel_dims) {
+        const auto vectors = random_vectors(nb_vectors, dim, options.seed);
+        for (auto distance: {Euclidean, Angular, InnerProduct, Kendall}) {
+            for (auto precision: {Float32, Float16, BFloat16, Float8, Float4, Int8Symmetric, PQ, Binary}) {
+                if (!supports(distance, precision, dim))
+                    continue;
+                std::cerr << "distance " << distance_name(distance) << " " << precision_name(precision) << " " << dim << "\n";
+                Index<float> index(distance, dim, precision);
+                std::vector<std::vector<float>> items;
+                for (auto &vector: vectors) {
+                    std::vector<float> normalized;
+                    const auto item = index.normalizeItem(const_cast<float *>(vector.data()), normalized);
+                    items.emplace_back(item, item + dim);
+                }
+                train_space(index, items);
+                const auto data_size = index.space->get_data_size();
+                std::vector<char> encoded(nb_vectors * data_size);
+                for (size_t i = 0; i < nb_vectors; i++) {
+                    const auto dst = encoded.data() + i * data_size;
+                    const auto src = index.encode(items[i].data(), dst);
+                    if (src != dst)
+                        memcpy(dst, src, data_size);
+                }
+                const auto dist_func = index.space->get_dist_func();
+                const auto search_func = index.space->get_search_dist_func();
+                const auto param = index.space->get_dist_func_param();
+                std::vector<char> query_buffer;
+                const auto query = index.space->prepare_query(items[0].data(), query_buffer);
+                const auto item = [&encoded, data_size](size_t i) { return encoded.data() + (i % nb_vectors) * data_size; };
+                const auto dist_ns = ns_per_call(options.min_seconds, [&](size_t i) {
+                    sink = dist_func(item(i), item(i + 1), param);
+                });
+                const auto search_ns = ns_per_call(options.min_seconds, [&](size_t i) {
+                    sink = search_func(query, item(i), param);
+                });
+                BenchResult("distance").add("distance", distance_name(distance)).add("precision", precision_name(precision))
+                    .add("dim", dim).add("data_size", data_size).add("dist_ns", dist_ns).add("search_ns", search_ns);
+            }
+        }
+    }
+}
+
+static void bench_encoding(const BenchOptions &options) {
+    const size_t nb_vectors = 256;
+    for (auto dim: options.kernel_dims) {
+        const auto vectors = random_vectors(nb_vectors, dim, options.seed);
+        for (auto precision: {Float16, BFloat16, Float8, Float4, Int8Symmetric, PQ, Binary}) {
+            std::cerr << "encoding " << precision_name(precision) << " " << dim << "\n";
+            Index<float> index(Euclidean, dim, precision);
+            train_space(index, vectors);
+            const auto data_size = index.space->get_data_size();
+            std::vector<char> encoded(nb_vectors * data_size);
+            std::vector<float> decoded(dim);
+            const auto encode_ns = ns_per_call(options.min_seconds, [&](size_t i) {
+                index.encode(const_cast<float *>(vectors[i % nb_vectors].data()), encoded.data() + (i % nb_vectors) * data_size);
+            });
+            const auto decode_ns = ns_per_call(options.min_seconds, [&](size_t i) {
+                sink = index.decode(encoded.data() + (i % nb_vectors) * data_size, decoded.data())[0];
+            });
+            BenchResult("encoding").add("precision", precision_name(precision)).add("dim", dim)
+                .add("encode_ns", encode_ns).add("decode_ns", decode_ns)
+                .add("decode_gbps", dim * sizeof(float) / decode_ns);
+        }
+    }
+}
+
+static void bench_search(const BenchOptions &options, const std::vector<std::vector<float>> &items,
+                         const std::vector<std::vector<float>> &queries) {
+    for (auto distance: {Euclidean, InnerProduct}) {
+        for (auto precision: {Float32, Float16, Int8Symmetric}) {
+            std::cerr << "search " << distance_name(distance) << " " << precision_name(precision) << "\n";
+            Index<float> index(distance, options.dim, precision);
+            train_space(index, items);
+            index.initNewIndex(items.size(), options.M, options.ef_construction, options.seed);
+            add_items(index, items, options.max_threads);
+            std::vector<size_t> labels(options.k);
+            std::vector<float> distances(options.k);
+            std::vector<float *> pointers(options.k);
+            for (auto ef: options.efs) {
+                index.setEf(ef);
+                std::vector<double> latencies;
+                const auto start = bench_clock::now();
+                for (auto &query: queries) {
+                    const auto query_start = bench_clock::now();
+                    index.knnQuery(const_cast<float *>(query.data()), labels.data(), distances.data(), pointers.data(), options.k);
+                    latencies.push_back(1e6 * seconds_since(query_start));
+                }
+                const auto elapsed = seconds_since(start);
+                BenchResult("search").add("distance", distance_name(distance)).add("precision", precision_name(precision))
+                    .add("dim", options.dim).add("items", items.size()).add("k", options.k).add("ef", ef)
+                    .add("inlined", index.inlined_search != nullptr ? "true" : "false")
+                    .add("qps", queries.size() / elapsed).add("mean_us", 1e6 * elapsed / queries.size())
+                    .add("p50_us", percentile(latencies, 0.5)).add("p99_us", percentile(latencies, 0.99));
+            }
+        }
+    }
+}
+
+static void bench_build(const BenchOptions &options, const std::vector<std::vector<float>> &items) {
+    for (size_t threads = 1; threads <= options.max_threads; threads *= 2) {
+        std::cerr << "build " << threads << " threads\n";
+        Index<float> index(Euclidean, options.dim, Float32);
+        index.initNewIndex(items.size(), options.M, options.ef_construction, options.seed);
+        const auto start = bench_clock::now();
+        add_items(index, items, threads);
+        const auto elapsed = seconds_since(start);
+        BenchResult("build").add("distance", distance_name(Euclidean)).add("precision", precision_name(Float32))
+            .add("dim", options.dim).add("items", items.size()).add("M", options.M)
+            .add("ef_construction", options.ef_construction).add("threads", threads)
+            .add("seconds", elapsed).add("items_per_second", items.size() / elapsed);
+    }
+}
+
+static void bench_load(const BenchOptions &options, const std::vector<std::vector<float>> &items) {
+    std::cerr << "load\n";
+    {
+        Index<float> index(Euclidean, options.dim, Float32);
+        index.initNewIndex(items.size(), options.M, options.ef_construction, options.seed);
+        add_items(index, items, options.max_threads);
+        index.saveIndex(options.path);
+    }
+    // Float32 is read as is, the others are encoded from the float32 vectors of the file
+    for (auto precision: {Float32, Float16, BFloat16, Int8Symmetric}) {
+        Index<float> index(Euclidean, options.dim, precision);
+        train_space(index, items);
+        const auto start = bench_clock::now();
+        index.loadIndex(options.path);
+        const auto elapsed = seconds_since(start);
+        BenchResult("load").add("distance", distance_name(Euclidean)).add("precision", precision_name(precision))
+            .add("dim", options.dim).add("items", index.getNbItems()).add("seconds", elapsed);
+    }
+    std::remove(options.path.c_str());
+}
+
+static std::vector<std::string> split(const std::string &list) {
+    std::vector<std::string> values;
+    std::istringstream input(list);
+    std::string value;
+    while (std::getline(input, value, ',')) {
+        values.push_back(value);
+    }
+    return values;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const auto has_value = i + 1 < argc;
+        if (arg == "--quick") {
+            options.min_seconds = 0.02;
+            options.nb_items = 2000;
+            options.nb_queries = 200;
+        } else if (arg == "--only" && has_value) {
+            const auto groups = split(argv[++i]);
+            options.groups = std::set<std::string>(groups.begin(), groups.end());
+        } else if (arg == "--items" && has_value) {
+            options.nb_items = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--queries" && has_value) {
+            options.nb_queries = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--dim" && has_value) {
+            options.dim = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--threads" && has_value) {
+            options.max_threads = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--path" && has_value) {
+            options.path = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--only distance,encoding,search,build,load] [--quick]"
+                      << " [--items N] [--queries N] [--dim D] [--threads T] [--path index_file]\n";
+            return 1;
+        }
+    }
+    BenchResult("config").add("avx2", hnswlib::cpu_supports_avx2_fma() ? "true" : "false")
+        .add("avx512", hnswlib::cpu_supports_avx512() ? "true" : "false")
+        .add("threads", options.max_threads).add("compiler", __VERSION__);
+
+    if (options.groups.count("distance"))
+        bench_distances(options);
+    if (options.groups.count("encoding"))
+        bench_encoding(options);
+    const auto items = random_vectors(options.nb_items, options.dim, options.seed);
+    const auto queries = random_vectors(options.nb_queries, options.dim, options.seed + 1);
+    if (options.groups.count("search"))
+        bench_search(options, items, queries);
+    if (options.groups.count("build"))
+        bench_build(options, items);
+    if (options.groups.count("load"))
+        bench_load(options, items);
+    return 0;
+}
@@ -0,0 +1,301 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <unordered_set>
+#include "bench_common.h"
+
+/**
+ * Recall against QPS of an index over a sweep of ef, to pick M, ef_construction and ef.
+ *
+ *   knn_sweep --data items.fvecs [--queries queries.fvecs] [--index saved_index] [--save saved_index]
+ *             [--distance Euclidean] [--precision float32] [--M 16] [--ef-construction 200]
+ *             [--ef 10,20,40,80,160,320] [--k 10] [--nb-queries 1000] [--limit N] [--dim D]
+ *             [--threads T] [--format csv|json]
+ *
+ * The index is loaded from `--index` or built from the items of `--data`. Queries come from
+ * `--queries`, or are the last `--nb-queries` vectors of `--data`, then left out of the index.
+ * Files are read as fvecs or bvecs from their extension, as raw float32 of `--dim` otherwise.
+ *
+ * The ground truth is the exact k nearest items of the index (`BruteforceSearchAlg`), so recall
+ * is the one of the graph, distances being those of the encoded vectors. For each ef, reports
+ * recall@k, single thread QPS, p50/p99 latency and distances computed per query.
+ **/
+
+struct SweepOptions {
+    std::string data_path;
+    std::string queries_path;
+    std::string index_path;
+    std::string save_path;
+    Distance distance = Euclidean;
+    Precision precision = Float32;
+    size_t M = 16;
+    size_t ef_construction = 200;
+    std::vector<size_t> efs {10, 20, 40, 80, 160, 320};
+    size_t k = 10;
+    size_t nb_queries = 1000;
+    size_t limit = std::numeric_limits<size_t>::max();
+    size_t dim = 0;
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string format = "csv";
+    const size_t seed = 42;
+};
+
+// Search distance of the space, counting the vectors it is called on
+struct CountingDistance : hnswlib::SearchDistFunc<float> {
+    CountingDistance(hnswlib::SpaceInterface<float> *space, size_t *count)
+        : SearchDistFunc(space->get_search_dist_func(), space->get_search_dist_batch_func(), space->get_dist_func_param()),
+          count(count) {}
+
+    inline float operator()(const void *query_data, const void *data) const {
+        (*count)++;
+        return SearchDistFunc::operator()(query_data, data);
+    }
+
+    inline void operator()(const void *query_data, const void *const *data, size_t n, float *out) const {
+        *count += n;
+        SearchDistFunc::operator()(query_data, data, n, out);
+    }
+
+    size_t *count;
+};
+
+// Distances computed by the graph search of `query`, with 64-bit labels as the tool never sets compact ones
+static size_t count_distances(Index<float> &index, const std::vector<float> &query, size_t k) {
+    std::vector<float> normalized;
+    std::vector<char> query_buffer;
+    const auto query_data = index.space->prepare_query(index.normalizeItem(const_cast<float *>(query.data()), normalized), query_buffer);
+    size_t count = 0;
+    const auto alg = static_cast<const hnswlib::HierarchicalNSW<float> *>(index.appr_alg);
+    alg->searchKnn(query_data, k, CountingDistance(index.space, &count));
+    return count;
+}
+
+// Labels of the exact k nearest items of each query, computed from `nb_threads` threads
+static std::vector<std::unordered_set<size_t>>
+ground_truth(Index<float> &index, const std::vector<std::vector<float>> &queries, size_t k, size_t nb_threads) {
+    index.enableBruteforceSearch();
+    std::vector<std::unordered_set<size_t>> truth(queries.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nb_threads; t++) {
+        threads.emplace_back([&]() {
+            std::vector<size_t> labels(k);
+            std::vector<float> distances(k);
+            std::vector<float *> pointers(k);
+            for (size_t id = next++; id < queries.size(); id = next++) {
+                const auto nb_results = index.knnQuery<true>(const_cast<float *>(queries[id].data()), labels.data(),
+                                                             distances.data(), pointers.data(), k);
+                truth[id].insert(labels.begin(), labels.begin() + nb_results);
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    return truth;
+}
+
+/**
+ * Rows of the sweep, as CSV with a header before the first row, or as JSON lines
+ **/
+class SweepWriter {
+    const std::string format_;
+    bool header_written_ = false;
+    std::vector<std::pair<std::string, std::string>> fields_;
+
+public:
+    explicit SweepWriter(const std::string &format) : format_(format) {}
+
+    SweepWriter &add(const std::string &key, const std::string &value) {
+        fields_.emplace_back(key, format_ == "json" ? '"' + value + '"' : value);
+        return *this;
+    }
+
+    SweepWriter &add(const std::string &key, double value) {
+        std::ostringstream output;
+        output << value;
+        fields_.emplace_back(key, output.str());
+        return *this;
+    }
+
+    SweepWriter &add(const std::string &key, size_t value) {
+        fields_.emplace_back(key, std::to_string(value));
+        return *this;
+    }
+
+    void write() {
+        std::ostringstream line;
+        if (format_ == "json") {
+            for (size_t i = 0; i < fields_.size(); i++) {
+                line << (i == 0 ? "{" : ",") << '"' << fields_[i].first << "\":" << fields_[i].second;
+            }
+            line << "}";
+        } else {
+            if (!header_written_) {
+                for (size_t i = 0; i < fields_.size(); i++) {
+                    line << (i == 0 ? "" : ",") << fields_[i].first;
+                }
+                line << "\n";
+                header_written_ = true;
+            }
+            for (size_t i = 0; i < fields_.size(); i++) {
+                line << (i == 0 ? "" : ",") << fields_[i].second;
+            }
+        }
+        printf("%s\n", line.str().c_str());
+        fflush(stdout);
+        fields_.clear();
+    }
+};
+
+static void sweep(const SweepOptions &options) {
+    const auto data_format = vectors_format(options.data_path);
+    auto items = options.data_path.empty() ? std::vector<std::vector<float>>()
+        : read_vectors(options.data_path, data_format, options.dim, options.limit);
+    std::vector<std::vector<float>> queries;
+    if (!options.queries_path.empty()) {
+        queries = read_vectors(options.queries_path, vectors_format(options.queries_path), options.dim, options.nb_queries);
+    } else {
+        if (items.size() <= options.nb_queries)
+            throw std::runtime_error("Not enough vectors to leave " + std::to_string(options.nb_queries) + " queries out");
+        queries.assign(items.end() - options.nb_queries, items.end());
+        items.resize(items.size() - options.nb_queries);
+    }
+    if (queries.empty())
+        throw std::runtime_error("No queries");
+    const auto dim = queries[0].size();
+
+    Index<float> index(options.distance, dim, options.precision);
+    train_space(index, items);
+    double build_seconds = 0;
+    if (!options.index_path.empty()) {
+        std::cerr << "loading " << options.index_path << "\n";
+        index.loadIndex(options.index_path);
+    } else {
+        if (items.empty())
+            throw std::runtime_error("No items to build the index from");
+        std::cerr << "building from " << items.size() << " items of " << dim << " dimensions\n";
+        index.initNewIndex(items.size(), options.M, options.ef_construction, options.seed);
+        const auto start = bench_clock::now();
+        add_items(index, items, options.max_threads);
+        build_seconds = seconds_since(start);
+        if (!options.save_path.empty())
+            index.saveIndex(options.save_path);
+    }
+
+    std::cerr << "ground truth of " << queries.size() << " queries\n";
+    const auto truth = ground_truth(index, queries, options.k, options.max_threads);
+
+    SweepWriter writer(options.format);
+    std::vector<size_t> labels(options.k);
+    std::vector<float> distances(options.k);
+    std::vector<float *> pointers(options.k);
+    for (auto ef: options.efs) {
+        std::cerr << "ef " << ef << "\n";
+        index.setEf(ef);
+        std::vector<double> latencies;
+        size_t found = 0;
+        const auto start = bench_clock::now();
+        for (size_t i = 0; i < queries.size(); i++) {
+            const auto query_start = bench_clock::now();
+            const auto nb_results = index.knnQuery(const_cast<float *>(queries[i].data()), labels.data(),
+                                                   distances.data(), pointers.data(), options.k);
+            latencies.push_back(1e6 * seconds_since(query_start));
+            for (size_t j = 0; j < nb_results; j++) {
+                found += truth[i].count(labels[j]);
+            }
+        }
+        const auto elapsed = seconds_since(start);
+        // Counted apart, so that the timed searches run the same code as in production
+        size_t nb_distances = 0;
+        for (auto &query: queries) {
+            nb_distances += count_distances(index, query, options.k);
+        }
+        writer.add("distance", distance_name(options.distance)).add("precision", precision_name(options.precision))
+            .add("dim", dim).add("items", index.getNbItems()).add("M", options.M)
+            .add("ef_construction", options.ef_construction).add("build_seconds", build_seconds)
+            .add("k", options.k).add("ef", ef)
+            .add("recall", static_cast<double>(found) / (queries.size() * options.k))
+            .add("qps", queries.size() / elapsed)
+            .add("p50_us", percentile(latencies, 0.5)).add("p99_us", percentile(latencies, 0.99))
+            .add("distances_per_query", static_cast<double>(nb_distances) / queries.size())
+            .write();
+    }
+}
+
+static std::vector<size_t> split_sizes(const std::string &list) {
+    std::vector<size_t> values;
+    std::istringstream input(list);
+    std::string value;
+    while (std::getline(input, value, ',')) {
+        values.push_back(std::strtoul(value.c_str(), nullptr, 10));
+    }
+    return values;
+}
+
+int main(int argc, char **argv) {
+    const std::map<std::string, Distance> distances {
+        {"Euclidean", Euclidean}, {"Angular", Angular}, {"DotProduct", InnerProduct}, {"Kendall", Kendall}};
+    const std::map<std::string, Precision> precisions {
+        {"float32", Float32}, {"float16", Float16}, {"bfloat16", BFloat16}, {"float8", Float8},
+        {"float4", Float4}, {"int8", Int8Symmetric}, {"pq", PQ}, {"binary", Binary}};
+
+    SweepOptions options;
+    bool valid = true;
+    for (int i = 1; i < argc && valid; i++) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            valid = false;
+            break;
+        }
+        const std::string value = argv[++i];
+        if (arg == "--data") {
+            options.data_path = value;
+        } else if (arg == "--queries") {
+            options.queries_path = value;
+        } else if (arg == "--index") {
+            options.index_path = value;
+        } else if (arg == "--save") {
+            options.save_path = value;
+        } else if (arg == "--distance" && distances.count(value)) {
+            options.distance = distances.at(value);
+        } else if (arg == "--precision" && precisions.count(value)) {
+            options.precision = precisions.at(value);
+        } else if (arg == "--M") {
+            options.M = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--ef-construction") {
+            options.ef_construction = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--ef") {
+            options.efs = split_sizes(value);
+        } else if (arg == "--k") {
+            options.k = std::max(1ul, std::strtoul(value.c_str(), nullptr, 10));
+        } else if (arg == "--nb-queries") {
+            options.nb_queries = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--limit") {
+            options.limit = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--dim") {
+            options.dim = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--threads") {
+            options.max_threads = std::max(1ul, std::strtoul(value.c_str(), nullptr, 10));
+        } else if (arg == "--format" && (value == "csv" || value == "json")) {
+            options.format = value;
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid || (options.data_path.empty() && options.index_path.empty())) {
+        std::cerr << "Usage: " << argv[0] << " --data items.fvecs [--queries queries.fvecs] [--index saved_index]"
+                  << " [--save saved_index] [--distance Euclidean|Angular|DotProduct|Kendall] [--precision float32|...]"
+                  << " [--M 16] [--ef-construction 200] [--ef 10,20,...] [--k 10] [--nb-queries 1000] [--limit N]"
+                  << " [--dim D] [--threads T] [--format csv|json]\n";
+        return 1;
+    }
+    try {
+        sweep(options);
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
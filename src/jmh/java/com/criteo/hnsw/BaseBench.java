@@ -11,12 +11,10 @@ import java.util.concurrent.TimeUnit;
 public class BaseBench {
     private static int randomSeed = 42;
     public static Random r = new Random(randomSeed);
-    public static int defaultDimension = 101;
 
     public static int defaultM = 15;
     public static int defaultEfConstruction = 1000;
     public static int defaultEfSearch = 50;
-    public static int defaultNbItems = 2500;
     public static int defaultNbResults = 20;
 
     @Param({Metrics.DotProduct})
@@ -25,43 +23,58 @@ public class BaseBench {
     @Param({Precision.Float32})
     public String precision;
 
+    /**
+     * Vectors indexed, see `Dataset`: `uniform`, `clustered[:option=value...]` or `fvecs:path`,
+     * whose dimension then replaces `dimension`
+     */
+    @Param({"uniform"})
+    public String dataset;
+
+    @Param({"101"})
+    public int dimension;
+
+    @Param({"2500"})
+    public int nbItems;
+
     public HnswIndex index;
 
-    public static HnswIndex createIndex(String metric, String precision) {
-        return createIndex(defaultDimension, metric, precision, defaultNbItems, defaultEfConstruction, defaultM, defaultEfSearch);
+    public HnswIndex createIndex(String metric, String precision) {
+        try (Dataset vectors = Dataset.create(dataset, dimension, randomSeed)) {
+            dimension = vectors.getDimension();
+            return createIndex(vectors, metric, precision, nbItems, defaultEfConstruction, defaultM, defaultEfSearch);
+        }
+    }
+
+    public HnswIndex createBruteforceIndex(String metric, String precision) {
+        try (Dataset vectors = Dataset.create(dataset, dimension, randomSeed)) {
+            dimension = vectors.getDimension();
+            return createBruteforceIndex(vectors, metric, precision, nbItems);
+        }
     }
 
-    public static HnswIndex createIndex(int dimension, String metric, String precision, int nbItems, int efConstruction, int m, int efSearch) {
-        HnswIndex index = HnswIndex.create(metric, dimension, precision, false);
+    public static HnswIndex createIndex(Dataset vectors, String metric, String precision, int nbItems, int efConstruction, int m, int efSearch) {
+        HnswIndex index = HnswIndex.create(metric, vectors.getDimension(), precision, false);
         index.initNewIndex(nbItems, m, efConstruction, randomSeed);
-        populateIndex(index, nbItems, dimension);
+        populateIndex(index, vectors, nbItems);
         index.setEf(efSearch);
         return index;
     }
 
-    public static HnswIndex createBruteforceIndex(int dimension, String metric, String precision, int nbItems) {
-        HnswIndex index = HnswIndex.create(metric, dimension, precision, true);
+    public static HnswIndex createBruteforceIndex(Dataset vectors, String metric, String precision, int nbItems) {
+        HnswIndex index = HnswIndex.create(metric, vectors.getDimension(), precision, true);
         index.initBruteforce(nbItems);
-        populateIndex(index, nbItems, dimension);
+        populateIndex(index, vectors, nbItems);
         return index;
     }
 
-    public static void populateIndex(HnswIndex index, int nbItems, int dimension) {
+    public static void populateIndex(HnswIndex index, Dataset vectors, int nbItems) {
         for(long id = 0; id < nbItems; id++) {
-            index.addItem(createVectorArray(dimension), id);
-        }
-    }
-
-    public static float[] createVectorArray(int dimension) {
-        float[] embedding = new float[dimension];
-        for (int i = 0; i < dimension; i++) {
-            embedding[i] = r.nextFloat();
+            index.addItem(vectors.next(), id);
         }
-        return embedding;
     }
 
     public int randomId() {
-        return randomId(defaultNbItems);
+        return randomId(nbItems);
     }
 
     public int randomId(int maxId) {
@@ -11,7 +11,7 @@ public class BruteKnn extends BaseBench {
 
     @Setup(Level.Trial)
     public void globalSetup() {
-        index = createBruteforceIndex(defaultDimension, metric, precision, defaultNbItems);
+        index = createBruteforceIndex(metric, precision);
     }
 
     @Setup(Level.Invocation)
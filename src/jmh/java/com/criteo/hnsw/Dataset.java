@@ -0,0 +1,246 @@
+package com.criteo.hnsw;
+
+import java.io.BufferedInputStream;
+import java.io.DataInputStream;
+import java.io.EOFException;
+import java.io.FileInputStream;
+import java.io.IOException;
+import java.io.UncheckedIOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.HashMap;
+import java.util.Map;
+import java.util.Random;
+
+/**
+ * Vectors indexed by the benchmarks, produced one at a time so that millions of items are never held
+ * in the heap. Created from the `dataset` parameter of `BaseBench`:
+ *
+ *  * `uniform` - i.i.d. components in [0, 1), the easiest case for HNSW
+ *  * `clustered` - gaussian mixture with options separated by `:`, e.g. `clustered:clusters=256:intrinsic=8`
+ *      * `clusters` (64) - number of clusters, of sizes decreasing as 1 / rank
+ *      * `intrinsic` (32) - dimension of the random subspace each cluster spreads in
+ *      * `anisotropy` (0.5) - scale of the i-th direction of a subspace is (i + 1)^-anisotropy
+ *      * `tail` (3) - norms are scaled by a Pareto factor of this shape, heavier when smaller, 0 for none
+ *      * `noise` (0.05) - isotropic gaussian noise added to every component
+ *  * `fvecs:path` - vectors of a fvecs file (int32 dimension then float32 components, little endian),
+ *    in order, its dimension replacing the one of the benchmark
+ */
+public abstract class Dataset implements AutoCloseable {
+
+    public abstract int getDimension();
+
+    public abstract float[] next();
+
+    @Override
+    public void close() {
+    }
+
+    public static Dataset create(String spec, int dimension, long seed) {
+        String[] parts = spec.split(":", 2);
+        switch (parts[0]) {
+            case "uniform":
+                return new Uniform(dimension, seed);
+            case "clustered":
+                return new Clustered(dimension, seed, parseOptions(parts.length > 1 ? parts[1] : ""));
+            case "fvecs":
+                if (parts.length < 2) {
+                    throw new IllegalArgumentException("Missing path of the fvecs dataset: " + spec);
+                }
+                return new Fvecs(parts[1]);
+            default:
+                throw new IllegalArgumentException("Unknown dataset: " + spec);
+        }
+    }
+
+    private static Map<String, Double> parseOptions(String options) {
+        Map<String, Double> values = new HashMap<>();
+        for (String option : options.split(":")) {
+            if (option.isEmpty()) {
+                continue;
+            }
+            String[] keyValue = option.split("=", 2);
+            if (keyValue.length != 2) {
+                throw new IllegalArgumentException("Expected key=value dataset option: " + option);
+            }
+            values.put(keyValue[0], Double.parseDouble(keyValue[1]));
+        }
+        return values;
+    }
+
+    static class Uniform extends Dataset {
+        private final int dimension;
+        private final Random random;
+
+        Uniform(int dimension, long seed) {
+            this.dimension = dimension;
+            this.random = new Random(seed);
+        }
+
+        @Override
+        public int getDimension() {
+            return dimension;
+        }
+
+        @Override
+        public float[] next() {
+            float[] vector = new float[dimension];
+            for (int i = 0; i < dimension; i++) {
+                vector[i] = random.nextFloat();
+            }
+            return vector;
+        }
+    }
+
+    /**
+     * Closer to embeddings than uniform vectors: dense regions around centers, a few dominant
+     * directions within each, hubs among the items of large norm.
+     */
+    static class Clustered extends Dataset {
+        private final int dimension;
+        private final Random random;
+        private final float[][] centers;
+        // Directions of each cluster, already scaled, bases[cluster][direction][component]
+        private final float[][][] bases;
+        private final double[] cumulativeWeights;
+        private final double tail;
+        private final double noise;
+
+        Clustered(int dimension, long seed, Map<String, Double> options) {
+            this.dimension = dimension;
+            this.random = new Random(seed);
+            int nbClusters = options.getOrDefault("clusters", 64.0).intValue();
+            int intrinsic = java.lang.Math.min(dimension, options.getOrDefault("intrinsic", 32.0).intValue());
+            double anisotropy = options.getOrDefault("anisotropy", 0.5);
+            this.tail = options.getOrDefault("tail", 3.0);
+            this.noise = options.getOrDefault("noise", 0.05);
+            if (nbClusters < 1 || intrinsic < 1) {
+                throw new IllegalArgumentException("Clustered datasets need at least one cluster and one direction");
+            }
+
+            // Components of variance 1 / dimension, so that centers and directions have norms close to 1
+            double componentScale = 1.0 / java.lang.Math.sqrt(dimension);
+            centers = new float[nbClusters][];
+            bases = new float[nbClusters][intrinsic][];
+            for (int c = 0; c < nbClusters; c++) {
+                centers[c] = gaussianVector(componentScale);
+                for (int d = 0; d < intrinsic; d++) {
+                    bases[c][d] = gaussianVector(0.5 * componentScale * java.lang.Math.pow(d + 1, -anisotropy));
+                }
+            }
+            cumulativeWeights = new double[nbClusters];
+            double total = 0;
+            for (int c = 0; c < nbClusters; c++) {
+                total += 1.0 / (c + 1);
+                cumulativeWeights[c] = total;
+            }
+            for (int c = 0; c < nbClusters; c++) {
+                cumulativeWeights[c] /= total;
+            }
+        }
+
+        private float[] gaussianVector(double scale) {
+            float[] vector = new float[dimension];
+            for (int i = 0; i < dimension; i++) {
+                vector[i] = (float) (random.nextGaussian() * scale);
+            }
+            return vector;
+        }
+
+        private int randomCluster() {
+            double u = random.nextDouble();
+            int low = 0;
+            int high = cumulativeWeights.length - 1;
+            while (low < high) {
+                int middle = (low + high) >>> 1;
+                if (cumulativeWeights[middle] < u) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            return low;
+        }
+
+        @Override
+        public int getDimension() {
+            return dimension;
+        }
+
+        @Override
+        public float[] next() {
+            int cluster = randomCluster();
+            float[] vector = centers[cluster].clone();
+            for (float[] direction : bases[cluster]) {
+                float z = (float) random.nextGaussian();
+                for (int i = 0; i < dimension; i++) {
+                    vector[i] += z * direction[i];
+                }
+            }
+            double componentNoise = noise / java.lang.Math.sqrt(dimension);
+            // Pareto of minimum 1, 1 - nextDouble() is in (0, 1]
+            double normScale = tail > 0 ? java.lang.Math.pow(1.0 - random.nextDouble(), -1.0 / tail) : 1.0;
+            for (int i = 0; i < dimension; i++) {
+                vector[i] = (float) ((vector[i] + random.nextGaussian() * componentNoise) * normScale);
+            }
+            return vector;
+        }
+    }
+
+    static class Fvecs extends Dataset {
+        private final String path;
+        private final DataInputStream input;
+        private final int dimension;
+        private final byte[] buffer;
+        private boolean headerRead = true;
+
+        Fvecs(String path) {
+            this.path = path;
+            try {
+                input = new DataInputStream(new BufferedInputStream(new FileInputStream(path), 1 << 20));
+                dimension = Integer.reverseBytes(input.readInt());
+            } catch (IOException e) {
+                throw new UncheckedIOException("Cannot read fvecs file " + path, e);
+            }
+            if (dimension <= 0) {
+                throw new IllegalStateException("Invalid dimension " + dimension + " in " + path);
+            }
+            buffer = new byte[dimension * Float.BYTES];
+        }
+
+        @Override
+        public int getDimension() {
+            return dimension;
+        }
+
+        @Override
+        public float[] next() {
+            try {
+                if (!headerRead) {
+                    int vectorDimension = Integer.reverseBytes(input.readInt());
+                    if (vectorDimension != dimension) {
+                        throw new IllegalStateException("Dimension " + vectorDimension + " differs from " + dimension + " in " + path);
+                    }
+                }
+                headerRead = false;
+                input.readFully(buffer);
+            } catch (EOFException e) {
+                throw new IllegalStateException("Not enough vectors in " + path + " for the number of items", e);
+            } catch (IOException e) {
+                throw new UncheckedIOException("Cannot read fvecs file " + path, e);
+            }
+            float[] vector = new float[dimension];
+            ByteBuffer.wrap(buffer).order(ByteOrder.LITTLE_ENDIAN).asFloatBuffer().get(vector);
+            return vector;
+        }
+
+        @Override
+        public void close() {
+            try {
+                input.close();
+            } catch (IOException e) {
+                throw new UncheckedIOException(e);
+            }
+        }
+    }
+}
@@ -7,11 +7,12 @@ import com.criteo.knn.knninterface.FloatByteBuf;
 public class Math extends BaseBench {
     public FloatByteBuf vector1;
     public FloatByteBuf vector2;
-    public MathLib math = new MathLib(defaultDimension);
+    public MathLib math;
 
     @Setup(Level.Trial)
     public void globalSetup() {
         index = createIndex(metric, precision);
+        math = new MathLib(dimension);
     }
 
     @Setup(Level.Invocation)
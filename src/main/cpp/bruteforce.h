@@ -1,5 +1,4 @@
 #pragma once
-#include <unordered_map>
 #include <fstream>
 #include <memory>
 
@@ -9,7 +8,8 @@ namespace hnswlib {
     class BruteforceSearchAlg {
         public:
             explicit BruteforceSearchAlg(SpaceInterface <dist_t> *s) {
-                fstdistfunc_ = s->get_dist_func();
+                // Queries are compared to encoded items
+                fstdistfunc_ = s->get_search_dist_func();
                 dist_func_param_ = s->get_dist_func_param();
             }
 
@@ -65,7 +65,7 @@ namespace hnswlib {
         size_t data_size_;
         std::unique_ptr<BruteforceSearchAlg<dist_t>> alg_;
 
-        std::unordered_map<labeltype, tableint> dict_external_to_internal;
+        LabelLookup dict_external_to_internal;
 
         void addPoint(void *datapoint, labeltype label) {
             if(dict_external_to_internal.count(label))
@@ -154,11 +154,14 @@ namespace hnswlib {
                 data_ = (char *) malloc(cur_element_count * size_per_element_);
 
                 auto data_ptr = data_;
+                if (cur_element_count > 0)
+                    s->complete_training();
                 const auto params = s->get_dist_func_param();
                 for(size_t i = 0; i < cur_element_count; i++) {
                     // Reading vector
                     input.read(src_buffer.data(), src_data_size);
                     decoder_func((const SRC *) src_buffer.data(), (DST *) data_ptr, static_cast<PARAM*>(params));
+                    s->complete_item(data_ptr);
                     data_ptr += data_size_;
                     // Reading label
                     input.read(data_ptr, sizeof(labeltype));
@@ -168,6 +171,7 @@ namespace hnswlib {
 
             input.close();
 
+            dict_external_to_internal.reserve(cur_element_count);
             for (size_t i = 0; i < cur_element_count; i++) {
                 dict_external_to_internal[getExternalLabel(i)]=i;
             }
@@ -185,7 +189,7 @@ namespace hnswlib {
             return cur_element_count;
         }
 
-        inline std::unordered_map<labeltype, tableint> * getLabelLookup() {
+        inline LabelLookup * getLabelLookup() {
             return &dict_external_to_internal;
         }
     };
@@ -0,0 +1,84 @@
+#pragma once
+
+/**
+ * Kernels for instruction sets above the compile flags are built with target attributes and only
+ * picked when the CPU running the code supports them.
+ **/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(NO_MANUAL_VECTORIZATION)
+#define HNSW_RUNTIME_DISPATCH
+#define HNSW_TARGET(isa) __attribute__((target(isa)))
+// 512 bits kernels load their tails under masks, byte and word masks need AVX512BW and AVX512VL
+#define HNSW_AVX512_ISA "avx512f,avx512bw,avx512vl,avx2,fma"
+#define HNSW_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define HNSW_TARGET(isa)
+#define HNSW_ALWAYS_INLINE inline
+#endif
+
+// Loops over a constant number of steps, unrolled completely
+#if defined(__clang__)
+#define HNSW_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__) && __GNUC__ >= 8
+#define HNSW_UNROLL _Pragma("GCC unroll 64")
+#else
+#define HNSW_UNROLL
+#endif
+
+// GCC 12 warns about the undefined registers several AVX-512 intrinsics start from
+#if defined(HNSW_RUNTIME_DISPATCH) && !defined(__clang__)
+#define HNSW_AVX512_BEGIN \
+    _Pragma("GCC diagnostic push") \
+    _Pragma("GCC diagnostic ignored \"-Wuninitialized\"") \
+    _Pragma("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+#define HNSW_AVX512_END _Pragma("GCC diagnostic pop")
+#else
+#define HNSW_AVX512_BEGIN
+#define HNSW_AVX512_END
+#endif
+
+namespace hnswlib {
+
+    static inline bool cpu_supports_avx2() {
+    #if defined(HNSW_RUNTIME_DISPATCH)
+        return __builtin_cpu_supports("avx2");
+    #else
+        return false;
+    #endif
+    }
+
+    // Float kernels use both AVX2 and fused multiply-adds, shipped together since Haswell
+    static inline bool cpu_supports_avx2_fma() {
+    #if defined(HNSW_RUNTIME_DISPATCH)
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    #else
+        return false;
+    #endif
+    }
+
+    static inline bool cpu_supports_avx512() {
+    #if defined(HNSW_RUNTIME_DISPATCH)
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+               __builtin_cpu_supports("avx512vl") && cpu_supports_avx2_fma();
+    #else
+        return false;
+    #endif
+    }
+
+    static inline bool cpu_supports_popcnt() {
+    #if defined(HNSW_RUNTIME_DISPATCH)
+        return __builtin_cpu_supports("popcnt");
+    #else
+        return false;
+    #endif
+    }
+
+    // 256 bits `vpdpbusd`, part of AVX512-VNNI with AVX512VL
+    static inline bool cpu_supports_avx512_vnni() {
+    #if defined(HNSW_RUNTIME_DISPATCH)
+        return __builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512vl") &&
+               __builtin_cpu_supports("avx2");
+    #else
+        return false;
+    #endif
+    }
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <algorithm>
+#include "cpu_features.h"
 #include "float16.h"
 
 namespace hnswlib {
@@ -11,6 +12,10 @@ namespace hnswlib {
         return decode_fp16(*component);
     }
 
+    static inline float load_component(const bfloat16_t *component) {
+        return decode_bf16(*component);
+    }
+
     // Encoding F32 -> F16
     static inline void encode_component(const float* src, uint16_t *dst) {
         *dst = encode_fp16(*src);
@@ -21,6 +26,16 @@ namespace hnswlib {
         *dst = decode_fp16(*src);
     }
 
+    // Encoding F32 -> BF16
+    static inline void encode_component(const float* src, bfloat16_t *dst) {
+        *dst = encode_bf16(*src);
+    }
+
+    // Decoding BF16 -> F32
+    static inline void encode_component(const bfloat16_t* src, float *dst) {
+        *dst = decode_bf16(*src);
+    }
+
     template<typename SRC, typename DST, void(*encode_func)(const SRC*, DST*), int step>
     static void
     encode_decode_vector(const SRC* src, DST* dst, const size_t* qty_ptr) {
@@ -56,6 +71,74 @@ namespace hnswlib {
         _mm256_storeu_ps(dst, f32);
     }
 
+    // BF16 -> F32 is a 16 bits shift: interleaving zeros below each component
+    static inline __m256 convert_bf16_avx(__m128i tmp) {
+        const auto zero = _mm_setzero_si128();
+        const auto lo = _mm_castsi128_ps(_mm_unpacklo_epi16(zero, tmp));
+        const auto hi = _mm_castsi128_ps(_mm_unpackhi_epi16(zero, tmp));
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    }
+
+    static inline __m256 load_component_avx(const bfloat16_t *component) {
+        return convert_bf16_avx(_mm_loadu_si128((const __m128i *) component));
+    }
+
+    static inline float reduce_add_avx(__m256 sum) {
+        const auto sum4 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        const auto sum2 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+        return _mm_cvtss_f32(_mm_add_ss(sum2, _mm_movehdup_ps(sum2)));
+    }
+
+    // Lanes [8 - n, 16 - n) select the first n components
+    static const int32_t avx_tail_mask_table[16] = {-1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0};
+
+    static inline __m256i get_tail_mask_avx(size_t qty_left) {
+        return _mm256_loadu_si256((const __m256i *) (avx_tail_mask_table + 8 - qty_left));
+    }
+
+    // Last `qty_left` < 8 components of a vector, the lanes past its end read as zeros
+    static inline __m256 load_component_avx(const float *component, size_t qty_left) {
+        return _mm256_maskload_ps(component, get_tail_mask_avx(qty_left));
+    }
+
+    // A shuffle control read at offset o picks byte o + i for lane i below 16 and zeroes the others
+    static const int8_t avx_tail_shuffle_table[32] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+        -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128
+    };
+
+    /**
+     * AVX has no masked 16 bits loads: the last 8 components of the vector are loaded and shifted
+     * down, so the vector must hold at least 8 components.
+     **/
+    static inline __m128i load_tail_epi16(const void *component, size_t qty_left) {
+        const auto last8 = _mm_loadu_si128((const __m128i *) (static_cast<const uint16_t *>(component) + qty_left - 8));
+        const auto control = _mm_loadu_si128((const __m128i *) (avx_tail_shuffle_table + 16 - 2 * qty_left));
+        return _mm_shuffle_epi8(last8, control);
+    }
+
+    static inline __m256 load_component_avx(const uint16_t *component, size_t qty_left) {
+        return _mm256_cvtph_ps(load_tail_epi16(component, qty_left));
+    }
+
+    static inline __m256 load_component_avx(const bfloat16_t *component, size_t qty_left) {
+        return convert_bf16_avx(load_tail_epi16(component, qty_left));
+    }
+
+    static inline void encode_component_sse(const float* src, bfloat16_t *dst);
+
+    // Encoding F32 -> BF16, integer 256 bits operations would need AVX2
+    static inline void encode_component_avx(const float* src, bfloat16_t *dst) {
+        encode_component_sse(src, dst);
+        encode_component_sse(src + 4, dst + 4);
+    }
+
+    // Decoding BF16 -> F32
+    static inline void encode_component_avx(const bfloat16_t* src, float *dst) {
+        const auto f32 = load_component_avx(src);
+        _mm256_storeu_ps(dst, f32);
+    }
+
     template<typename SRC, typename DST>
     static void
     encode_decode_vector_avx_residuals(const SRC* src, DST* dst, const size_t* qty_ptr) {
@@ -92,6 +175,29 @@ namespace hnswlib {
         _mm_storeu_ps(dst, f32);
     }
 
+    static inline __m128 load_component_sse(const bfloat16_t *component) {
+        const auto tmp = _mm_loadl_epi64((const __m128i *) component);
+        return _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), tmp));
+    }
+
+    // Encoding F32 -> BF16, rounding to nearest even as encode_bf16
+    static inline void encode_component_sse(const float* src, bfloat16_t *dst) {
+        const auto f32 = _mm_loadu_ps(src);
+        const auto bits = _mm_castps_si128(f32);
+        const auto odd = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(1));
+        const auto rounded = _mm_add_epi32(bits, _mm_add_epi32(odd, _mm_set1_epi32(0x7FFF)));
+        const auto nan = _mm_castps_si128(_mm_cmpunord_ps(f32, f32));
+        const auto quiet_nan = _mm_or_si128(bits, _mm_set1_epi32(0x400000));
+        const auto result = _mm_srli_epi32(_mm_blendv_epi8(rounded, quiet_nan, nan), 16);
+        _mm_storel_epi64((__m128i*)dst, _mm_packus_epi32(result, result));
+    }
+
+    // Decoding BF16 -> F32
+    static inline void encode_component_sse(const bfloat16_t* src, float *dst) {
+        const auto f32 = load_component_sse(src);
+        _mm_storeu_ps(dst, f32);
+    }
+
     template<typename SRC, typename DST>
     static void
     encode_decode_vector_sse_residuals(const SRC* src, DST* dst, const size_t* qty_ptr) {
@@ -103,6 +209,145 @@ namespace hnswlib {
     }
 #endif
 
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+
+    /**
+     * Variants built for AVX2 and FMA over the AVX compile flags, picked at run time when
+     * `cpu_supports_avx2_fma`. Conversions AVX2 doesn't improve reuse the AVX ones.
+     **/
+    static inline __m256 load_component_avx2(const float *component) {
+        return load_component_avx(component);
+    }
+
+    static inline __m256 load_component_avx2(const uint16_t *component) {
+        return load_component_avx(component);
+    }
+
+    // BF16 -> F32 widened and shifted within a single 256 bits register
+    HNSW_TARGET("avx2,fma")
+    static inline __m256 load_component_avx2(const bfloat16_t *component) {
+        const auto tmp = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) component));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(tmp, 16));
+    }
+
+    static inline void encode_component_avx2(const float* src, uint16_t *dst) {
+        encode_component_avx(src, dst);
+    }
+
+    static inline void encode_component_avx2(const uint16_t* src, float *dst) {
+        encode_component_avx(src, dst);
+    }
+
+    // Encoding F32 -> BF16, rounding as `encode_component_sse` on 8 components at once
+    HNSW_TARGET("avx2,fma")
+    static inline void encode_component_avx2(const float* src, bfloat16_t *dst) {
+        const auto f32 = _mm256_loadu_ps(src);
+        const auto bits = _mm256_castps_si256(f32);
+        const auto odd = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1));
+        const auto rounded = _mm256_add_epi32(bits, _mm256_add_epi32(odd, _mm256_set1_epi32(0x7FFF)));
+        const auto nan = _mm256_castps_si256(_mm256_cmp_ps(f32, f32, _CMP_UNORD_Q));
+        const auto quiet_nan = _mm256_or_si256(bits, _mm256_set1_epi32(0x400000));
+        const auto result = _mm256_srli_epi32(_mm256_blendv_epi8(rounded, quiet_nan, nan), 16);
+        // Packing stays within 128 bits lanes, the low half of each lane is gathered
+        const auto packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(result, result), 0x08);
+        _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(packed));
+    }
+
+    // Decoding BF16 -> F32
+    HNSW_TARGET("avx2,fma")
+    static inline void encode_component_avx2(const bfloat16_t* src, float *dst) {
+        _mm256_storeu_ps(dst, load_component_avx2(src));
+    }
+
+    // 8 components per step, the tail finished within the same call
+    template<typename SRC, typename DST>
+    HNSW_TARGET("avx2,fma")
+    static void
+    encode_decode_vector_avx2(const SRC* src, DST* dst, const size_t* qty_ptr) {
+        const auto qty = *qty_ptr;
+        const auto qty8 = qty >> 3 << 3;
+        size_t i = 0;
+        for (; i < qty8; i += 8) {
+            encode_component_avx2(src + i, dst + i);
+        }
+        for (; i < qty; i++) {
+            encode_component(src + i, dst + i);
+        }
+    }
+#endif
+
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+
+    /**
+     * 512 bits variants, picked at run time when `cpu_supports_avx512`. Every load takes a mask:
+     * components past the end of the vector are read as zeros, so tails need no scalar loop.
+     **/
+    HNSW_AVX512_BEGIN
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static inline __mmask16 get_tail_mask_avx512(size_t qty_left) {
+        return qty_left >= 16 ? 0xFFFF : (__mmask16) ((1U << qty_left) - 1);
+    }
+
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static inline __m512 load_component_avx512(const float *component, __mmask16 mask) {
+        return _mm512_maskz_loadu_ps(mask, component);
+    }
+
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static inline __m512 load_component_avx512(const uint16_t *component, __mmask16 mask) {
+        return _mm512_cvtph_ps(_mm256_maskz_loadu_epi16(mask, component));
+    }
+
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static inline __m512 load_component_avx512(const bfloat16_t *component, __mmask16 mask) {
+        const auto tmp = _mm512_cvtepu16_epi32(_mm256_maskz_loadu_epi16(mask, component));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(tmp, 16));
+    }
+
+    // Encoding F32 -> F16
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static inline void encode_component_avx512(const float* src, uint16_t *dst, __mmask16 mask) {
+        const auto f16 = _mm512_cvtps_ph(load_component_avx512(src, mask), FC16_CONVERSION_FLAGS);
+        _mm256_mask_storeu_epi16(dst, mask, f16);
+    }
+
+    // Decoding F16 -> F32
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static inline void encode_component_avx512(const uint16_t* src, float *dst, __mmask16 mask) {
+        _mm512_mask_storeu_ps(dst, mask, load_component_avx512(src, mask));
+    }
+
+    // Encoding F32 -> BF16, rounding as `encode_component_sse`
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static inline void encode_component_avx512(const float* src, bfloat16_t *dst, __mmask16 mask) {
+        const auto f32 = load_component_avx512(src, mask);
+        const auto bits = _mm512_castps_si512(f32);
+        const auto odd = _mm512_and_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(1));
+        const auto rounded = _mm512_add_epi32(bits, _mm512_add_epi32(odd, _mm512_set1_epi32(0x7FFF)));
+        const auto nan = _mm512_cmp_ps_mask(f32, f32, _CMP_UNORD_Q);
+        const auto quiet_nan = _mm512_or_si512(bits, _mm512_set1_epi32(0x400000));
+        const auto result = _mm512_srli_epi32(_mm512_mask_blend_epi32(nan, rounded, quiet_nan), 16);
+        _mm256_mask_storeu_epi16(dst, mask, _mm512_cvtepi32_epi16(result));
+    }
+
+    // Decoding BF16 -> F32
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static inline void encode_component_avx512(const bfloat16_t* src, float *dst, __mmask16 mask) {
+        _mm512_mask_storeu_ps(dst, mask, load_component_avx512(src, mask));
+    }
+
+    template<typename SRC, typename DST>
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static void
+    encode_decode_vector_avx512(const SRC* src, DST* dst, const size_t* qty_ptr) {
+        const auto qty = *qty_ptr;
+        for (size_t i = 0; i < qty; i += 16) {
+            encode_component_avx512(src + i, dst + i, get_tail_mask_avx512(qty - i));
+        }
+    }
+    HNSW_AVX512_END
+#endif
+
     template<typename SRC, typename DST>
     static inline
     DECODEFUNC<SRC, DST, size_t> get_fast_encode_func(size_t dim) {
@@ -114,6 +359,10 @@ namespace hnswlib {
 #if defined(USE_AVX)
         if (dim % 8 == 0) func = encode_decode_vector<SRC, DST, encode_component_avx, 8>;
         else if (dim > 8) func = encode_decode_vector_avx_residuals<SRC, DST>;
+#endif
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+        if (dim >= 8 && cpu_supports_avx2_fma()) func = encode_decode_vector_avx2<SRC, DST>;
+        if (dim >= 16 && cpu_supports_avx512()) func = encode_decode_vector_avx512<SRC, DST>;
 #endif
         return func;
     }
@@ -0,0 +1,68 @@
+#pragma once
+#include "hnswlib.h"
+
+namespace hnswlib {
+
+    template<size_t... DIMS>
+    struct FixedDims {};
+
+    // Dimensions of the production indices, distance kernels are also built with them as constants
+    typedef FixedDims<64, 96, 128, 256, 384, 512, 768> fixed_dims;
+
+    template<typename KERNEL>
+    static DISTFUNC<float> get_fixed_dim_func(size_t, FixedDims<>) {
+        return nullptr;
+    }
+
+    template<typename KERNEL, size_t DIM, size_t... DIMS>
+    static DISTFUNC<float> get_fixed_dim_func(size_t dim, FixedDims<DIM, DIMS...>) {
+        if (dim == DIM)
+            return KERNEL::template distance<DIM>;
+        return get_fixed_dim_func<KERNEL>(dim, FixedDims<DIMS...>());
+    }
+
+    // `KERNEL::distance<dim>` when `dim` is one of the fixed dimensions, nullptr otherwise
+    template<typename KERNEL>
+    static DISTFUNC<float> get_fixed_dim_func(size_t dim) {
+        return get_fixed_dim_func<KERNEL>(dim, fixed_dims());
+    }
+
+    // Replaces `func` by `KERNEL::distance<dim>` when there is one
+    template<typename KERNEL>
+    static bool use_fixed_dim_func(size_t dim, DISTFUNC<float> &func) {
+        const auto fixed_func = get_fixed_dim_func<KERNEL>(dim);
+        if (fixed_func != nullptr)
+            func = fixed_func;
+        return fixed_func != nullptr;
+    }
+
+    template<typename KERNEL>
+    static DISTBATCHFUNC<float> get_fixed_dim_batch_func(size_t, FixedDims<>) {
+        return nullptr;
+    }
+
+    template<typename KERNEL, size_t DIM, size_t... DIMS>
+    static DISTBATCHFUNC<float> get_fixed_dim_batch_func(size_t dim, FixedDims<DIM, DIMS...>) {
+        if (dim == DIM)
+            return KERNEL::template batch<DIM>;
+        return get_fixed_dim_batch_func<KERNEL>(dim, FixedDims<DIMS...>());
+    }
+
+    // `KERNEL::batch<dim>` when `dim` is one of the fixed dimensions, nullptr otherwise
+    template<typename KERNEL>
+    static DISTBATCHFUNC<float> get_fixed_dim_batch_func(size_t dim) {
+        return get_fixed_dim_batch_func<KERNEL>(dim, fixed_dims());
+    }
+
+    // Functor calling `KERNEL::distance<DIM>` directly, so that callers built for its instruction set can inline it
+    template<typename KERNEL, size_t DIM>
+    struct FixedDimDistance {
+        inline float operator()(const void *query_data, const void *data) const {
+            return KERNEL::template distance<DIM>(query_data, data, nullptr);
+        }
+
+        inline void operator()(const void *query_data, const void *const *data, size_t n, float *out) const {
+            KERNEL::template batch<DIM>(query_data, data, n, nullptr, out);
+        }
+    };
+}
@@ -0,0 +1,227 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace hnswlib {
+
+    /**
+     * Open addressing hash map with Robin Hood probing over a single flat array of slots.
+     *
+     * Meant for integer keys: one slot is 16 bytes for a 64-bit key and a 32-bit value, no per-entry
+     * allocation and lookups touch contiguous memory. The interface mimics the subset of
+     * std::unordered_map used in this library (`find`, `end`, `count`, `operator[]`, `erase` and
+     * iteration over entries exposing `first` and `second`).
+     *
+     * Once frozen, the table is compacted into an array sorted by key searched by bisection:
+     * no slack left but it can't be modified anymore.
+     **/
+    template<typename KEY, typename VALUE>
+    class FlatHashMap {
+    public:
+        struct Entry {
+            KEY first;
+            VALUE second;
+            // Distance to the ideal slot + 1, 0 for empty slots
+            uint32_t probe;
+        };
+
+        template<typename ENTRY>
+        class Iterator {
+        public:
+            Iterator(ENTRY *current, ENTRY *end) : current_(current), end_(end) {
+                skipEmpty();
+            }
+
+            ENTRY &operator*() const { return *current_; }
+            ENTRY *operator->() const { return current_; }
+
+            Iterator &operator++() {
+                current_++;
+                skipEmpty();
+                return *this;
+            }
+
+            bool operator==(const Iterator &other) const { return current_ == other.current_; }
+            bool operator!=(const Iterator &other) const { return current_ != other.current_; }
+
+        private:
+            void skipEmpty() {
+                while (current_ < end_ && current_->probe == 0) current_++;
+            }
+
+            ENTRY *current_;
+            ENTRY *end_;
+        };
+
+        typedef Iterator<Entry> iterator;
+        typedef Iterator<const Entry> const_iterator;
+
+        explicit FlatHashMap(size_t expected_size = 0) {
+            reserve(expected_size);
+        }
+
+        // Sizes the table to hold `expected_size` entries without rehashing
+        void reserve(size_t expected_size) {
+            if (frozen_) return;
+            size_t capacity = min_capacity_;
+            while (capacity * max_load_num_ < expected_size * max_load_den_) capacity <<= 1;
+            if (capacity > slots_.size()) rehash(capacity);
+        }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        iterator begin() { return iterator(slots_.data(), slots_.data() + slots_.size()); }
+        iterator end() { return iterator(slots_.data() + slots_.size(), slots_.data() + slots_.size()); }
+        const_iterator begin() const { return const_iterator(slots_.data(), slots_.data() + slots_.size()); }
+        const_iterator end() const { return const_iterator(slots_.data() + slots_.size(), slots_.data() + slots_.size()); }
+
+        /**
+         * Compacts the entries into a sorted array of exactly `size()` slots.
+         * Lookups turn into binary searches and any further modification throws.
+         **/
+        void freeze() {
+            if (frozen_) return;
+            std::vector<Entry> sorted;
+            sorted.reserve(size_);
+            for (const auto &slot: slots_) {
+                if (slot.probe) sorted.push_back(slot);
+            }
+            std::sort(sorted.begin(), sorted.end(), [](const Entry &a, const Entry &b) { return a.first < b.first; });
+            sorted.swap(slots_);
+            frozen_ = true;
+        }
+
+        bool isFrozen() const { return frozen_; }
+
+        iterator find(const KEY &key) {
+            const auto pos = findSlot(key);
+            return pos == npos ? end() : iterator(slots_.data() + pos, slots_.data() + slots_.size());
+        }
+
+        const_iterator find(const KEY &key) const {
+            const auto pos = findSlot(key);
+            return pos == npos ? end() : const_iterator(slots_.data() + pos, slots_.data() + slots_.size());
+        }
+
+        size_t count(const KEY &key) const {
+            return findSlot(key) == npos ? 0 : 1;
+        }
+
+        VALUE &operator[](const KEY &key) {
+            auto pos = findSlot(key);
+            if (pos == npos) {
+                if (frozen_) throw std::runtime_error("Can't insert into a frozen map");
+                if ((size_ + 1) * max_load_den_ > slots_.size() * max_load_num_) rehash(slots_.size() * 2);
+                pos = insertNew(key, VALUE());
+            }
+            return slots_[pos].second;
+        }
+
+        size_t erase(const KEY &key) {
+            auto pos = findSlot(key);
+            if (pos == npos) return 0;
+            if (frozen_) throw std::runtime_error("Can't erase from a frozen map");
+            // Backward shift deletion: pulls the following displaced entries one slot closer to home
+            auto next = (pos + 1) & mask_;
+            while (slots_[next].probe > 1) {
+                slots_[pos] = slots_[next];
+                slots_[pos].probe--;
+                pos = next;
+                next = (next + 1) & mask_;
+            }
+            slots_[pos].probe = 0;
+            size_--;
+            return 1;
+        }
+
+        void clear() {
+            if (frozen_) throw std::runtime_error("Can't clear a frozen map");
+            for (auto &slot: slots_) slot.probe = 0;
+            size_ = 0;
+        }
+
+        size_t memoryUsage() const {
+            return slots_.size() * sizeof(Entry);
+        }
+
+    private:
+        static const size_t npos = (size_t) -1;
+        static const size_t min_capacity_ = 16;
+        // Maximum load factor of 7/8, Robin Hood keeps probe sequences short up to ~0.9
+        static const size_t max_load_num_ = 7;
+        static const size_t max_load_den_ = 8;
+
+        inline size_t idealSlot(const KEY &key) const {
+            // Fibonacci hashing: sequential ids spread over the whole table
+            return (size_t) (((uint64_t) key * 0x9E3779B97F4A7C15ULL) >> shift_);
+        }
+
+        size_t findSlot(const KEY &key) const {
+            if (size_ == 0) return npos;
+            if (frozen_) {
+                const auto found = std::lower_bound(slots_.begin(), slots_.end(), key,
+                                                    [](const Entry &entry, const KEY &k) { return entry.first < k; });
+                return found != slots_.end() && found->first == key ? found - slots_.begin() : npos;
+            }
+            auto pos = idealSlot(key);
+            for (uint32_t probe = 1; ; probe++) {
+                const auto &slot = slots_[pos];
+                // Robin Hood invariant: the key would have been placed before a richer slot
+                if (slot.probe < probe) return npos;
+                if (slot.first == key) return pos;
+                pos = (pos + 1) & mask_;
+            }
+        }
+
+        // Inserts a key known to be absent, returns the slot it ends up in
+        size_t insertNew(KEY key, VALUE value) {
+            auto pos = idealSlot(key);
+            uint32_t probe = 1;
+            size_t inserted_pos = npos;
+            while (true) {
+                auto &slot = slots_[pos];
+                if (slot.probe == 0) {
+                    slot.first = key;
+                    slot.second = value;
+                    slot.probe = probe;
+                    size_++;
+                    return inserted_pos == npos ? pos : inserted_pos;
+                }
+                if (slot.probe < probe) {
+                    std::swap(slot.first, key);
+                    std::swap(slot.second, value);
+                    std::swap(slot.probe, probe);
+                    if (inserted_pos == npos) inserted_pos = pos;
+                }
+                probe++;
+                pos = (pos + 1) & mask_;
+            }
+        }
+
+        void rehash(size_t capacity) {
+            std::vector<Entry> old_slots(capacity, Entry());
+            old_slots.swap(slots_);
+            mask_ = capacity - 1;
+            shift_ = 64;
+            while (capacity > 1) {
+                capacity >>= 1;
+                shift_--;
+            }
+            size_ = 0;
+            for (const auto &slot: old_slots) {
+                if (slot.probe) insertNew(slot.first, slot.second);
+            }
+        }
+
+        std::vector<Entry> slots_;
+        size_t size_ = 0;
+        size_t mask_ = 0;
+        unsigned shift_ = 64;
+        bool frozen_ = false;
+    };
+}
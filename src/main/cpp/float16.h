@@ -1,4 +1,6 @@
 #pragma once
+#include <stdint.h>
+#include <string.h>
 
 namespace hnswlib {
     const auto FC16_CONVERSION_FLAGS = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
@@ -20,4 +22,28 @@ namespace hnswlib {
     // Copy if needed from https://github.com/facebookresearch/faiss/blob/da24fcc56eb203262cf209671d39e64e40744a96/impl/ScalarQuantizer.cpp#L222
 
     #endif
+
+    // Upper half of a float32: same exponent range, 8 bits of mantissa
+    struct bfloat16_t {
+        uint16_t bits;
+    };
+
+    static inline bfloat16_t encode_bf16(float x) {
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        if ((bits & 0x7FFFFFFF) > 0x7F800000) {
+            // NaN stays a quiet NaN instead of rounding into infinity
+            return bfloat16_t{(uint16_t) ((bits >> 16) | 0x40)};
+        }
+        // Round to nearest even
+        bits += 0x7FFF + ((bits >> 16) & 1);
+        return bfloat16_t{(uint16_t) (bits >> 16)};
+    }
+
+    static inline float decode_bf16(bfloat16_t x) {
+        const uint32_t bits = (uint32_t) x.bits << 16;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
 }
\ No newline at end of file
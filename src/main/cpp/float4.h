@@ -0,0 +1,69 @@
+#pragma once
+#include "float8.h"
+#include <cmath>
+
+namespace hnswlib {
+
+    // Largest code of 4-bit components, ranges of MinMaxRange are split into 15 steps
+    static const float float4_max_value = 15.f;
+
+    // Float4 vectors pack two components per byte, the even component in the low nibble
+    static inline size_t get_float4_data_size(size_t dim) {
+        return (dim + 1) / 2;
+    }
+
+    static inline uint8_t get_nibble(const uint8_t *src, size_t i) {
+        return (src[i >> 1] >> ((i & 1) << 2)) & 0x0F;
+    }
+
+    // Decode F4 -> F32
+    static inline float load_float4_component(const uint8_t *src, size_t i, const float *min, const float *diff) {
+        return diff[i] * get_nibble(src, i) + min[i];
+    }
+
+    // Encoding F32 -> F4, values out of the trained range are clamped
+    static inline void encode_float4_vector(const float *src, uint8_t *dst, const TrainParams *param_ptr) {
+        const auto qty = param_ptr->dim;
+        memset(dst, 0, get_float4_data_size(qty));
+        for (size_t i = 0; i < qty; i++) {
+            const auto diff = param_ptr->diff[i];
+            const auto code = diff > 0 ? std::round((src[i] - param_ptr->min[i]) / diff) : 0.f;
+            const auto nibble = static_cast<uint8_t>(std::min(std::max(code, 0.f), float4_max_value));
+            dst[i >> 1] |= nibble << ((i & 1) << 2);
+        }
+    }
+
+    static inline void decode_float4_vector(const uint8_t *src, float *dst, const TrainParams *param_ptr) {
+        const auto qty = param_ptr->dim;
+        for (size_t i = 0; i < qty; i++) {
+            dst[i] = load_float4_component(src, i, param_ptr->min, param_ptr->diff);
+        }
+    }
+
+#if defined(USE_SSE) || defined(USE_AVX)
+    // Spreads 16 components (8 bytes) to one byte each, in component order
+    static inline __m128i unpack_float4_sse(const uint8_t *src) {
+        const auto packed = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src));
+        const auto mask = _mm_set1_epi8(0x0F);
+        const auto low = _mm_and_si128(packed, mask);
+        const auto high = _mm_and_si128(_mm_srli_epi16(packed, 4), mask);
+        return _mm_unpacklo_epi8(low, high);
+    }
+
+    // Decodes the 4 components in the lowest bytes of `codes`
+    static inline __m128 load_float4_sse(__m128i codes, const float *min, const float *diff) {
+        const auto src_f32 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(codes));
+        return _mm_loadu_ps(diff) * src_f32 + _mm_loadu_ps(min);
+    }
+#endif
+
+#if defined(USE_AVX)
+    // Decodes the 8 components in the lowest bytes of `codes`
+    static inline __m256 load_float4_avx(__m128i codes, const float *min, const float *diff) {
+        const auto c4lo = _mm_cvtepu8_epi32(codes);
+        const auto c4hi = _mm_cvtepu8_epi32(_mm_srli_si128(codes, 4));
+        const auto i8 = _mm256_insertf128_si256(_mm256_castsi128_si256(c4lo), c4hi, 1);
+        return _mm256_loadu_ps(diff) * _mm256_cvtepi32_ps(i8) + _mm256_loadu_ps(min);
+    }
+#endif
+}
@@ -1,5 +1,7 @@
 #pragma once
+#include "cpu_features.h"
 #include "hnswlib.h"
+#include <cmath>
 #include <limits>
 #include <memory>
 #include <cassert>
@@ -74,14 +76,18 @@ namespace hnswlib {
 
         template<typename TARGET>
         void update_trained_params(TrainParams& params) {
-            const auto max_value = std::numeric_limits<TARGET>::max();
+            update_trained_params(params, std::numeric_limits<TARGET>::max());
+        }
+
+        // `max_value` is the largest code: 255 for float8, 15 for float4
+        void update_trained_params(TrainParams& params, float max_value) {
             memcpy((void *) params.min, min_.data(), sizeof(float) * min_.size());
             std::transform(
                 max_.cbegin(), max_.cend(),
                 min_.cbegin(),
                 params.diff,
                 [&max_value](float max_i, float min_i) {
-                    // Normalizing diff by max value of scalar type (255 for uint8_t/float8)
+                    // Normalizing diff by the largest code (255 for uint8_t/float8)
                     // to avoid extra multiplication at decoding time
                     return (max_i - min_i) / max_value;
                 }
@@ -149,6 +155,24 @@ namespace hnswlib {
         return diff_f32 * src_f32 + min_f32;
     }
 
+    static inline __m256 load_component_avx(const float *src, const float* min, const float *diff, size_t qty_left) {
+        return _mm256_maskload_ps(src, get_tail_mask_avx(qty_left));
+    }
+
+    /**
+     * Last `qty_left` < 8 codes of a vector of at least 8, loaded from its last 8 and shifted down.
+     * Ranges are masked too so that the lanes past the end decode to 0.
+     **/
+    static inline __m256 load_component_avx(const uint8_t *src, const float* min, const float *diff, size_t qty_left) {
+        const auto last8 = _mm_loadl_epi64((const __m128i *) (src + qty_left - 8));
+        const auto codes = _mm_shuffle_epi8(last8, _mm_loadu_si128((const __m128i *) (avx_tail_shuffle_table + 8 - qty_left)));
+        const auto mask = get_tail_mask_avx(qty_left);
+        const auto c4lo = _mm_cvtepu8_epi32(codes);
+        const auto c4hi = _mm_cvtepu8_epi32(_mm_srli_si128(codes, 4));
+        const auto src_f32 = _mm256_cvtepi32_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(c4lo), c4hi, 1));
+        return _mm256_maskload_ps(diff, mask) * src_f32 + _mm256_maskload_ps(min, mask);
+    }
+
     // Decode F8 -> F32
     static inline void encode_component_avx(const uint8_t *src, float* dst, const float* min, const float *diff) {
         const auto f32 = load_component_avx(src, min, diff);
@@ -197,6 +221,50 @@ namespace hnswlib {
     }
 #endif
 
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+    HNSW_TARGET("avx2")
+    static inline __m256 load_component_avx2(const float *src, const float* min, const float *diff) {
+        return _mm256_loadu_ps(src);
+    }
+
+    // Codes widened in a single 256 bits register. Built without FMA so that decoding rounds as the
+    // other loads and decoded values stay within the trained range.
+    HNSW_TARGET("avx2")
+    static inline __m256 load_component_avx2(const uint8_t *src, const float* min, const float *diff) {
+        const auto i8 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) src));
+        return _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(diff), _mm256_cvtepi32_ps(i8)), _mm256_load_ps(min));
+    }
+
+    // Decode F8 -> F32, the tail finished within the same call
+    HNSW_TARGET("avx2")
+    static void decode_trained_vector_avx2(const uint8_t* src, float* dst, const TrainParams* param_ptr) {
+        const auto qty = param_ptr->dim;
+        const auto qty8 = qty >> 3 << 3;
+        size_t i = 0;
+        for (; i < qty8; i += 8) {
+            _mm256_storeu_ps(dst + i, load_component_avx2(src + i, param_ptr->min + i, param_ptr->diff + i));
+        }
+        for (; i < qty; i++) {
+            dst[i] = load_component(src + i, param_ptr->min + i, param_ptr->diff + i);
+        }
+    }
+
+    HNSW_AVX512_BEGIN
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static inline __m512 load_component_avx512(const float *src, const float* min, const float *diff, __mmask16 mask) {
+        return _mm512_maskz_loadu_ps(mask, src);
+    }
+
+    // Masked out components decode to 0, ranges being read as zeros as well
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static inline __m512 load_component_avx512(const uint8_t *src, const float* min, const float *diff, __mmask16 mask) {
+        const auto i8 = _mm512_cvtepu8_epi32(_mm_maskz_loadu_epi8(mask, src));
+        const auto decoded = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, diff), _mm512_cvtepi32_ps(i8));
+        return _mm512_add_ps(decoded, _mm512_maskz_loadu_ps(mask, min));
+    }
+    HNSW_AVX512_END
+#endif
+
     static inline
     DECODEFUNC<uint8_t, float, TrainParams> get_fast_decode_trained_func(size_t dim) {
         auto func = encode_trained_vector<uint8_t, float, encode_component, 1>;
@@ -207,6 +275,9 @@ namespace hnswlib {
 #if defined(USE_AVX)
         if (dim % 8 == 0) func = encode_trained_vector<uint8_t, float, encode_component_avx, 8>;
         else if (dim > 8) func = decode_trained_vector_avx_residuals;
+#endif
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+        if (dim >= 8 && cpu_supports_avx2_fma()) func = decode_trained_vector_avx2;
 #endif
         return func;
     }
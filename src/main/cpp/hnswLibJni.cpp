@@ -2,6 +2,11 @@
 #include "hnswindex.h"
 #include "hnswlib.h"
 
+// Exceptions must not unwind through the JVM, they are thrown in Java as RuntimeException
+static void throwJavaException(JNIEnv *env, const std::exception &e) {
+    env->ThrowNew(env->FindClass("java/lang/RuntimeException"), e.what());
+}
+
 extern "C" {
 
 JNIEXPORT jlong JNICALL Java_com_criteo_hnsw_HnswLib_create(JNIEnv *env, jclass jobj, jint dim, jint distance, jint precision) {
@@ -28,9 +33,100 @@ JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_enableBruteforceSearch
 }
 
 JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_setEf(JNIEnv *env, jclass jobj, jlong pointer, jlong ef) {
-    auto index = (Index<float> *)pointer;
-    auto hnsw = (hnswlib::HierarchicalNSW<float> *)index->appr_alg;
-    hnsw->ef_ = (size_t) ef;
+    ((Index<float> *)pointer)->setEf((size_t) ef);
+}
+
+JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_useCompactLabels(JNIEnv *env, jclass jobj, jlong pointer, jboolean compact) {
+    try {
+        ((Index<float> *)pointer)->useCompactLabels(compact);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_useNormSlot(JNIEnv *env, jclass jobj, jlong pointer, jboolean use) {
+    try {
+        ((Index<float> *)pointer)->useNormSlot(use);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_useBinaryThresholds(JNIEnv *env, jclass jobj, jlong pointer, jboolean use) {
+    try {
+        ((Index<float> *)pointer)->useBinaryThresholds(use);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_usePQSubspaces(JNIEnv *env, jclass jobj, jlong pointer, jlong m) {
+    try {
+        ((Index<float> *)pointer)->usePQSubspaces((size_t) m);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_useMipsTransform(JNIEnv *env, jclass jobj, jlong pointer, jfloat max_norm) {
+    try {
+        ((Index<float> *)pointer)->useMipsTransform(max_norm);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
+}
+
+JNIEXPORT jlong JNICALL Java_com_criteo_hnsw_HnswLib_enableNumaReplicas(JNIEnv *env, jclass jobj, jlong pointer, jlong nb_replicas) {
+    try {
+        return ((Index<float> *)pointer)->enableNumaReplicas((size_t) nb_replicas);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+        return 0;
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_freeze(JNIEnv *env, jclass jobj, jlong pointer) {
+    try {
+        ((Index<float> *)pointer)->freeze();
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_enableRerank(JNIEnv *env, jclass jobj, jlong pointer, jint precision, jlong nb_candidates) {
+    try {
+        ((Index<float> *)pointer)->enableRerank((Precision) precision, (size_t) nb_candidates);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_setRerankCandidates(JNIEnv *env, jclass jobj, jlong pointer, jlong nb_candidates) {
+    try {
+        ((Index<float> *)pointer)->setRerankCandidates((size_t) nb_candidates);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_saveRerankVectors(JNIEnv *env, jclass jobj, jlong pointer, jstring path) {
+    const char *path_to_vectors = env->GetStringUTFChars(path, NULL);
+    try {
+        ((Index<float> *)pointer)->saveRerankVectors(path_to_vectors);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
+    env->ReleaseStringUTFChars(path, path_to_vectors);
+}
+
+JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_loadRerankVectors(JNIEnv *env, jclass jobj, jlong pointer, jstring path, jboolean use_mmap) {
+    const char *path_to_vectors = env->GetStringUTFChars(path, NULL);
+    try {
+        ((Index<float> *)pointer)->loadRerankVectors(path_to_vectors, use_mmap);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
+    env->ReleaseStringUTFChars(path, path_to_vectors);
 }
 
 JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_saveIndex(JNIEnv *env, jclass jobj, jlong pointer, jstring path) {
@@ -41,13 +137,21 @@ JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_saveIndex(JNIEnv *env, jclas
 
 JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_loadIndex(JNIEnv *env, jclass jobj, jlong pointer, jstring path) {
     const char *path_to_index = env->GetStringUTFChars(path, NULL);
-    ((Index<float> *)pointer)->loadIndex(path_to_index);
+    try {
+        ((Index<float> *)pointer)->loadIndex(path_to_index);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
     env->ReleaseStringUTFChars(path, path_to_index);
 }
 
 JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_loadBruteforce(JNIEnv *env, jclass jobj, jlong pointer, jstring path) {
     const char *path_to_index = env->GetStringUTFChars(path, NULL);
-    ((Index<float> *)pointer)->loadBruteforce(path_to_index);
+    try {
+        ((Index<float> *)pointer)->loadBruteforce(path_to_index);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
     env->ReleaseStringUTFChars(path, path_to_index);
 }
 
@@ -57,13 +161,21 @@ JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_addItem(JNIEnv *env, jclass
     std::vector<float> elements(dim);
     auto elements_data = elements.data();
     env->GetFloatArrayRegion(vector, 0, dim, elements_data);
-    hnsw->addItem(elements_data, (size_t) label);
+    try {
+        hnsw->addItem(elements_data, (size_t) label);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
 }
 
 JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_addItemBuffer(JNIEnv *env, jclass jobj, jlong pointer, jobject vector_buff, jlong label) {
     auto hnsw = (Index<float> *)pointer;
     auto vector_ptr = static_cast<float*>(env->GetDirectBufferAddress(vector_buff));
-    hnsw->addItem(vector_ptr, (size_t) label);
+    try {
+        hnsw->addItem(vector_ptr, (size_t) label);
+    } catch (const std::exception &e) {
+        throwJavaException(env, e);
+    }
 }
 
 JNIEXPORT void JNICALL Java_com_criteo_hnsw_HnswLib_trainEncodingSpace(JNIEnv *env, jclass jobj, jlong pointer, jfloatArray vector) {
@@ -142,6 +254,10 @@ JNIEXPORT jint JNICALL Java_com_criteo_hnsw_HnswLib_getDimension(JNIEnv *env, jc
     return (jint)((Index<float> *)pointer)->dim;
 }
 
+JNIEXPORT jlong JNICALL Java_com_criteo_hnsw_HnswLib_getDataSize(JNIEnv *env, jclass jobj, jlong pointer) {
+    return (jlong)((Index<float> *)pointer)->space->get_data_size();
+}
+
 JNIEXPORT jint JNICALL Java_com_criteo_hnsw_HnswLib_getMetric(JNIEnv *env, jclass jobj, jlong pointer) {
     return (jint)((Index<float> *)pointer)->distance;
 }
@@ -2,6 +2,7 @@
 
 #include "visited_list_pool.h"
 #include "hnswlib.h"
+#include "numa.h"
 #include <random>
 #include <iostream>
 #include <fstream>
@@ -10,8 +11,9 @@
 #include <string.h>
 #include <algorithm>
 #include <atomic>
+#include <limits>
+#include <thread>
 #include <unordered_set>
-#include <unordered_map>
 
 
 
@@ -19,7 +21,81 @@
 namespace hnswlib {
     typedef unsigned int linklistsizeint;
 
+    /**
+     * Link list header: the neighbour count lives in the low 16 bits. On level 0 the third byte is
+     * the element spinlock, so locking costs no memory beyond the header every element already has.
+     * Saved indices always hold 0 there, which keeps the file format unchanged.
+     **/
+    static inline unsigned short getListCount(const linklistsizeint *ptr) {
+        return *((const unsigned short *) ptr);
+    }
+
+    static inline void setListCount(linklistsizeint *ptr, unsigned short size) {
+        *((unsigned short *) ptr) = size;
+    }
+
+    class ElementLock {
+    public:
+        explicit ElementLock(linklistsizeint *level0_header)
+            : flag_(reinterpret_cast<std::atomic<unsigned char> *>(reinterpret_cast<char *>(level0_header) + 2)) {
+            static_assert(sizeof(std::atomic<unsigned char>) == 1, "Lock byte must fit in the link list header");
+            while (flag_->exchange(1, std::memory_order_acquire)) {
+                // Holders may run a whole insertion, back off to the scheduler while waiting
+                while (flag_->load(std::memory_order_relaxed)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        ~ElementLock() {
+            flag_->store(0, std::memory_order_release);
+        }
+
+        ElementLock(const ElementLock &) = delete;
+        ElementLock &operator=(const ElementLock &) = delete;
+
+    private:
+        std::atomic<unsigned char> *flag_;
+    };
+
+    // Search distance of the space, called through its function pointer
     template<typename dist_t>
+    struct SearchDistFunc {
+        SearchDistFunc(DISTFUNC<dist_t> func, DISTBATCHFUNC<dist_t> batch_func, const void *param)
+            : func(func), batch_func(batch_func), param(param) {}
+
+        inline dist_t operator()(const void *query_data, const void *data) const {
+            return func(query_data, data, param);
+        }
+
+        inline void operator()(const void *query_data, const void *const *data, size_t n, dist_t *out) const {
+            if (batch_func != nullptr) {
+                batch_func(query_data, data, n, param, out);
+                return;
+            }
+            for (size_t i = 0; i < n; i++) {
+                out[i] = func(query_data, data[i], param);
+            }
+        }
+
+        DISTFUNC<dist_t> func;
+        DISTBATCHFUNC<dist_t> batch_func;
+        const void *param;
+    };
+
+    // Dimensions up to 128, where calling the distance through a pointer is a visible part of a search
+    typedef FixedDims<64, 96, 128> inlined_search_dims;
+
+    // Levels are stored on one byte, far above what the level distribution reaches in practice
+    static const int max_element_level = std::numeric_limits<unsigned char>::max();
+
+    /**
+     * `label_t` is the type labels are stored with in each element of level 0. A 32-bit type saves
+     * 4 bytes per element for catalogs whose ids fit in it, adding a larger label then throws.
+     * The width is recorded by the saved format (size_data_per_element_ - label_offset_) and
+     * labels are converted when loading a file saved with another width.
+     **/
+    template<typename dist_t, typename label_t = labeltype>
     class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     public:
 
@@ -33,24 +109,27 @@ namespace hnswlib {
         }
 
         HierarchicalNSW(SpaceInterface<dist_t> *s, size_t max_elements, size_t M = 16, size_t ef_construction = 200, size_t random_seed = 100) :
-                link_list_locks_(max_elements), element_levels_(max_elements) {
+                element_levels_(max_elements) {
             max_elements_ = max_elements;
 
 
             data_size_ = s->get_data_size();
             fstdistfunc_ = s->get_dist_func();
             fstdist_search_func_ = s->get_search_dist_func();
+            fstdist_search_batch_func_ = s->get_search_dist_batch_func();
             dist_func_param_ = s->get_dist_func_param();
             M_ = M;
             maxM_ = M_;
             maxM0_ = M_ * 2;
+            if (maxM0_ > std::numeric_limits<unsigned short>::max())
+                throw std::runtime_error("M is too large");
             ef_construction_ = std::max(ef_construction,M_);
             ef_ = 10;
 
             level_generator_.seed(random_seed);
             
             size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
-            size_data_per_element_ = size_links_level0_ + data_size_ + sizeof(labeltype);
+            size_data_per_element_ = size_links_level0_ + data_size_ + sizeof(label_t);
             offsetData_ = size_links_level0_;
             label_offset_ = size_links_level0_ + data_size_;
             offsetLevel0_ = 0;
@@ -84,10 +163,15 @@ namespace hnswlib {
 
         ~HierarchicalNSW() {
 
+            releaseReplicas();
             free(data_level0_memory_);
-            for (tableint i = 0; i < cur_element_count; i++) {
-                if (element_levels_[i] > 0)
-                    free(linkLists_[i]);
+            if (upper_levels_memory_ != nullptr) {
+                free(upper_levels_memory_);
+            } else {
+                for (tableint i = 0; i < cur_element_count; i++) {
+                    if (element_levels_[i] > 0)
+                        free(linkLists_[i]);
+                }
             }
             free(linkLists_);
             delete visited_list_pool_;
@@ -110,7 +194,6 @@ namespace hnswlib {
         VisitedListPool *visited_list_pool_;
         std::mutex cur_element_count_guard_;
 
-        std::vector<std::mutex> link_list_locks_;
         tableint enterpoint_node_;
 
 
@@ -120,33 +203,151 @@ namespace hnswlib {
 
 
         char *data_level0_memory_;
+        // Read-only copies of data_level0_memory_, one per NUMA node (entry 0 is data_level0_memory_ itself, moved to the first node)
+        std::vector<char *> level0_replicas_;
+        // Replica searched by the threads of each node, indexed by node id
+        std::vector<size_t> node_to_replica_;
+        NumaTopology numa_topology_;
         char **linkLists_;
-        std::vector<int> element_levels_;
+        // Single allocation holding the upper levels of all elements once frozen
+        char *upper_levels_memory_ = nullptr;
+        std::vector<unsigned char> element_levels_;
 
 
         size_t data_size_;
         size_t label_offset_;
         DISTFUNC<dist_t> fstdistfunc_;
         DISTFUNC<dist_t> fstdist_search_func_;
+        DISTBATCHFUNC<dist_t> fstdist_search_batch_func_;
         void *dist_func_param_;
-        std::unordered_map<labeltype, tableint> label_lookup_;
+        LabelLookup label_lookup_;
 
         std::default_random_engine level_generator_;
 
         inline labeltype getExternalLabel(tableint internal_id) const {
-            labeltype return_label;
-            memcpy(&return_label,(data_level0_memory_ + internal_id * size_data_per_element_ + label_offset_), sizeof(labeltype));
+            label_t return_label;
+            memcpy(&return_label,(data_level0_memory_ + internal_id * size_data_per_element_ + label_offset_), sizeof(label_t));
             return return_label;
         }
 
-        inline labeltype *getExternalLabeLp(tableint internal_id) const {
-            return (labeltype *) (data_level0_memory_ + internal_id * size_data_per_element_ + label_offset_);
+        inline label_t *getExternalLabeLp(tableint internal_id) const {
+            return (label_t *) (data_level0_memory_ + internal_id * size_data_per_element_ + label_offset_);
         }
 
         inline char *getDataByInternalId(tableint internal_id) const {
             return (data_level0_memory_ + internal_id * size_data_per_element_ + offsetData_);
         }
 
+        inline const char *getDataByInternalId(const char *data_level0, tableint internal_id) const {
+            return (data_level0 + internal_id * size_data_per_element_ + offsetData_);
+        }
+
+        /**
+         * Copies the level 0 arena (links, vectors and labels) once per NUMA node so that searches
+         * walk the graph in memory local to the socket of the calling thread.
+         * Upper levels are small and stay shared. The index becomes read-only.
+         *
+         *  * `nb_replicas` - number of copies to serve, 0 to use the number of NUMA nodes of the host,
+         *    capped at that number as searches are only routed to one copy per node
+         *
+         * Returns: number of copies queries are routed to (1 when the host has a single node)
+         **/
+        size_t replicateLevel0(size_t nb_replicas = 0) override {
+            releaseReplicas();
+            if (nb_replicas == 0 || nb_replicas > numa_topology_.getNbNodes())
+                nb_replicas = numa_topology_.getNbNodes();
+            if (nb_replicas <= 1 || cur_element_count == 0)
+                return 1;
+            // Replica i is placed on the i-th online node
+            const auto &nodes = numa_topology_.getNodes();
+            const auto size = cur_element_count * size_data_per_element_;
+            node_to_replica_.assign(*std::max_element(nodes.begin(), nodes.end()) + 1, 0);
+            for (size_t replica = 0; replica < nb_replicas; replica++) {
+                const auto node = nodes[replica];
+                if (replica == 0) {
+                    numa_move(data_level0_memory_, size, node);
+                    level0_replicas_.push_back(data_level0_memory_);
+                } else {
+                    level0_replicas_.push_back(numa_alloc_copy(data_level0_memory_, size, node));
+                }
+                node_to_replica_[node] = replica;
+            }
+            // Nodes left without their own copy share them in turn
+            for (size_t i = nb_replicas; i < nodes.size(); i++) {
+                node_to_replica_[nodes[i]] = i % nb_replicas;
+            }
+            return nb_replicas;
+        }
+
+        void releaseReplicas() {
+            for (size_t node = 1; node < level0_replicas_.size(); node++) {
+                numa_free(level0_replicas_[node], cur_element_count * size_data_per_element_);
+            }
+            level0_replicas_.clear();
+            node_to_replica_.clear();
+        }
+
+        inline bool isFrozen() const {
+            return label_lookup_.isFrozen();
+        }
+
+        /**
+         * Turns the index into its read-only serving layout:
+         *  - capacity trimmed to the number of elements
+         *  - upper levels moved into one contiguous allocation
+         *  - labels kept in a sorted array instead of a hash table
+         * Searches are unchanged, any further insertion throws.
+         **/
+        void freeze() override {
+            if (isFrozen())
+                return;
+            std::unique_lock <std::mutex> lock(cur_element_count_guard_);
+            const auto nb_replicas = level0_replicas_.size();
+            releaseReplicas();
+
+            max_elements_ = cur_element_count;
+            auto data_level0 = (char *) realloc(data_level0_memory_, std::max(max_elements_, (size_t) 1) * size_data_per_element_);
+            if (data_level0 != nullptr)
+                data_level0_memory_ = data_level0;
+
+            size_t upper_levels_size = 0;
+            for (size_t i = 0; i < cur_element_count; i++) {
+                upper_levels_size += size_links_per_element_ * element_levels_[i];
+            }
+            upper_levels_memory_ = (char *) malloc(std::max(upper_levels_size, (size_t) 1));
+            if (upper_levels_memory_ == nullptr)
+                throw std::runtime_error("Not enough memory");
+            auto upper_levels_ptr = upper_levels_memory_;
+            for (size_t i = 0; i < cur_element_count; i++) {
+                if (element_levels_[i] > 0) {
+                    const auto size = size_links_per_element_ * element_levels_[i];
+                    memcpy(upper_levels_ptr, linkLists_[i], size);
+                    free(linkLists_[i]);
+                    linkLists_[i] = upper_levels_ptr;
+                    upper_levels_ptr += size;
+                }
+            }
+            auto link_lists = (char **) realloc(linkLists_, sizeof(void *) * std::max(max_elements_, (size_t) 1));
+            if (link_lists != nullptr)
+                linkLists_ = link_lists;
+
+            element_levels_.resize(max_elements_);
+            element_levels_.shrink_to_fit();
+            delete visited_list_pool_;
+            visited_list_pool_ = new VisitedListPool(1, max_elements_);
+            label_lookup_.freeze();
+
+            if (nb_replicas > 1)
+                replicateLevel0(nb_replicas);
+        }
+
+        inline const char *getLevel0ForCurrentNode() const {
+            if (level0_replicas_.empty())
+                return data_level0_memory_;
+            const auto node = (size_t) numa_topology_.getCurrentNode();
+            return level0_replicas_[node < node_to_replica_.size() ? node_to_replica_[node] : 0];
+        }
+
         int getRandomLevel(double reverse_size) {
             std::uniform_real_distribution<double> distribution(0.0, 1.0);
             double r = -log(distribution(level_generator_)) * reverse_size;
@@ -179,14 +380,14 @@ namespace hnswlib {
 
                 tableint curNodeNum = curr_el_pair.second;
 
-                std::unique_lock <std::mutex> lock(link_list_locks_[curNodeNum]);
+                ElementLock lock(get_linklist0(curNodeNum));
 
                 int *data;// = (int *)(linkList0_ + curNodeNum * size_links_per_element0_);
                 if (layer == 0)
                     data = (int *) (data_level0_memory_ + curNodeNum * size_data_per_element_ + offsetLevel0_);
                 else
                     data = (int *) (linkLists_[curNodeNum] + (layer - 1) * size_links_per_element_);
-                int size = *data;
+                int size = getListCount((linklistsizeint *) data);
                 tableint *datal = (tableint *) (data + 1);
         #ifdef USE_SSE
                 _mm_prefetch((char *) (visited_array + *(data + 1)), _MM_HINT_T0);
@@ -226,18 +427,41 @@ namespace hnswlib {
 
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
         searchBaseLayerST(tableint ep_id, const void *data_point, size_t ef) const {
+            return searchBaseLayerST(ep_id, data_point, ef, data_level0_memory_);
+        }
+
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
+        searchBaseLayerST(tableint ep_id, const void *data_point, size_t ef, const char *data_level0) const {
+            return searchBaseLayerST(ep_id, data_point, ef, data_level0, SearchDistFunc<dist_t>(fstdist_search_func_, fstdist_search_batch_func_, dist_func_param_));
+        }
+
+        // Inlined in the search entry points, along with `distance` when its type is a concrete kernel
+        template<typename DISTANCE>
+        HNSW_ALWAYS_INLINE
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
+        searchBaseLayerST(tableint ep_id, const void *data_point, size_t ef, const char *data_level0, const DISTANCE &distance) const {
             VisitedList *vl = visited_list_pool_->getFreeVisitedList();
             vl_type *visited_array = vl->mass;
             vl_type visited_array_tag = vl->curV;
 
             std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
             std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> candidate_set;
-            dist_t dist = fstdist_search_func_(data_point, getDataByInternalId(ep_id), dist_func_param_);
+            dist_t dist = distance(data_point, getDataByInternalId(data_level0, ep_id));
 
             top_candidates.emplace(dist, ep_id);
             candidate_set.emplace(-dist, ep_id);
             visited_array[ep_id] = visited_array_tag;
             dist_t lower_bound = dist;
+            // Unvisited neighbours of the expanded node, scored in a single call. Scratch of the
+            // calling thread, only grown, so that searches don't allocate
+            static thread_local std::vector<const void *> batch_data;
+            static thread_local std::vector<tableint> batch_ids;
+            static thread_local std::vector<dist_t> batch_dists;
+            if (batch_ids.size() < maxM0_) {
+                batch_data.resize(maxM0_);
+                batch_ids.resize(maxM0_);
+                batch_dists.resize(maxM0_);
+            }
 
             while (!candidate_set.empty()) {
 
@@ -249,44 +473,52 @@ namespace hnswlib {
                 candidate_set.pop();
 
                 tableint current_node_id = current_node_pair.second;
-                int *data = (int *) (data_level0_memory_ + current_node_id * size_data_per_element_ + offsetLevel0_);
-                int size = *data;
+                int *data = (int *) (data_level0 + current_node_id * size_data_per_element_ + offsetLevel0_);
+                int size = getListCount((linklistsizeint *) data);
         #ifdef USE_SSE
                 _mm_prefetch((char *) (visited_array + *(data + 1)), _MM_HINT_T0);
                 _mm_prefetch((char *) (visited_array + *(data + 1) + 64), _MM_HINT_T0);
-                _mm_prefetch(data_level0_memory_ + (*(data + 1)) * size_data_per_element_ + offsetData_, _MM_HINT_T0);
+                _mm_prefetch(data_level0 + (*(data + 1)) * size_data_per_element_ + offsetData_, _MM_HINT_T0);
                 _mm_prefetch((char *) (data + 2), _MM_HINT_T0);
         #endif
 
+                size_t batch_size = 0;
                 for (int j = 1; j <= size; j++) {
                     int candidate_id = *(data + j);
         #ifdef USE_SSE
                     _mm_prefetch((char *) (visited_array + *(data + j + 1)), _MM_HINT_T0);
-                    _mm_prefetch(data_level0_memory_ + (*(data + j + 1)) * size_data_per_element_ + offsetData_,
+                    _mm_prefetch(data_level0 + (*(data + j + 1)) * size_data_per_element_ + offsetData_,
                                  _MM_HINT_T0);////////////
         #endif
                     if (!(visited_array[candidate_id] == visited_array_tag)) {
 
                         visited_array[candidate_id] = visited_array_tag;
 
-                        char *currObj1 = (getDataByInternalId(candidate_id));
-                        dist_t dist = fstdist_search_func_(data_point, currObj1, dist_func_param_);
+                        batch_ids[batch_size] = candidate_id;
+                        batch_data[batch_size] = getDataByInternalId(data_level0, candidate_id);
+                        batch_size++;
+                    }
+                }
+                distance(data_point, batch_data.data(), batch_size, batch_dists.data());
+
+                for (size_t j = 0; j < batch_size; j++) {
+                    dist_t dist = batch_dists[j];
+                    tableint candidate_id = batch_ids[j];
 
-                        if (top_candidates.top().first > dist || top_candidates.size() < ef) {
-                            candidate_set.emplace(-dist, candidate_id);
+                    if (top_candidates.top().first > dist || top_candidates.size() < ef) {
+                        candidate_set.emplace(-dist, candidate_id);
         #ifdef USE_SSE
-                            _mm_prefetch(data_level0_memory_ + candidate_set.top().second * size_data_per_element_ +
-                                         offsetLevel0_,///////////
-                                         _MM_HINT_T0);////////////////////////
+                        _mm_prefetch(data_level0 + candidate_set.top().second * size_data_per_element_ +
+                                     offsetLevel0_,///////////
+                                     _MM_HINT_T0);////////////////////////
         #endif
 
-                            top_candidates.emplace(dist, candidate_id);
+                        top_candidates.emplace(dist, candidate_id);
 
-                            if (top_candidates.size() > ef) {
-                                top_candidates.pop();
-                            }
-                            lower_bound = top_candidates.top().first;
+                        if (top_candidates.size() > ef) {
+                            top_candidates.pop();
                         }
+                        lower_bound = top_candidates.top().first;
                     }
                 }
             }
@@ -373,10 +605,10 @@ namespace hnswlib {
                 else
                     ll_cur = get_linklist(cur_c, level);
 
-                if (*ll_cur) {
+                if (getListCount(ll_cur)) {
                     throw std::runtime_error("The newly inserted element should have blank link list");
                 }
-                *ll_cur = selectedNeighbors.size();
+                setListCount(ll_cur, selectedNeighbors.size());
                 tableint *data = (tableint *) (ll_cur + 1);
 
 
@@ -392,7 +624,7 @@ namespace hnswlib {
             }
             for (size_t idx = 0; idx < selectedNeighbors.size(); idx++) {
 
-                std::unique_lock <std::mutex> lock(link_list_locks_[selectedNeighbors[idx]]);
+                ElementLock lock(get_linklist0(selectedNeighbors[idx]));
 
 
                 linklistsizeint *ll_other;
@@ -400,7 +632,7 @@ namespace hnswlib {
                     ll_other = get_linklist0(selectedNeighbors[idx]);
                 else
                     ll_other = get_linklist(selectedNeighbors[idx], level);
-                size_t sz_link_list_other = *ll_other;
+                size_t sz_link_list_other = getListCount(ll_other);
 
 
                 if (sz_link_list_other > Mcurmax)
@@ -413,7 +645,7 @@ namespace hnswlib {
                 tableint *data = (tableint *) (ll_other + 1);
                 if (sz_link_list_other < Mcurmax) {
                     data[sz_link_list_other] = cur_c;
-                    *ll_other = sz_link_list_other + 1;
+                    setListCount(ll_other, sz_link_list_other + 1);
                 } else {
                     // finding the "weakest" element to replace it with the new one
                     dist_t d_max = fstdistfunc_(getDataByInternalId(cur_c), getDataByInternalId(selectedNeighbors[idx]),
@@ -436,7 +668,7 @@ namespace hnswlib {
                         candidates.pop();
                         indx++;
                     }
-                    *ll_other = indx;
+                    setListCount(ll_other, indx);
                     // Nearest K:
                     /*int indx = -1;
                     for (int j = 0; j < sz_link_list_other; j++) {
@@ -457,7 +689,7 @@ namespace hnswlib {
         std::mutex global;
         size_t ef_;
 
-        void setEf(size_t ef) {
+        void setEf(size_t ef) override {
             ef_ = ef;
         }
 
@@ -472,7 +704,7 @@ namespace hnswlib {
                     changed = false;
                     int *data;
                     data = (int *) (linkLists_[currObj] + (level - 1) * size_links_per_element_);
-                    int size = *data;
+                    int size = getListCount((linklistsizeint *) data);
                     tableint *datal = (tableint *) (data + 1);
                     for (int i = 0; i < size; i++) {
                         tableint cand = datal[i];
@@ -570,17 +802,21 @@ namespace hnswlib {
 
             size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
 
-            // Inferring old data_size
+            // Inferring old data_size and label width
             const auto src_data_size = label_offset_ - size_links_level0_;
+            const auto src_label_size = size_data_per_element_ - label_offset_;
+            if (src_label_size != sizeof(uint32_t) && src_label_size != sizeof(uint64_t))
+                throw std::runtime_error("Unsupported label size " + std::to_string(src_label_size));
+            const bool decode_data = decoder_func != nullptr && data_size_ != src_data_size;
 
-            // Either no decoder or same size of vectors
-            if (decoder_func == nullptr || data_size_ == src_data_size) {
+            // Same layout, elements are read as is
+            if (!decode_data && src_label_size == sizeof(label_t)) {
                 data_level0_memory_ = (char *) malloc(max_elements * size_data_per_element_);
                 input.read(data_level0_memory_, cur_element_count * size_data_per_element_);
             }
             else {
                 std::vector<char> src_buffer(src_data_size);
-                if (s->needs_initialization()) {
+                if (decode_data && s->needs_initialization()) {
                     for(size_t i = 0; i < cur_element_count; i++) {
                         // Skip links
                         input.seekg(offsetData_, input.cur);
@@ -588,18 +824,22 @@ namespace hnswlib {
                         input.read(src_buffer.data(), src_data_size);
                         s->train(reinterpret_cast<const float *>(src_buffer.data()));
                         // Skip label
-                        input.seekg(sizeof(labeltype), input.cur);
+                        input.seekg(src_label_size, input.cur);
                     }
 
                     input.clear();
                     input.seekg(pos,input.beg);
-
+                }
+                if (decode_data) {
+                    if (cur_element_count > 0)
+                        s->complete_training();
                     dist_func_param_ = s->get_dist_func_param();
                 }
-                // Rewriting offsets per new size
-                label_offset_ = size_links_level0_ + data_size_;
-                size_data_per_element_ = size_data_per_element_ - src_data_size + data_size_;
-                data_level0_memory_ = (char *) malloc(cur_element_count * size_data_per_element_);
+                // Rewriting offsets per new sizes
+                const auto dst_data_size = decode_data ? data_size_ : src_data_size;
+                label_offset_ = size_links_level0_ + dst_data_size;
+                size_data_per_element_ = label_offset_ + sizeof(label_t);
+                data_level0_memory_ = (char *) malloc(max_elements * size_data_per_element_);
 
                 auto data_ptr = data_level0_memory_;
                 for(size_t i = 0; i < cur_element_count; i++) {
@@ -607,23 +847,39 @@ namespace hnswlib {
                     input.read(data_ptr, offsetData_);
                     data_ptr += offsetData_;
                     // Reading vector
-                    input.read(src_buffer.data(), src_data_size);
-                    decoder_func((const SRC *) src_buffer.data(), (DST *) data_ptr, static_cast<PARAM*>(dist_func_param_));
-                    data_ptr += data_size_;
-                    // Reading label
-                    input.read(data_ptr, sizeof(labeltype));
-                    data_ptr += sizeof(labeltype);
+                    if (decode_data) {
+                        input.read(src_buffer.data(), src_data_size);
+                        decoder_func((const SRC *) src_buffer.data(), (DST *) data_ptr, static_cast<PARAM*>(dist_func_param_));
+                        s->complete_item(data_ptr);
+                    } else {
+                        input.read(data_ptr, src_data_size);
+                    }
+                    data_ptr += dst_data_size;
+                    // Reading label, converted to the width of this index
+                    uint64_t label = 0;
+                    if (src_label_size == sizeof(uint32_t)) {
+                        uint32_t src_label;
+                        readBinaryPOD(input, src_label);
+                        label = src_label;
+                    } else {
+                        readBinaryPOD(input, label);
+                    }
+                    const label_t dst_label = checkedLabel(label);
+                    memcpy(data_ptr, &dst_label, sizeof(label_t));
+                    data_ptr += sizeof(label_t);
                 }
             }
+            if (data_level0_memory_ == nullptr)
+                throw std::runtime_error("Not enough memory");
 
             size_links_per_element_ = maxM_ * sizeof(tableint) + sizeof(linklistsizeint);
-            std::vector<std::mutex>(max_elements).swap(link_list_locks_);
             visited_list_pool_ = new VisitedListPool(1, max_elements);
 
             linkLists_ = (char **) malloc(sizeof(void *) * max_elements);
-            element_levels_ = std::vector<int>(max_elements);
+            element_levels_ = std::vector<unsigned char>(max_elements);
             revSize_ = 1.0 / mult_;
             ef_ = 10;
+            label_lookup_.reserve(cur_element_count);
             for (size_t i = 0; i < cur_element_count; i++) {
                 label_lookup_[getExternalLabel(i)]=i;
                 unsigned int linkListSize;
@@ -633,6 +889,8 @@ namespace hnswlib {
 
                     linkLists_[i] = nullptr;
                 } else {
+                    if (linkListSize / size_links_per_element_ > max_element_level)
+                        throw std::runtime_error("Level of element " + std::to_string(i) + " exceeds " + std::to_string(max_element_level));
                     element_levels_[i] = linkListSize / size_links_per_element_;
                     linkLists_[i] = (char *) malloc(linkListSize);
                     input.read(linkLists_[i], linkListSize);
@@ -667,7 +925,20 @@ namespace hnswlib {
             addPoint(data_point, label,-1);
         }
 
+        inline static label_t checkedLabel(labeltype label) {
+            if (label > std::numeric_limits<label_t>::max())
+                throw std::runtime_error("Label " + std::to_string(label) + " doesn't fit in the label width of the index");
+            return (label_t) label;
+        }
+
         tableint addPoint(void *data_point, labeltype label, int level) {
+            const label_t stored_label = checkedLabel(label);
+            if (level > max_element_level)
+                throw std::runtime_error("Level exceeds " + std::to_string(max_element_level));
+            if (!level0_replicas_.empty())
+                throw std::runtime_error("Index is replicated across NUMA nodes, it can't be modified");
+            if (isFrozen())
+                throw std::runtime_error("Index is frozen, it can't be modified");
 
             tableint cur_c = 0;
             {
@@ -679,8 +950,10 @@ namespace hnswlib {
                 label_lookup_[label] = cur_c;  // expected unique, if not will overwrite
                 cur_element_count++;
             }
-            std::unique_lock <std::mutex> lock_el(link_list_locks_[cur_c]);
-            int curlevel = getRandomLevel(mult_);
+            // Cleared before taking the element lock which lives in the level 0 header
+            memset(data_level0_memory_ + cur_c * size_data_per_element_ + offsetLevel0_, 0, size_data_per_element_);
+            ElementLock lock_el(get_linklist0(cur_c));
+            int curlevel = std::min(getRandomLevel(mult_), max_element_level);
             if (level > 0)
                 curlevel = level;
 
@@ -693,11 +966,8 @@ namespace hnswlib {
                 templock.unlock();
             tableint currObj = enterpoint_node_;
 
-
-            memset(data_level0_memory_ + cur_c * size_data_per_element_ + offsetLevel0_, 0, size_data_per_element_);
-
             // Initialisation of the data and label
-            memcpy(getExternalLabeLp(cur_c), &label, sizeof(labeltype));
+            memcpy(getExternalLabeLp(cur_c), &stored_label, sizeof(label_t));
             memcpy(getDataByInternalId(cur_c), data_point, data_size_);
 
 
@@ -718,9 +988,9 @@ namespace hnswlib {
                         while (changed) {
                             changed = false;
                             int *data;
-                            std::unique_lock <std::mutex> lock(link_list_locks_[currObj]);
+                            ElementLock lock(get_linklist0(currObj));
                             data = (int *) (linkLists_[currObj] + (level - 1) * size_links_per_element_);
-                            int size = *data;
+                            int size = getListCount((linklistsizeint *) data);
                             tableint *datal = (tableint *) (data + 1);
                             for (int i = 0; i < size; i++) {
                                 tableint cand = datal[i];
@@ -763,8 +1033,15 @@ namespace hnswlib {
         };
 
         std::priority_queue<std::pair<dist_t, tableint>> searchKnn(const void *query_data, size_t k) const {
+            return searchKnn(query_data, k, SearchDistFunc<dist_t>(fstdist_search_func_, fstdist_search_batch_func_, dist_func_param_));
+        }
+
+        template<typename DISTANCE>
+        HNSW_ALWAYS_INLINE
+        std::priority_queue<std::pair<dist_t, tableint>> searchKnn(const void *query_data, size_t k, const DISTANCE &distance) const {
+            const char *data_level0 = getLevel0ForCurrentNode();
             tableint currObj = enterpoint_node_;
-            dist_t curdist = fstdist_search_func_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
+            dist_t curdist = distance(query_data, getDataByInternalId(data_level0, enterpoint_node_));
 
             for (int level = maxlevel_; level > 0; level--) {
                 bool changed = true;
@@ -772,13 +1049,13 @@ namespace hnswlib {
                     changed = false;
                     int *data;
                     data = (int *) (linkLists_[currObj] + (level - 1) * size_links_per_element_);
-                    int size = *data;
+                    int size = getListCount((linklistsizeint *) data);
                     tableint *datal = (tableint *) (data + 1);
                     for (int i = 0; i < size; i++) {
                         tableint cand = datal[i];
                         if (cand < 0 || cand > max_elements_)
                             throw std::runtime_error("cand error");
-                        dist_t d = fstdist_search_func_(query_data, getDataByInternalId(cand), dist_func_param_);
+                        dist_t d = distance(query_data, getDataByInternalId(data_level0, cand));
 
                         if (d < curdist) {
                             curdist = d;
@@ -791,7 +1068,7 @@ namespace hnswlib {
 
 
             std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates = searchBaseLayerST(
-                    currObj, query_data, std::max(ef_,k));
+                    currObj, query_data, std::max(ef_,k), data_level0, distance);
             std::priority_queue<std::pair<dist_t, tableint >> results;
             while (top_candidates.size() > k) {
                 top_candidates.pop();
@@ -801,13 +1078,61 @@ namespace hnswlib {
                 top_candidates.pop();
             }
             return results;
-        };
+        }
+
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+        // Whole searches built for the instruction set of the kernel, which then inlines in the loop
+        template<typename DISTANCE>
+        HNSW_TARGET("avx2,fma")
+        static std::priority_queue<std::pair<dist_t, tableint>>
+        searchKnnAVX2(const AlgorithmInterface<dist_t> *alg, const void *query_data, size_t k) {
+            return static_cast<const HierarchicalNSW *>(alg)->searchKnn(query_data, k, DISTANCE());
+        }
+
+        template<typename DISTANCE>
+        HNSW_TARGET(HNSW_AVX512_ISA)
+        static std::priority_queue<std::pair<dist_t, tableint>>
+        searchKnnAVX512(const AlgorithmInterface<dist_t> *alg, const void *query_data, size_t k) {
+            return static_cast<const HierarchicalNSW *>(alg)->searchKnn(query_data, k, DISTANCE());
+        }
+
+        template<typename AVX2_KERNEL, typename AVX512_KERNEL>
+        static SearchKnnFunc<dist_t> getInlinedSearchFunc(size_t, FixedDims<>) {
+            return nullptr;
+        }
+
+        template<typename AVX2_KERNEL, typename AVX512_KERNEL, size_t DIM, size_t... DIMS>
+        static SearchKnnFunc<dist_t> getInlinedSearchFunc(size_t dim, FixedDims<DIM, DIMS...>) {
+            if (dim != DIM)
+                return getInlinedSearchFunc<AVX2_KERNEL, AVX512_KERNEL>(dim, FixedDims<DIMS...>());
+            // Same kernel as the one the space picks
+            if (cpu_supports_avx512())
+                return searchKnnAVX512<FixedDimDistance<AVX512_KERNEL, DIM>>;
+            if (cpu_supports_avx2_fma())
+                return searchKnnAVX2<FixedDimDistance<AVX2_KERNEL, DIM>>;
+            return nullptr;
+        }
+#endif
+
+        /**
+         * Search with the fixed dimension kernels of the space called directly from the loop,
+         * nullptr when `dim` isn't one of `inlined_search_dims` or the CPU has no such kernels.
+         * Searches then go through `searchKnn`, calling the kernel of the space by pointer.
+         **/
+        template<typename AVX2_KERNEL, typename AVX512_KERNEL>
+        static SearchKnnFunc<dist_t> getInlinedSearchFunc(size_t dim) {
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+            return getInlinedSearchFunc<AVX2_KERNEL, AVX512_KERNEL>(dim, inlined_search_dims());
+#else
+            return nullptr;
+#endif
+        }
 
         inline size_t getNbItems() const {
             return cur_element_count;
         }
 
-        inline std::unordered_map<labeltype, tableint> * getLabelLookup() {
+        inline LabelLookup * getLabelLookup() {
             return &label_lookup_;
         }
     };
@@ -1,7 +1,9 @@
 #pragma once
+#include <fstream>
 #include <iostream>
 #include <tuple>
 #include "hnswlib.h"
+#include "rerank_store.h"
 
 #ifndef KNN_JNI_HNSW_INDEX_H
 #define KNN_JNI_HNSW_INDEX_H
@@ -18,50 +20,289 @@ enum Precision {
     Float32 = 1,
     Float16 = 2,
     Float8 = 3,
+    PQ = 4,
+    Float4 = 5,
+    BFloat16 = 6,
+    Int8Symmetric = 7,
+    Binary = 8,
     num_values,
 };
 
+// "HNSWSPC1", marks the space params trailer of index files
+static const uint64_t space_params_magic = 0x3143505357534e48ULL;
+
 template<typename dist_t, typename data_t=float>
 class Index {
 public:
     Index(Distance distance, const int dim, const Precision precision) :
         dim(dim), precision(precision), distance(distance) {
+        space = newSpace(distance, dim, precision);
+        normalize = distance == Angular;
+        decode_func_float16 = hnswlib::get_fast_encode_func<uint16_t, float>(dim);
+        encode_func_float16 = hnswlib::get_fast_encode_func<float, uint16_t>(dim);
+        decode_func_bfloat16 = hnswlib::get_fast_encode_func<hnswlib::bfloat16_t, float>(dim);
+        encode_func_bfloat16 = hnswlib::get_fast_encode_func<float, hnswlib::bfloat16_t>(dim);
+        decode_func_float8 = hnswlib::get_fast_decode_trained_func(dim);
+        encode_func_float8 = hnswlib::encode_trained_vector<float, uint8_t, hnswlib::encode_component, 1>;
+        decode_func_float4 = hnswlib::decode_float4_vector;
+        encode_func_float4 = hnswlib::encode_float4_vector;
+        decode_func_int8 = hnswlib::decode_int8_vector;
+        encode_func_int8 = hnswlib::encode_int8_vector;
+        decode_func_binary = hnswlib::decode_binary_vector;
+        encode_func_binary = hnswlib::encode_binary_vector;
+        decode_func_pq = hnswlib::decode_pq_vector;
+        encode_func_pq = hnswlib::encode_pq_vector;
+    }
+
+    static hnswlib::SpaceInterface<float>* newSpace(Distance distance, const int dim, const Precision precision) {
         switch (distance) {
             case Euclidean:
                 switch (precision) {
-                    case Float8: space = new hnswlib::L2TrainedSpace<uint8_t>(dim); break;
-                    case Float16: space = new hnswlib::L2Space<uint16_t>(dim); break;
+                    case PQ: return new hnswlib::PQSpace(dim, false);
+                    case Float4: return new hnswlib::Float4TrainedSpace(dim, false);
+                    case Int8Symmetric: return new hnswlib::Int8SymmetricSpace(dim, false);
+                    case Binary: return new hnswlib::HammingSpace(dim);
+                    case Float8: return new hnswlib::L2TrainedSpace<uint8_t>(dim);
+                    case Float16: return new hnswlib::L2Space<uint16_t>(dim);
+                    case BFloat16: return new hnswlib::L2Space<hnswlib::bfloat16_t>(dim);
                     case Float32:
-                    default: space = new hnswlib::L2Space<float>(dim); break;
+                    default: return new hnswlib::L2Space<float>(dim);
                 }
-                break;
             case Angular:
             case InnerProduct:
                 switch (precision) {
-                    case Float8: space = new hnswlib::InnerProductTrainedSpace<uint8_t>(dim); break;
-                    case Float16: space = new hnswlib::InnerProductSpace<uint16_t>(dim); break;
+                    case PQ: return new hnswlib::PQSpace(dim, true);
+                    case Float4: return new hnswlib::Float4TrainedSpace(dim, true);
+                    case Int8Symmetric: return new hnswlib::Int8SymmetricSpace(dim, true);
+                    case Binary: return new hnswlib::HammingSpace(dim);
+                    case Float8: return new hnswlib::InnerProductTrainedSpace<uint8_t>(dim);
+                    case Float16: return new hnswlib::InnerProductSpace<uint16_t>(dim);
+                    case BFloat16: return new hnswlib::InnerProductSpace<hnswlib::bfloat16_t>(dim);
                     case Float32:
-                    default: space = new hnswlib::InnerProductSpace<float>(dim); break;
+                    default: return new hnswlib::InnerProductSpace<float>(dim);
                 }
-                break;
             case Kendall:
-                space = new hnswlib::KendallSpace(dim);
-                if (precision != Float32) {
-                    std::cerr<<"Warning: Kendal distance does not support other precision than float32\n";
+                switch (precision) {
+                    case Float16: return new hnswlib::KendallRankSpace<uint16_t>(dim);
+                    // Above 256 components, Float8 indices store 16 bits ranks
+                    case Float8:
+                        if (!hnswlib::ranks_fit<uint8_t>(dim)) return new hnswlib::KendallRankSpace<uint16_t>(dim);
+                        return new hnswlib::KendallRankSpace<uint8_t>(dim);
+                    case Float32: return new hnswlib::KendallSpace(dim);
+                    default:
+                        std::cerr<<"Warning: Kendall distance only supports float32, float16 and float8 precisions, using float32\n";
+                        return new hnswlib::KendallSpace(dim);
                 }
-                break;
             default:
                 throw std::runtime_error("Distance not supported: " + std::to_string(distance));
         }
-        normalize = distance == Angular;
-        decode_func_float16 = hnswlib::get_fast_encode_func<uint16_t, float>(dim);
-        encode_func_float16 = hnswlib::get_fast_encode_func<float, uint16_t>(dim);
-        decode_func_float8 = hnswlib::get_fast_decode_trained_func(dim);
-        encode_func_float8 = hnswlib::encode_trained_vector<float, uint8_t, hnswlib::encode_component, 1>;
+    }
+
+    /**
+     * Searches of HNSW indices with float32, float16 or bfloat16 vectors of some dimensions run a
+     * copy of the search loop built for their distance kernel, which it then inlines. nullptr for
+     * the others, searched with the kernel of the space called through a pointer.
+     **/
+    template<typename ALG>
+    static hnswlib::SearchKnnFunc<dist_t> newInlinedSearch(Distance distance, const int dim, const Precision precision) {
+    #if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+        switch (distance) {
+            case Euclidean:
+                switch (precision) {
+                    case Float32: return ALG::template getInlinedSearchFunc<hnswlib::L2SqrAVX2Fixed<float, float>, hnswlib::L2SqrAVX512Fixed<float, float>>(dim);
+                    case Float16: return ALG::template getInlinedSearchFunc<hnswlib::L2SqrAVX2Fixed<float, uint16_t>, hnswlib::L2SqrAVX512Fixed<float, uint16_t>>(dim);
+                    case BFloat16: return ALG::template getInlinedSearchFunc<hnswlib::L2SqrAVX2Fixed<float, hnswlib::bfloat16_t>, hnswlib::L2SqrAVX512Fixed<float, hnswlib::bfloat16_t>>(dim);
+                    default: return nullptr;
+                }
+            case Angular:
+            case InnerProduct:
+                switch (precision) {
+                    case Float32: return ALG::template getInlinedSearchFunc<hnswlib::InnerProductAVX2Fixed<float, float>, hnswlib::InnerProductAVX512Fixed<float, float>>(dim);
+                    case Float16: return ALG::template getInlinedSearchFunc<hnswlib::InnerProductAVX2Fixed<float, uint16_t>, hnswlib::InnerProductAVX512Fixed<float, uint16_t>>(dim);
+                    case BFloat16: return ALG::template getInlinedSearchFunc<hnswlib::InnerProductAVX2Fixed<float, hnswlib::bfloat16_t>, hnswlib::InnerProductAVX512Fixed<float, hnswlib::bfloat16_t>>(dim);
+                    default: return nullptr;
+                }
+            default:
+                return nullptr;
+        }
+    #else
+        return nullptr;
+    #endif
     }
 
     void initNewIndex(const size_t maxElements, const size_t M, const size_t efConstruction, const size_t random_seed) {
-        setAlgorithm(new hnswlib::HierarchicalNSW<dist_t>(space, maxElements, M, efConstruction, random_seed));
+        if (compact_labels) {
+            setAlgorithm(new hnswlib::HierarchicalNSW<dist_t, uint32_t>(space, maxElements, M, efConstruction, random_seed));
+            setInlinedSearch<hnswlib::HierarchicalNSW<dist_t, uint32_t>>();
+        } else {
+            setAlgorithm(new hnswlib::HierarchicalNSW<dist_t>(space, maxElements, M, efConstruction, random_seed));
+            setInlinedSearch<hnswlib::HierarchicalNSW<dist_t>>();
+        }
+    }
+
+    // Items stored in another layout than the encoded vector are searched through their space
+    template<typename ALG>
+    void setInlinedSearch() {
+        if (!norm_slot && !mips_space)
+            inlined_search = newInlinedSearch<ALG>(distance, dim, precision);
+    }
+
+    /**
+     * `useCompactLabels` - stores labels on 32 bits in HNSW indices created or loaded afterwards,
+     * saving 4 bytes per item. Adding a label above 2^32-1 then throws.
+     * Files saved with either width can be loaded with either setting.
+     **/
+    void useCompactLabels(bool compact) {
+        compact_labels = compact;
+    }
+
+    /**
+     * `useNormSlot` - Euclidean indices with Float32, Float16 or BFloat16 vectors store the squared
+     * norm of each item after its components, distances are then computed by the inner product
+     * kernels as |q|^2 + |x|^2 - 2 q.x. Costs 4 bytes per item and must be set before the index
+     * is created or loaded. Loads float32 index files or ones saved with the same setting.
+     **/
+    void useNormSlot(bool use) {
+        if (appr_alg || brute_alg)
+            throw std::runtime_error("The norm slot must be set before creating or loading the index");
+        if (use && (distance != Euclidean || (precision != Float32 && precision != Float16 && precision != BFloat16)))
+            throw std::runtime_error("The norm slot needs the Euclidean distance with Float32, Float16 or BFloat16 precision");
+        if (use == norm_slot)
+            return;
+        delete space;
+        if (!use) {
+            space = newSpace(distance, dim, precision);
+        } else {
+            switch (precision) {
+                case Float16: space = new hnswlib::L2NormSpace<uint16_t>(dim); break;
+                case BFloat16: space = new hnswlib::L2NormSpace<hnswlib::bfloat16_t>(dim); break;
+                default: space = new hnswlib::L2NormSpace<float>(dim);
+            }
+        }
+        norm_slot = use;
+    }
+
+    /**
+     * `useBinaryThresholds` - Binary indices set bit i when component i is above the mean of the
+     * training vectors instead of 0. The space then needs training, done on the items of the file
+     * when a float32 index is loaded. Must be set before the index is created or loaded.
+     **/
+    void useBinaryThresholds(bool use) {
+        if (appr_alg || brute_alg)
+            throw std::runtime_error("Binary thresholds must be set before creating or loading the index");
+        if (precision != Binary)
+            throw std::runtime_error("Thresholds only apply to the Binary precision");
+        delete space;
+        space = new hnswlib::HammingSpace(dim, use);
+    }
+
+    /**
+     * `usePQSubspaces` - number of sub-spaces of PQ indices, the bytes stored per item, dim / 4 by
+     * default. Each sub-space has a code to code distance table of 256 x 256 floats (256 KiB), 48 MiB
+     * at dim 768 with the default, fewer sub-spaces bound that memory at the cost of accuracy.
+     * Must be set before the space is trained and the index created or loaded.
+     **/
+    void usePQSubspaces(size_t m) {
+        if (appr_alg || brute_alg)
+            throw std::runtime_error("PQ sub-spaces must be set before creating or loading the index");
+        if (precision != PQ)
+            throw std::runtime_error("Sub-spaces only apply to the PQ precision");
+        if (m == 0 || m > (size_t) dim)
+            throw std::runtime_error("The number of PQ sub-spaces must be between 1 and the dimension");
+        delete space;
+        space = new hnswlib::PQSpace(dim, distance != Euclidean, m);
+    }
+
+    /**
+     * `useMipsTransform` - builds InnerProduct indices with Float32, Float16 or BFloat16 vectors
+     * in Euclidean space: items are stored as [x, sqrt(max_norm^2 - |x|^2)] and queries searched as
+     * [q, 0], at a distance of |q|^2 + max_norm^2 - 2 q.x. Inner products don't satisfy the
+     * triangle inequality, some unnormalized data gets better connected graphs this way while
+     * others keep a better recall without it, compare both at the same ef. Results are scored
+     * with inner products as without the transform.
+     *
+     *  * `max_norm` - bound of the norms of the items, adding a larger one throws. Loading an index
+     *    needs the transform with the value it was built with. Float32 indices built without
+     *    the transform are loaded too, their items being augmented as they are read.
+     **/
+    void useMipsTransform(float max_norm) {
+        if (appr_alg || brute_alg)
+            throw std::runtime_error("The MIPS transform must be set before creating or loading the index");
+        if (distance != InnerProduct || (precision != Float32 && precision != Float16 && precision != BFloat16))
+            throw std::runtime_error("The MIPS transform needs the InnerProduct distance with Float32, Float16 or BFloat16 precision");
+        if (rerank_store)
+            throw std::runtime_error("The MIPS transform can't be used with rerank");
+        if (!(max_norm > 0))
+            throw std::runtime_error("The MIPS max norm must be positive");
+        if (!mips_space) {
+            delete space;
+            space = newSpace(Euclidean, dim + 1, precision);
+            mips_space = newSpace(InnerProduct, dim, precision);
+            encode_func_float16 = hnswlib::get_fast_encode_func<float, uint16_t>(dim + 1);
+            encode_func_bfloat16 = hnswlib::get_fast_encode_func<float, hnswlib::bfloat16_t>(dim + 1);
+        }
+        mips_max_norm = max_norm;
+    }
+
+    // Items become [x, sqrt(max_norm^2 - |x|^2)], all at max_norm from the origin
+    dist_t* augmentItem(dist_t* item, std::vector<dist_t>& augmented) {
+        const auto norm = getL2Norm(item);
+        if (norm > mips_max_norm)
+            throw std::runtime_error("Item norm " + std::to_string(norm) + " is above the MIPS max norm " + std::to_string(mips_max_norm));
+        augmented.resize(dim + 1);
+        memcpy(augmented.data(), item, dim * sizeof(dist_t));
+        augmented[dim] = std::sqrt(std::max(0.f, mips_max_norm * mips_max_norm - norm * norm));
+        return augmented.data();
+    }
+
+    dist_t* augmentQuery(dist_t* query, std::vector<dist_t>& augmented) {
+        augmented.resize(dim + 1);
+        memcpy(augmented.data(), query, dim * sizeof(dist_t));
+        augmented[dim] = 0;
+        return augmented.data();
+    }
+
+    /**
+     * `enableRerank` - two-stage search: keeps a copy of the items added afterwards in
+     * `rerank_precision` (Float32, Float16 or BFloat16). Searches fetch `nb_candidates` items on
+     * the compact codes of the index (Binary, Float4, PQ...) and return the k closest by distances
+     * on that copy.
+     *
+     *  * `rerank_precision` - precision of the copy
+     *  * `nb_candidates` - candidates rescored per query, raised to k when lower
+     **/
+    void enableRerank(Precision rerank_precision, size_t nb_candidates) {
+        if (mips_space)
+            throw std::runtime_error("Rerank can't be used with the MIPS transform");
+        if (rerank_precision != Float32 && rerank_precision != Float16 && rerank_precision != BFloat16)
+            throw std::runtime_error("Unsupported rerank precision " + std::to_string(rerank_precision));
+        delete rerank_store;
+        rerank_store = new hnswlib::RerankStore(newSpace(distance, dim, rerank_precision));
+        this->rerank_precision = rerank_precision;
+        rerank_candidates = nb_candidates;
+    }
+
+    void setRerankCandidates(size_t nb_candidates) {
+        rerank_candidates = nb_candidates;
+    }
+
+    /**
+     * `saveRerankVectors` / `loadRerankVectors` - the rerank copy is saved apart from the index.
+     * Loading needs `enableRerank` with the precision it was saved with.
+     *
+     *  * `use_mmap` - maps the vectors read-only from the file instead of reading them in memory,
+     *    only the candidates of each search are paged in. Items can't be added afterwards.
+     **/
+    void saveRerankVectors(const std::string &path) {
+        if (!rerank_store)
+            throw std::runtime_error("Rerank is not enabled");
+        rerank_store->save(path);
+    }
+
+    void loadRerankVectors(const std::string &path, bool use_mmap) {
+        if (!rerank_store)
+            throw std::runtime_error("Rerank must be enabled with the precision of the vectors before loading them");
+        rerank_store->load(path, use_mmap);
     }
 
     void initBruteforce(const size_t maxElements) {
@@ -79,33 +320,155 @@ public:
         }
         appr_alg = algo;
         label_lookup_ = appr_alg->getLabelLookup();
+        inlined_search = nullptr;
+    }
+
+    /**
+     * `enableNumaReplicas` - keeps one read-only copy of the graph level 0 per NUMA node, queries
+     * are then served from the copy local to the calling thread. Costs one extra level 0 per node.
+     *
+     *  * `nb_replicas` - number of copies, 0 to use the number of NUMA nodes of the host, which
+     *    also bounds it
+     *
+     * Returns: number of copies serving queries
+     **/
+    size_t enableNumaReplicas(size_t nb_replicas = 0) {
+        return appr_alg->replicateLevel0(nb_replicas);
+    }
+
+    /**
+     * `freeze` - compacts the index into an immutable layout for serving: trimmed capacity,
+     * contiguous upper levels, sorted labels and no link locks. Items can't be added afterwards.
+     **/
+    void freeze() {
+        appr_alg->freeze();
+    }
+
+    void setEf(size_t ef) {
+        appr_alg->setEf(ef);
     }
 
     void saveIndex(const std::string &path_to_index) {
         appr_alg->saveIndex(path_to_index);
+        if (space->has_persistent_params()) {
+            saveSpaceParams(path_to_index);
+        }
+    }
+
+    /**
+     * Space params are appended to the index file as a trailer: params, their size and a magic
+     * number, read back from the end of the file. Index loaders ignore trailing bytes, so files
+     * with a trailer stay readable by older versions.
+     **/
+    void saveSpaceParams(const std::string &path_to_index) {
+        std::ofstream output(path_to_index, std::ios::binary | std::ios::app);
+        const auto start = output.tellp();
+        space->save_params(output);
+        const uint64_t params_size = output.tellp() - start;
+        hnswlib::writeBinaryPOD(output, params_size);
+        hnswlib::writeBinaryPOD(output, space_params_magic);
+    }
+
+    // Returns false when the file has no space params trailer
+    bool loadSpaceParams(const std::string &path_to_index) {
+        std::ifstream input(path_to_index, std::ios::binary);
+        uint64_t params_size = 0, magic = 0;
+        if (!input.seekg(-2 * (std::streamoff) sizeof(uint64_t), std::ios::end))
+            return false;
+        hnswlib::readBinaryPOD(input, params_size);
+        hnswlib::readBinaryPOD(input, magic);
+        if (!input || magic != space_params_magic)
+            return false;
+        input.seekg(-2 * (std::streamoff) sizeof(uint64_t) - (std::streamoff) params_size, std::ios::end);
+        space->load_params(input);
+        return true;
+    }
+
+    /**
+     * Size of the vectors of an index file, from its header. MIPS indices read it to tell float32
+     * items to augment from items of MIPS indices.
+     **/
+    static size_t loadDataSize(const std::string &path_to_index, bool bruteforce) {
+        std::ifstream input(path_to_index, std::ios::binary);
+        size_t fields[6];
+        const size_t nb_fields = bruteforce ? 2 : 6;
+        for (size_t i = 0; i < nb_fields; i++) {
+            hnswlib::readBinaryPOD(input, fields[i]);
+        }
+        if (!input)
+            throw std::runtime_error("Cannot read the header of index " + path_to_index);
+        // Bruteforce: elements of vector and label. HNSW: vector between offsetData_ and label_offset_
+        return bruteforce ? fields[1] - sizeof(hnswlib::labeltype) : fields[4] - fields[5];
+    }
+
+    /**
+     * Loads items into a MIPS index with `encode`: as they are when of the size of the space,
+     * encoded when they are float32 of a MIPS index, augmented then encoded when they are float32
+     * of an index built without the transform.
+     **/
+    template<typename DST>
+    hnswlib::DECODEFUNC<float, DST, size_t> mipsDecoder(size_t src_data_size, const hnswlib::DECODEFUNC<float, DST, size_t> &encode) {
+        if (src_data_size == space->get_data_size() || src_data_size == (dim + 1) * sizeof(float))
+            return encode;
+        if (src_data_size != dim * sizeof(float))
+            throw std::runtime_error("MIPS indices load float32 indices or MIPS indices of their precision");
+        std::vector<dist_t> augmented;
+        return [this, encode, augmented](const float *src, DST *dst, const size_t *param) mutable {
+            encode(augmentItem(const_cast<float *>(src), augmented), dst, param);
+        };
     }
 
     void loadIndex(const std::string &path_to_index) {
-        auto algo = new hnswlib::HierarchicalNSW<dist_t>(space);
-        switch (precision) {
-            case Float32: algo->template loadAndDecode<float, float, size_t>(path_to_index, space, nullptr); break;
-            case Float16: algo->template loadAndDecode<float, uint16_t, size_t>(path_to_index, space, encode_func_float16); break;
-            case Float8:  algo->template loadAndDecode<float, uint8_t, hnswlib::TrainParams>(path_to_index, space, encode_func_float8); break;
-            default: throw std::runtime_error("Unsupported precision " + std::to_string(precision));
+        if (space->has_persistent_params()) {
+            loadSpaceParams(path_to_index);
+        }
+        if (compact_labels) {
+            loadIndex(path_to_index, new hnswlib::HierarchicalNSW<dist_t, uint32_t>(space));
+        } else {
+            loadIndex(path_to_index, new hnswlib::HierarchicalNSW<dist_t>(space));
         }
+    }
+
+    template<typename label_t>
+    void loadIndex(const std::string &path_to_index, hnswlib::HierarchicalNSW<dist_t, label_t> *algo) {
+        loadItems(path_to_index, algo, false);
         setAlgorithm(algo);
+        setInlinedSearch<hnswlib::HierarchicalNSW<dist_t, label_t>>();
     }
 
     // TODO: Unify with loadIndex
     void loadBruteforce(const std::string &path_to_index) {
+        if (space->has_persistent_params()) {
+            loadSpaceParams(path_to_index);
+        }
         auto algo = new hnswlib::BruteforceSearch<dist_t>(space, 0);
+        loadItems(path_to_index, algo, true);
+        setAlgorithm(algo);
+    }
+
+    // Reads the items of the file into `algo`, encoded in the precision of the index
+    template<typename ALG>
+    void loadItems(const std::string &path_to_index, ALG *algo, bool bruteforce) {
+        if (encodesRanks(precision)) {
+            if (encodesRanks16(precision)) algo->template loadAndDecode<float, uint16_t, size_t>(path_to_index, space, encode_func_rank16);
+            else algo->template loadAndDecode<float, uint8_t, size_t>(path_to_index, space, encode_func_rank8);
+            return;
+        }
+        const auto src_data_size = mips_space ? loadDataSize(path_to_index, bruteforce) : 0;
         switch (precision) {
-            case Float32: algo->template loadAndDecode<float, float, size_t>(path_to_index, space, nullptr); break;
-            case Float16: algo->template loadAndDecode<float, uint16_t, size_t>(path_to_index, space, encode_func_float16); break;
+            case Float32: algo->template loadAndDecode<float, float, size_t>(path_to_index, space,
+                mips_space ? mipsDecoder(src_data_size, copy_func_float32) : norm_slot ? copy_func_float32 : nullptr); break;
+            case Float16: algo->template loadAndDecode<float, uint16_t, size_t>(path_to_index, space,
+                mips_space ? mipsDecoder(src_data_size, encode_func_float16) : encode_func_float16); break;
+            case BFloat16: algo->template loadAndDecode<float, hnswlib::bfloat16_t, size_t>(path_to_index, space,
+                mips_space ? mipsDecoder(src_data_size, encode_func_bfloat16) : encode_func_bfloat16); break;
             case Float8:  algo->template loadAndDecode<float, uint8_t, hnswlib::TrainParams>(path_to_index, space, encode_func_float8); break;
+            case Float4:  algo->template loadAndDecode<float, uint8_t, hnswlib::TrainParams>(path_to_index, space, encode_func_float4); break;
+            case PQ:      algo->template loadAndDecode<float, uint8_t, hnswlib::PQParams>(path_to_index, space, encode_func_pq); break;
+            case Int8Symmetric: algo->template loadAndDecode<float, int8_t, hnswlib::Int8Params>(path_to_index, space, encode_func_int8); break;
+            case Binary:  algo->template loadAndDecode<float, uint8_t, hnswlib::HammingParams>(path_to_index, space, encode_func_binary); break;
             default: throw std::runtime_error("Unsupported precision " + std::to_string(precision));
         }
-        setAlgorithm(algo);
     }
 
     void normalizeVector(dist_t *data, dist_t *norm_array){
@@ -124,17 +487,37 @@ public:
     }
 
     void addItem(dist_t* vector, size_t id) {
+        if (rerank_store && rerank_store->isReadOnly())
+            throw std::runtime_error("Items can't be added with rerank vectors mapped from a file");
         std::vector<dist_t> norm_array;
         std::vector<char> encoded_vector;
         const auto normalized_data = normalizeItem(vector, norm_array);
         const auto vector_data = encodeItem(normalized_data, encoded_vector);
-        appr_alg->addPoint(vector_data, (size_t) id);
+        if (!rerank_store) {
+            appr_alg->addPoint(vector_data, (size_t) id);
+            return;
+        }
+        // Stored before the item can be found by searches, which rescore it right away, and
+        // reverted when the index refuses the item
+        std::vector<char> encoded_rerank_vector, replaced_rerank_vector;
+        rerank_store->add(id, encodeRerankItem(normalized_data, encoded_rerank_vector), &replaced_rerank_vector);
+        try {
+            appr_alg->addPoint(vector_data, (size_t) id);
+        } catch (...) {
+            rerank_store->revert(id, replaced_rerank_vector);
+            throw;
+        }
     }
 
     size_t getNbItems() {
         return appr_alg->getNbItems();
     }
 
+    /**
+     * `getItem` - stored vector of `label`, encoded in the precision of the index, `decode` turns
+     * it back into floats. Kendall indices of Float16 or Float8 precision store the ranks of the
+     * components, their items decode to ranks rather than to the added values.
+     **/
     void* getItem(size_t label) {
         hnswlib::tableint label_c;
         auto search = label_lookup_->find(label);
@@ -162,30 +545,99 @@ public:
         return item;
     }
 
+    // Kendall indices store the ranks of the components in 16 or 8 bits, see `newSpace`
+    bool encodesRanks(Precision item_precision) const {
+        return distance == Kendall && (item_precision == Float16 || item_precision == Float8);
+    }
+
+    bool encodesRanks16(Precision item_precision) const {
+        return item_precision == Float16 || !hnswlib::ranks_fit<uint8_t>(dim);
+    }
+
+    void encodeRanks(Precision item_precision, dist_t* src, void* dst) {
+        if (encodesRanks16(item_precision)) encode_func_rank16(src, reinterpret_cast<uint16_t *>(dst), &dim);
+        else encode_func_rank8(src, reinterpret_cast<uint8_t *>(dst), &dim);
+    }
+
+    void decodeRanks(Precision item_precision, void* src, dist_t* dst) {
+        if (encodesRanks16(item_precision)) decode_func_rank16(reinterpret_cast<uint16_t *>(src), dst, &dim);
+        else decode_func_rank8(reinterpret_cast<uint8_t *>(src), dst, &dim);
+    }
+
     void* encodeItem(dist_t* item, std::vector<char>& encoded_vector) {
-        if (precision == Float32) {
+        if (precision == Float32 && !norm_slot && !mips_space) {
             return item;
         }
         encoded_vector.resize(space->get_data_size());
         return encode(item, reinterpret_cast<void*>(encoded_vector.data()));
     }
 
+    void* encodeRerankItem(dist_t* item, std::vector<char>& encoded_vector) {
+        encoded_vector.resize(rerank_store->space()->get_data_size());
+        const auto dst = encoded_vector.data();
+        if (encodesRanks(rerank_precision)) {
+            encodeRanks(rerank_precision, item, dst);
+            return dst;
+        }
+        switch (rerank_precision) {
+            case Float32: return item;
+            case Float16: encode_func_float16(item, reinterpret_cast<uint16_t *>(dst), &dim); return dst;
+            case BFloat16: encode_func_bfloat16(item, reinterpret_cast<hnswlib::bfloat16_t *>(dst), &dim); return dst;
+            default: throw std::runtime_error("Unsupported rerank precision " + std::to_string(rerank_precision));
+        }
+    }
+
     void* encode(dist_t* src, void* dst) {
+        space->complete_training();
         const auto param = space->get_dist_func_param();
+        if (norm_slot || mips_space) {
+            std::vector<dist_t> augmented;
+            const auto item = mips_space ? augmentItem(src, augmented) : src;
+            switch (precision) {
+                case Float16: encode_func_float16(item, reinterpret_cast<uint16_t *>(dst), static_cast<const size_t*>(param)); break;
+                case BFloat16: encode_func_bfloat16(item, reinterpret_cast<hnswlib::bfloat16_t *>(dst), static_cast<const size_t*>(param)); break;
+                default: copy_func_float32(item, reinterpret_cast<float *>(dst), static_cast<const size_t*>(param));
+            }
+            space->complete_item(dst);
+            return dst;
+        }
+        if (encodesRanks(precision)) {
+            encodeRanks(precision, src, dst);
+            return dst;
+        }
         switch (precision) {
             case Float32: return src;
             case Float16: encode_func_float16(src, reinterpret_cast<uint16_t *>(dst), static_cast<const size_t*>(param)); return dst;
+            case BFloat16: encode_func_bfloat16(src, reinterpret_cast<hnswlib::bfloat16_t *>(dst), static_cast<const size_t*>(param)); return dst;
             case Float8:  encode_func_float8(src, reinterpret_cast<uint8_t *>(dst), static_cast<const hnswlib::TrainParams*>(param)); return dst;
+            case Float4:  encode_func_float4(src, reinterpret_cast<uint8_t *>(dst), static_cast<const hnswlib::TrainParams*>(param)); return dst;
+            case PQ:      encode_func_pq(src, reinterpret_cast<uint8_t *>(dst), static_cast<const hnswlib::PQParams*>(param)); return dst;
+            case Int8Symmetric: encode_func_int8(src, reinterpret_cast<int8_t *>(dst), static_cast<const hnswlib::Int8Params*>(param)); return dst;
+            case Binary:  encode_func_binary(src, reinterpret_cast<uint8_t *>(dst), static_cast<const hnswlib::HammingParams*>(param)); return dst;
             default: throw std::runtime_error("Unsupported precision " + std::to_string(precision));
         }
     }
 
     dist_t* decode(void* src, dist_t* dst) {
-        const auto param = space->get_dist_func_param();
+        // The first `dim` components of items with a norm slot or a MIPS coordinate
+        const auto param = mips_space ? mips_space->get_dist_func_param() : space->get_dist_func_param();
+        if (precision == Float32 && (norm_slot || mips_space)) {
+            copy_func_float32(static_cast<dist_t*>(src), dst, &dim);
+            return dst;
+        }
+        if (encodesRanks(precision)) {
+            decodeRanks(precision, src, dst);
+            return dst;
+        }
         switch (precision) {
             case Float32: return static_cast<dist_t*>(src);
             case Float16: decode_func_float16(reinterpret_cast<uint16_t *>(src), dst, static_cast<const size_t*>(param)); return dst;
+            case BFloat16: decode_func_bfloat16(reinterpret_cast<hnswlib::bfloat16_t *>(src), dst, static_cast<const size_t*>(param)); return dst;
             case Float8:  decode_func_float8(reinterpret_cast<uint8_t *>(src), dst, static_cast<const hnswlib::TrainParams*>(param)); return dst;
+            case Float4:  decode_func_float4(reinterpret_cast<uint8_t *>(src), dst, static_cast<const hnswlib::TrainParams*>(param)); return dst;
+            case PQ:      decode_func_pq(reinterpret_cast<uint8_t *>(src), dst, static_cast<const hnswlib::PQParams*>(param)); return dst;
+            case Int8Symmetric: decode_func_int8(reinterpret_cast<int8_t *>(src), dst, static_cast<const hnswlib::Int8Params*>(param)); return dst;
+            case Binary:  decode_func_binary(reinterpret_cast<uint8_t *>(src), dst, static_cast<const hnswlib::HammingParams*>(param)); return dst;
             default: throw std::runtime_error("Unsupported precision " + std::to_string(precision));
         }
     }
@@ -208,13 +660,24 @@ public:
     template<bool bruteforce_search=false>
     size_t knnQuery(dist_t* query, size_t* result_labels, dist_t* result_distances, data_t** results_pointers, size_t k) {
         std::vector<dist_t> norm_array;
-        const auto query_data = normalizeItem(query, norm_array);
+        std::vector<char> query_buffer;
+        const auto normalized_query = normalizeItem(query, norm_array);
+        std::vector<dist_t> augmented;
+        const auto query_data = space->prepare_query(mips_space ? augmentQuery(normalized_query, augmented) : normalized_query, query_buffer);
+        const auto nb_candidates = rerank_store ? std::max(k, rerank_candidates) : k;
 
         std::priority_queue<std::pair<dist_t, hnswlib::tableint >> result;
-        if(!bruteforce_search) {
-            result = appr_alg->searchKnn(query_data, k);
+        if (!bruteforce_search && inlined_search) {
+            result = inlined_search(appr_alg, query_data, nb_candidates);
+        } else if(!bruteforce_search) {
+            result = appr_alg->searchKnn(query_data, nb_candidates);
         } else {
-            result = brute_alg->searchKnn(query_data, k, appr_alg);
+            result = brute_alg->searchKnn(query_data, nb_candidates, appr_alg);
+        }
+        if (rerank_store) {
+            result = rerank(normalized_query, result, k);
+        } else if (mips_space) {
+            result = rescore(normalized_query, result);
         }
         const auto nbResults = result.size();
 
@@ -228,34 +691,103 @@ public:
         return nbResults;
     }
 
+    // Rescores candidates on the rerank store, keeping the k closest
+    std::priority_queue<std::pair<dist_t, hnswlib::tableint>>
+    rerank(dist_t* query, std::priority_queue<std::pair<dist_t, hnswlib::tableint>>& candidates, size_t k) {
+        std::vector<char> query_buffer;
+        const auto query_data = rerank_store->space()->prepare_query(query, query_buffer);
+        std::vector<hnswlib::tableint> internal_ids;
+        std::vector<hnswlib::labeltype> labels;
+        while (!candidates.empty()) {
+            internal_ids.push_back(candidates.top().second);
+            labels.push_back(appr_alg->getExternalLabel(candidates.top().second));
+            candidates.pop();
+        }
+        std::vector<dist_t> distances(labels.size());
+        rerank_store->distances(query_data, labels.data(), labels.size(), distances.data());
+        std::priority_queue<std::pair<dist_t, hnswlib::tableint>> result;
+        for (size_t i = 0; i < labels.size(); i++) {
+            result.emplace(distances[i], internal_ids[i]);
+            if (result.size() > k)
+                result.pop();
+        }
+        return result;
+    }
+
+    // Inner product distances of the candidates of a MIPS transformed search, in the same order
+    std::priority_queue<std::pair<dist_t, hnswlib::tableint>>
+    rescore(dist_t* query, std::priority_queue<std::pair<dist_t, hnswlib::tableint>>& candidates) {
+        std::vector<char> query_buffer;
+        const auto query_data = mips_space->prepare_query(query, query_buffer);
+        const auto func = mips_space->get_search_dist_func();
+        const auto param = mips_space->get_dist_func_param();
+        std::priority_queue<std::pair<dist_t, hnswlib::tableint>> result;
+        while (!candidates.empty()) {
+            const auto internal_id = candidates.top().second;
+            candidates.pop();
+            result.emplace(func(query_data, appr_alg->getDataByInternalId(internal_id), param), internal_id);
+        }
+        return result;
+    }
+
     dist_t getDistanceBetweenLabels(size_t label1, size_t label2) {
         return getDistanceBetweenVectors(getItem(label1), getItem(label2));
     }
 
     dist_t getDistanceBetweenVectors(void* vector1, void* vector2) {
-        const auto func = space->get_dist_func();
-        return func(vector1, vector2, &dim);
+        const auto scoring_space = mips_space ? mips_space : space;
+        const auto func = scoring_space->get_dist_func();
+        return func(vector1, vector2, scoring_space->get_dist_func_param());
     }
 
     hnswlib::SpaceInterface<float>* space;
     const size_t dim;
     bool normalize = false;
+    bool compact_labels = false;
+    bool norm_slot = false;
+    // Inner product space scoring MIPS transformed indices, searched in `space`
+    hnswlib::SpaceInterface<float>* mips_space = nullptr;
+    float mips_max_norm = 0;
+    hnswlib::DECODEFUNC<dist_t, float, size_t> copy_func_float32 = [](const float *src, float *dst, const size_t *dim) {
+        memcpy(dst, src, *dim * sizeof(float));
+    };
     hnswlib::DECODEFUNC<dist_t, uint16_t, size_t> encode_func_float16;
     hnswlib::DECODEFUNC<uint16_t, dist_t, size_t> decode_func_float16;
+    hnswlib::DECODEFUNC<dist_t, hnswlib::bfloat16_t, size_t> encode_func_bfloat16;
+    hnswlib::DECODEFUNC<hnswlib::bfloat16_t, dist_t, size_t> decode_func_bfloat16;
     hnswlib::DECODEFUNC<dist_t, uint8_t, hnswlib::TrainParams> encode_func_float8;
     hnswlib::DECODEFUNC<uint8_t, dist_t, hnswlib::TrainParams> decode_func_float8;
+    hnswlib::DECODEFUNC<dist_t, uint16_t, size_t> encode_func_rank16 = hnswlib::encode_rank_vector<uint16_t>;
+    hnswlib::DECODEFUNC<uint16_t, dist_t, size_t> decode_func_rank16 = hnswlib::decode_rank_vector<uint16_t>;
+    hnswlib::DECODEFUNC<dist_t, uint8_t, size_t> encode_func_rank8 = hnswlib::encode_rank_vector<uint8_t>;
+    hnswlib::DECODEFUNC<uint8_t, dist_t, size_t> decode_func_rank8 = hnswlib::decode_rank_vector<uint8_t>;
+    hnswlib::DECODEFUNC<dist_t, uint8_t, hnswlib::TrainParams> encode_func_float4;
+    hnswlib::DECODEFUNC<uint8_t, dist_t, hnswlib::TrainParams> decode_func_float4;
+    hnswlib::DECODEFUNC<dist_t, int8_t, hnswlib::Int8Params> encode_func_int8;
+    hnswlib::DECODEFUNC<int8_t, dist_t, hnswlib::Int8Params> decode_func_int8;
+    hnswlib::DECODEFUNC<dist_t, uint8_t, hnswlib::HammingParams> encode_func_binary;
+    hnswlib::DECODEFUNC<uint8_t, dist_t, hnswlib::HammingParams> decode_func_binary;
+    hnswlib::DECODEFUNC<dist_t, uint8_t, hnswlib::PQParams> encode_func_pq;
+    hnswlib::DECODEFUNC<uint8_t, dist_t, hnswlib::PQParams> decode_func_pq;
     const Precision precision;
     const Distance distance;
     hnswlib::AlgorithmInterface<dist_t> * appr_alg = nullptr;
+    hnswlib::SearchKnnFunc<dist_t> inlined_search = nullptr;
     hnswlib::BruteforceSearchAlg<dist_t> * brute_alg = nullptr;
-    std::unordered_map<hnswlib::labeltype, hnswlib::tableint> * label_lookup_ = nullptr;
+    hnswlib::LabelLookup * label_lookup_ = nullptr;
+    hnswlib::RerankStore * rerank_store = nullptr;
+    Precision rerank_precision = Float32;
+    size_t rerank_candidates = 0;
 
     ~Index() {
         delete space;
+        delete mips_space;
         if (brute_alg)
             delete brute_alg;
         if (appr_alg)
             delete appr_alg;
+        if (rerank_store)
+            delete rerank_store;
     }
 };
 
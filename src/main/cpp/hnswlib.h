@@ -29,12 +29,18 @@
 
 #include <functional>
 #include <queue>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include <stdexcept>
 #include <unordered_map>
 #include <string.h>
+#include "flat_hash_map.h"
 
 namespace hnswlib {
     typedef size_t labeltype;
     typedef unsigned int tableint;
+    typedef FlatHashMap<labeltype, tableint> LabelLookup;
 
     template<typename T>
     static void writeBinaryPOD(std::ostream &out, const T &podRef) {
@@ -49,6 +55,10 @@ namespace hnswlib {
     template<typename MTYPE>
     using DISTFUNC = MTYPE(*)(const void *, const void *, const void *);
 
+    // Distances from a query to `n` vectors, written to the output array
+    template<typename MTYPE>
+    using DISTBATCHFUNC = void(*)(const void *, const void *const *, size_t, const void *, MTYPE *);
+
     template<typename SRC, typename DST, typename PARAM>
     using DECODEFUNC = std::function<void(const SRC*, DST*, const PARAM*)>;
 
@@ -62,17 +72,52 @@ namespace hnswlib {
 
         virtual DISTFUNC<MTYPE> get_search_dist_func() const = 0;
 
+        // Search distances to several vectors in one call, nullptr to call the search distance on each
+        virtual DISTBATCHFUNC<MTYPE> get_search_dist_batch_func() const {
+            return nullptr;
+        }
+
         virtual bool needs_initialization() const {
             return false;
         }
 
         virtual void train(const float* vectors) {}
 
+        // Ends training once every training vector is passed, called before the first item is encoded
+        virtual void complete_training() {}
+
         virtual void *get_dist_func_param() = 0;
 
+        /**
+         * Turns a query into the first argument of the search distance function, for spaces
+         * precomputing per-query state. `buffer` holds that state for the duration of the search.
+         **/
+        virtual const void *prepare_query(const float *query, std::vector<char> &buffer) const {
+            return query;
+        }
+
+        // Fills what an encoded item stores after its components, called before the item is added
+        virtual void complete_item(void *data) const {}
+
+        // Trained state that can't be rebuilt from the index data, persisted along with it
+        virtual bool has_persistent_params() const {
+            return false;
+        }
+
+        virtual void save_params(std::ostream &output) const {}
+
+        virtual void load_params(std::istream &input) {}
+
         virtual ~SpaceInterface() {}
     };
 
+    template<typename dist_t>
+    class AlgorithmInterface;
+
+    // Search specialized for a given index type and kernel, see `HierarchicalNSW::getInlinedSearchFunc`
+    template<typename dist_t>
+    using SearchKnnFunc = std::priority_queue<std::pair<dist_t, tableint>>(*)(const AlgorithmInterface<dist_t> *, const void *, size_t);
+
     template<typename dist_t>
     class AlgorithmInterface {
     public:
@@ -84,7 +129,15 @@ namespace hnswlib {
         virtual inline char *getDataByInternalId(tableint internal_id) const = 0;
         virtual inline labeltype getExternalLabel(tableint internal_id) const = 0;
         virtual inline size_t getNbItems() const = 0;
-        virtual inline std::unordered_map<labeltype, tableint> * getLabelLookup()=0;
+        virtual inline LabelLookup * getLabelLookup()=0;
+        // Search time and serving layout options, no-op or unsupported for exhaustive indices
+        virtual void setEf(size_t ef) {}
+        virtual size_t replicateLevel0(size_t nb_replicas) {
+            throw std::runtime_error("NUMA replicas are only supported by HNSW indices");
+        }
+        virtual void freeze() {
+            throw std::runtime_error("Freezing is only supported by HNSW indices");
+        }
     };
 
 
@@ -95,8 +148,13 @@ namespace hnswlib {
 #include "float8.h"
 #include "encoding.h"
 #include "space_ip.h"
+#include "space_l2_norm.h"
 #include "space_ip_train.h"
 #include "space_l2_train.h"
+#include "space_float4.h"
 #include "space_kendall.h"
+#include "space_pq.h"
+#include "space_int8.h"
+#include "space_hamming.h"
 #include "bruteforce.h"
 #include "hnswalg.h"
@@ -0,0 +1,39 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include <stdint.h>
+
+namespace hnswlib {
+
+    // Codes are kept in [-127, 127] so that |code| fits a signed byte
+    static const float int8_max_value = 127.f;
+
+    /**
+     * Symmetric int8 quantization: component x is stored as round(x / scale), one scale for all
+     * the components, set from the largest absolute value seen while training.
+     **/
+    struct Int8Params {
+        size_t dim;
+        float scale;
+
+        explicit Int8Params(size_t dim): dim(dim), scale(1.f) {}
+    };
+
+    static inline int8_t encode_int8_component(float x, float scale) {
+        const auto code = std::round(x / scale);
+        return static_cast<int8_t>(std::min(std::max(code, -int8_max_value), int8_max_value));
+    }
+
+    // Encoding F32 -> I8, values out of the trained range are clamped
+    static inline void encode_int8_vector(const float *src, int8_t *dst, const Int8Params *param_ptr) {
+        for (size_t i = 0; i < param_ptr->dim; i++) {
+            dst[i] = encode_int8_component(src[i], param_ptr->scale);
+        }
+    }
+
+    static inline void decode_int8_vector(const int8_t *src, float *dst, const Int8Params *param_ptr) {
+        for (size_t i = 0; i < param_ptr->dim; i++) {
+            dst[i] = param_ptr->scale * src[i];
+        }
+    }
+}
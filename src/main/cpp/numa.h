@@ -0,0 +1,146 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace hnswlib {
+
+    // Parses sysfs cpu/node lists such as "0-3,8,10-11"
+    static std::vector<int> parse_sysfs_list(const std::string &list) {
+        std::vector<int> values;
+        size_t pos = 0;
+        while (pos < list.size()) {
+            auto end = list.find(',', pos);
+            if (end == std::string::npos) end = list.size();
+            const auto range = list.substr(pos, end - pos);
+            const auto dash = range.find('-');
+            if (!range.empty() && range[0] != '\n') {
+                const int first = atoi(range.c_str());
+                const int last = dash == std::string::npos ? first : atoi(range.c_str() + dash + 1);
+                for (int v = first; v <= last; v++) values.push_back(v);
+            }
+            pos = end + 1;
+        }
+        return values;
+    }
+
+    static std::string read_sysfs_line(const std::string &path) {
+        std::ifstream input(path);
+        std::string line;
+        std::getline(input, line);
+        return line;
+    }
+
+    /**
+     * Snapshot of the NUMA layout of the host, read from sysfs once.
+     * Without sysfs (or off Linux) the host is seen as a single node.
+     **/
+    class NumaTopology {
+    public:
+        NumaTopology() {
+            auto nodes = parse_sysfs_list(read_sysfs_line("/sys/devices/system/node/online"));
+            if (nodes.empty()) nodes.push_back(0);
+            for (auto node: nodes) {
+                for (auto cpu: parse_sysfs_list(read_sysfs_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"))) {
+                    if (cpu >= (int) cpu_to_node_.size()) cpu_to_node_.resize(cpu + 1, 0);
+                    cpu_to_node_[cpu] = node;
+                }
+            }
+            nodes_ = nodes;
+        }
+
+        size_t getNbNodes() const {
+            return nodes_.size();
+        }
+
+        // Ids of the online nodes, which need not be contiguous
+        const std::vector<int> &getNodes() const {
+            return nodes_;
+        }
+
+        // Node of the cpu the calling thread currently runs on (sched_getcpu is served by the vDSO)
+        int getCurrentNode() const {
+#if defined(__linux__)
+            const int cpu = sched_getcpu();
+            if (cpu >= 0 && cpu < (int) cpu_to_node_.size()) {
+                return cpu_to_node_[cpu];
+            }
+#endif
+            return 0;
+        }
+
+    private:
+        std::vector<int> nodes_;
+        std::vector<int> cpu_to_node_;
+    };
+
+    /**
+     * Copies `size` bytes of `src` into memory whose pages are preferably placed on `node`.
+     * Placement is best effort: if the policy can't be applied, the copy is still returned.
+     **/
+#if defined(__linux__)
+    // Preferred placement of the pages of [ptr, ptr + size) on `node`, `flags` as of mbind(2)
+    static void numa_bind(void *ptr, size_t size, int node, unsigned flags) {
+        const int mpol_preferred = 1;
+        unsigned long nodemask;
+        if (node < (int) (8 * sizeof(nodemask))) {
+            nodemask = 1UL << node;
+            syscall(SYS_mbind, ptr, size, mpol_preferred, &nodemask, 8 * sizeof(nodemask) + 1, flags);
+        }
+    }
+#endif
+
+    static char *numa_alloc_copy(const char *src, size_t size, int node) {
+#if defined(__linux__)
+        void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            throw std::runtime_error("Not enough memory");
+        // Pages are not touched yet, so the policy applies to the copy below
+        numa_bind(ptr, size, node, 0);
+        memcpy(ptr, src, size);
+        return static_cast<char *>(ptr);
+#else
+        auto ptr = static_cast<char *>(malloc(size));
+        if (ptr == nullptr)
+            throw std::runtime_error("Not enough memory");
+        memcpy(ptr, src, size);
+        return ptr;
+#endif
+    }
+
+    /**
+     * Moves the pages of memory already written, e.g. by malloc, to `node`. Only the whole pages
+     * inside [ptr, ptr + size) move, the ones at its ends may hold other allocations.
+     * Best effort like `numa_alloc_copy`.
+     **/
+    static void numa_move(char *ptr, size_t size, int node) {
+#if defined(__linux__)
+        const auto page_size = (uintptr_t) sysconf(_SC_PAGESIZE);
+        const auto begin = ((uintptr_t) ptr + page_size - 1) / page_size * page_size;
+        const auto end = ((uintptr_t) ptr + size) / page_size * page_size;
+        const unsigned mpol_mf_move = 1 << 1;
+        if (end > begin)
+            numa_bind((void *) begin, end - begin, node, mpol_mf_move);
+#endif
+    }
+
+    static void numa_free(char *ptr, size_t size) {
+#if defined(__linux__)
+        munmap(ptr, size);
+#else
+        free(ptr);
+#endif
+    }
+}
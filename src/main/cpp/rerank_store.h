@@ -0,0 +1,296 @@
+#pragma once
+#include "hnswlib.h"
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#define HNSW_RERANK_MMAP
+#endif
+
+namespace hnswlib {
+
+    // "HNSWRRK1", marks rerank vector files
+    static const uint64_t rerank_store_magic = 0x314b525257534e48ULL;
+
+    /**
+     * Readers-writer lock, std::shared_mutex being C++17. A waiting writer blocks new readers,
+     * so adds aren't starved by a steady flow of searches.
+     **/
+    class SharedMutex {
+    public:
+        void lock() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            released_.wait(lock, [this]() { return !writer_; });
+            writer_ = true;
+            released_.wait(lock, [this]() { return readers_ == 0; });
+        }
+
+        void unlock() {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                writer_ = false;
+            }
+            released_.notify_all();
+        }
+
+        void lock_shared() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            released_.wait(lock, [this]() { return !writer_; });
+            readers_++;
+        }
+
+        void unlock_shared() {
+            bool last;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                last = --readers_ == 0;
+            }
+            if (last)
+                released_.notify_all();
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable released_;
+        size_t readers_ = 0;
+        bool writer_ = false;
+    };
+
+    class SharedLock {
+    public:
+        explicit SharedLock(SharedMutex &mutex) : mutex_(mutex) {
+            mutex_.lock_shared();
+        }
+
+        ~SharedLock() {
+            mutex_.unlock_shared();
+        }
+
+        SharedLock(const SharedLock &) = delete;
+        SharedLock &operator=(const SharedLock &) = delete;
+
+    private:
+        SharedMutex &mutex_;
+    };
+
+    /**
+     * Second copy of the items, by label, in a more precise space than the one of the index.
+     * Candidates of a search on compact codes are rescored against it.
+     *
+     * Files hold the magic, the data size, the number of items, their labels then their vectors,
+     * so the vectors can be mapped as is.
+     *
+     * Items can be added while searches rescore: adds and loads hold the lock exclusively, reads
+     * share it, since growing the rows or the vectors moves them.
+     **/
+    class RerankStore {
+    public:
+        // `space` is owned by the store
+        explicit RerankStore(SpaceInterface<float> *space)
+            : space_(space)
+            , data_size_(space->get_data_size())
+            , fstdist_search_func_(space->get_search_dist_func())
+            , dist_func_param_(space->get_dist_func_param()) {
+        }
+
+        bool isReadOnly() const {
+            SharedLock lock(lock_);
+            return mapped_ != nullptr;
+        }
+
+        /**
+         * Copies the encoded item, replacing the one of an existing label. The replaced vector is
+         * copied into `replaced` when given, which is left empty for a new label.
+         **/
+        void add(labeltype label, const void *data, std::vector<char> *replaced = nullptr) {
+            std::unique_lock<SharedMutex> lock(lock_);
+            // Checked under the lock, `load` may map vectors concurrently
+            if (mapped_ != nullptr)
+                throw std::runtime_error("Rerank vectors mapped from a file are read-only");
+            auto search = rows_.find(label);
+            size_t row;
+            if (search == rows_.end()) {
+                row = rows_.size();
+                rows_[label] = row;
+                labels_.push_back(label);
+                data_.resize(data_.size() + data_size_);
+                if (replaced) replaced->clear();
+            } else {
+                row = search->second;
+                if (replaced) replaced->assign(data_.data() + row * data_size_, data_.data() + (row + 1) * data_size_);
+            }
+            memcpy(data_.data() + row * data_size_, data, data_size_);
+        }
+
+        // Undoes `add` of `label`: restores the `replaced` vector, or removes the label when empty
+        void revert(labeltype label, const std::vector<char> &replaced) {
+            std::unique_lock<SharedMutex> lock(lock_);
+            auto search = rows_.find(label);
+            if (search == rows_.end())
+                return;
+            const auto row = search->second;
+            if (!replaced.empty()) {
+                memcpy(data_.data() + row * data_size_, replaced.data(), data_size_);
+                return;
+            }
+            // The last row takes the place of the removed one
+            const auto last = labels_.size() - 1;
+            rows_.erase(label);
+            if (row != last) {
+                memcpy(data_.data() + row * data_size_, data_.data() + last * data_size_, data_size_);
+                labels_[row] = labels_[last];
+                rows_[labels_[row]] = row;
+            }
+            labels_.pop_back();
+            data_.resize(last * data_size_);
+        }
+
+        size_t size() const {
+            SharedLock lock(lock_);
+            return rows_.size();
+        }
+
+        SpaceInterface<float> *space() const {
+            return space_.get();
+        }
+
+        // `query_data` as returned by `space()->prepare_query`
+        float distance(const void *query_data, labeltype label) const {
+            SharedLock lock(lock_);
+            return fstdist_search_func_(query_data, find(label), dist_func_param_);
+        }
+
+        // Distances to `n` items, under a single lock
+        void distances(const void *query_data, const labeltype *labels, size_t n, float *out) const {
+            SharedLock lock(lock_);
+            for (size_t i = 0; i < n; i++) {
+                out[i] = fstdist_search_func_(query_data, find(labels[i]), dist_func_param_);
+            }
+        }
+
+        void save(const std::string &path) const {
+            SharedLock lock(lock_);
+            std::ofstream output(path, std::ios::binary);
+            const uint64_t data_size = data_size_, nb_items = labels_.size();
+            writeBinaryPOD(output, rerank_store_magic);
+            writeBinaryPOD(output, data_size);
+            writeBinaryPOD(output, nb_items);
+            for (const uint64_t label: labels_) {
+                writeBinaryPOD(output, label);
+            }
+            output.write(getData(), nb_items * data_size_);
+            if (!output)
+                throw std::runtime_error("Couldn't write rerank vectors to " + path);
+        }
+
+        /**
+         * With `use_mmap` the vectors are mapped read-only and paged in by the OS as searches
+         * touch them, so they don't need to fit in memory. Only the labels are read.
+         **/
+        void load(const std::string &path, bool use_mmap) {
+            std::ifstream input(path, std::ios::binary);
+            uint64_t magic = 0, data_size = 0, nb_items = 0;
+            readBinaryPOD(input, magic);
+            readBinaryPOD(input, data_size);
+            readBinaryPOD(input, nb_items);
+            if (!input || magic != rerank_store_magic)
+                throw std::runtime_error("Not a rerank vectors file: " + path);
+            if (data_size != data_size_)
+                throw std::runtime_error("Rerank vectors of " + path + " don't match the rerank precision");
+            std::vector<labeltype> labels(nb_items);
+            for (auto &label: labels) {
+                uint64_t value;
+                readBinaryPOD(input, value);
+                label = value;
+            }
+            const size_t data_offset = (3 + nb_items) * sizeof(uint64_t);
+            const size_t file_size = data_offset + nb_items * data_size_;
+            // Pages mapped past the end of the file would fault when read
+            if (!input.seekg(0, std::ios::end) || (size_t) input.tellg() < file_size)
+                throw std::runtime_error("Truncated rerank vectors file: " + path);
+            input.seekg(data_offset);
+            // Built apart so that a failed load leaves the store as it was
+            FlatHashMap<labeltype, size_t> rows(nb_items);
+            for (size_t row = 0; row < nb_items; row++) {
+                rows[labels[row]] = row;
+            }
+            std::vector<char> data;
+            char *mapped = nullptr;
+            if (use_mmap) {
+                mapped = map(path, file_size);
+            } else {
+                data.resize(nb_items * data_size_);
+                input.read(data.data(), data.size());
+                if (!input)
+                    throw std::runtime_error("Truncated rerank vectors file: " + path);
+            }
+            std::unique_lock<SharedMutex> lock(lock_);
+            unmap(mapped_, mapped_size_);
+            mapped_ = mapped;
+            mapped_data_ = mapped != nullptr ? mapped + data_offset : nullptr;
+            mapped_size_ = mapped != nullptr ? file_size : 0;
+            data_.swap(data);
+            std::swap(rows_, rows);
+            labels_.swap(labels);
+        }
+
+        ~RerankStore() {
+            unmap(mapped_, mapped_size_);
+        }
+
+    private:
+        // Vector of `label`, valid while the lock is held
+        const char *find(labeltype label) const {
+            auto search = rows_.find(label);
+            if (search == rows_.end())
+                throw std::runtime_error("No rerank vector for label " + std::to_string(label));
+            return getData() + search->second * data_size_;
+        }
+
+        const char *getData() const {
+            return mapped_ != nullptr ? mapped_data_ : data_.data();
+        }
+
+        static char *map(const std::string &path, size_t size) {
+#if defined(HNSW_RERANK_MMAP)
+            const int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("Couldn't open " + path);
+            void *ptr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (ptr == MAP_FAILED)
+                throw std::runtime_error("Couldn't map " + path);
+            // Searches touch a few scattered vectors, read ahead would be wasted
+            madvise(ptr, size, MADV_RANDOM);
+            return static_cast<char *>(ptr);
+#else
+            throw std::runtime_error("Mapping rerank vectors is not supported on this platform");
+#endif
+        }
+
+        static void unmap(char *mapped, size_t size) {
+#if defined(HNSW_RERANK_MMAP)
+            if (mapped != nullptr)
+                munmap(mapped, size);
+#endif
+        }
+
+        std::unique_ptr<SpaceInterface<float>> space_;
+        const size_t data_size_;
+        DISTFUNC<float> fstdist_search_func_;
+        void *dist_func_param_;
+        FlatHashMap<labeltype, size_t> rows_;
+        std::vector<labeltype> labels_;
+        std::vector<char> data_;
+        char *mapped_ = nullptr;
+        const char *mapped_data_ = nullptr;
+        size_t mapped_size_ = 0;
+        mutable SharedMutex lock_;
+    };
+}
@@ -0,0 +1,586 @@
+#pragma once
+#include "float4.h"
+#include "hnswlib.h"
+#include "space_ip_train.h"
+
+namespace hnswlib {
+
+    /**
+     * Float4 kernels compare two float4 vectors, decoding nibbles with the per-component range of
+     * the space. Searches fold the float32 query with those ranges once (`prepare_query`):
+     * Euclidean queries become the residuals q - min, a component then being (r - diff * code)^2,
+     * inner product ones the 16 bits weights of `prepare_quantized_query`, summed against the codes.
+     * The `_from` functions sum components [begin, dim), the tails of the SIMD kernels.
+     **/
+    static inline float
+    L2Sqr_float4_from(const uint8_t *pVect1, const uint8_t *pVect2, const TrainParams *params, size_t begin) {
+        float res = 0;
+        for (size_t i = begin; i < params->dim; i++) {
+            const auto t = params->diff[i] * (static_cast<int>(get_nibble(pVect1, i)) - get_nibble(pVect2, i));
+            res += t * t;
+        }
+        return res;
+    }
+
+    static inline float
+    InnerProduct_float4_from(const uint8_t *pVect1, const uint8_t *pVect2, const TrainParams *params, size_t begin) {
+        float res = 0;
+        for (size_t i = begin; i < params->dim; i++) {
+            res += load_float4_component(pVect1, i, params->min, params->diff) *
+                   load_float4_component(pVect2, i, params->min, params->diff);
+        }
+        return res;
+    }
+
+    static inline float
+    L2Sqr_float4_query_from(const float *residuals, const uint8_t *pVect2, const TrainParams *params, size_t begin) {
+        float res = 0;
+        for (size_t i = begin; i < params->dim; i++) {
+            const auto t = residuals[i] - params->diff[i] * get_nibble(pVect2, i);
+            res += t * t;
+        }
+        return res;
+    }
+
+    static inline int32_t
+    InnerProduct_float4_query_from(const int16_t *weights, const uint8_t *pVect2, size_t dim, size_t begin) {
+        int32_t res = 0;
+        for (size_t i = begin; i < dim; i++) {
+            res += weights[i] * get_nibble(pVect2, i);
+        }
+        return res;
+    }
+
+    static float
+    L2Sqr_float4(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        return L2Sqr_float4_from(static_cast<const uint8_t *>(pVect1v), static_cast<const uint8_t *>(pVect2v),
+                                 static_cast<const TrainParams *>(diff_ptr), 0);
+    }
+
+    static float
+    InnerProduct_float4(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        return 1.0f - InnerProduct_float4_from(static_cast<const uint8_t *>(pVect1v), static_cast<const uint8_t *>(pVect2v),
+                                               static_cast<const TrainParams *>(diff_ptr), 0);
+    }
+
+    static float
+    L2Sqr_float4_query(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        return L2Sqr_float4_query_from(static_cast<const float *>(pVect1v), static_cast<const uint8_t *>(pVect2v),
+                                       static_cast<const TrainParams *>(diff_ptr), 0);
+    }
+
+    static float
+    InnerProduct_float4_query(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto header = static_cast<const float *>(pVect1v);
+        const auto res = InnerProduct_float4_query_from(get_quantized_query_weights(pVect1v), static_cast<const uint8_t *>(pVect2v),
+                                                        static_cast<const TrainParams *>(diff_ptr)->dim, 0);
+        return 1.0f - header[0] - header[1] * res;
+    }
+
+#if defined(USE_AVX)
+
+    // 16 components per step, remaining ones computed one by one
+    static float
+    L2SqrSIMD16_float4(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const uint8_t *>(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto params = static_cast<const TrainParams *>(diff_ptr);
+        const auto qty16 = params->dim >> 4 << 4;
+        auto sum = _mm256_set1_ps(0);
+        for (size_t i = 0; i < qty16; i += 16) {
+            const auto codes1 = unpack_float4_sse(pVect1 + i / 2);
+            const auto codes2 = unpack_float4_sse(pVect2 + i / 2);
+            const auto t_lo = load_float4_avx(codes1, params->min + i, params->diff + i) -
+                              load_float4_avx(codes2, params->min + i, params->diff + i);
+            const auto t_hi = load_float4_avx(_mm_srli_si128(codes1, 8), params->min + i + 8, params->diff + i + 8) -
+                              load_float4_avx(_mm_srli_si128(codes2, 8), params->min + i + 8, params->diff + i + 8);
+            sum += t_lo * t_lo + t_hi * t_hi;
+        }
+        float PORTABLE_ALIGN32 TmpRes[8];
+        _mm256_store_ps(TmpRes, sum);
+        float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+        return res + L2Sqr_float4_from(pVect1, pVect2, params, qty16);
+    }
+
+    static float
+    InnerProductSIMD16_float4(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const uint8_t *>(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto params = static_cast<const TrainParams *>(diff_ptr);
+        const auto qty16 = params->dim >> 4 << 4;
+        auto sum = _mm256_set1_ps(0);
+        for (size_t i = 0; i < qty16; i += 16) {
+            const auto codes1 = unpack_float4_sse(pVect1 + i / 2);
+            const auto codes2 = unpack_float4_sse(pVect2 + i / 2);
+            sum += load_float4_avx(codes1, params->min + i, params->diff + i) *
+                   load_float4_avx(codes2, params->min + i, params->diff + i);
+            sum += load_float4_avx(_mm_srli_si128(codes1, 8), params->min + i + 8, params->diff + i + 8) *
+                   load_float4_avx(_mm_srli_si128(codes2, 8), params->min + i + 8, params->diff + i + 8);
+        }
+        float PORTABLE_ALIGN32 TmpRes[8];
+        _mm256_store_ps(TmpRes, sum);
+        float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+        return 1.0f - res - InnerProduct_float4_from(pVect1, pVect2, params, qty16);
+    }
+
+#elif defined(USE_SSE)
+
+    static float
+    L2SqrSIMD16_float4(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const uint8_t *>(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto params = static_cast<const TrainParams *>(diff_ptr);
+        const auto qty16 = params->dim >> 4 << 4;
+        auto sum = _mm_set1_ps(0);
+        for (size_t i = 0; i < qty16; i += 16) {
+            auto codes1 = unpack_float4_sse(pVect1 + i / 2);
+            auto codes2 = unpack_float4_sse(pVect2 + i / 2);
+            for (int part = 0; part < 4; part++) {
+                const auto t = load_float4_sse(codes1, params->min + i + 4 * part, params->diff + i + 4 * part) -
+                               load_float4_sse(codes2, params->min + i + 4 * part, params->diff + i + 4 * part);
+                sum += t * t;
+                codes1 = _mm_srli_si128(codes1, 4);
+                codes2 = _mm_srli_si128(codes2, 4);
+            }
+        }
+        float PORTABLE_ALIGN32 TmpRes[8];
+        _mm_store_ps(TmpRes, sum);
+        float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+        return res + L2Sqr_float4_from(pVect1, pVect2, params, qty16);
+    }
+
+    static float
+    InnerProductSIMD16_float4(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const uint8_t *>(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto params = static_cast<const TrainParams *>(diff_ptr);
+        const auto qty16 = params->dim >> 4 << 4;
+        auto sum = _mm_set1_ps(0);
+        for (size_t i = 0; i < qty16; i += 16) {
+            auto codes1 = unpack_float4_sse(pVect1 + i / 2);
+            auto codes2 = unpack_float4_sse(pVect2 + i / 2);
+            for (int part = 0; part < 4; part++) {
+                sum += load_float4_sse(codes1, params->min + i + 4 * part, params->diff + i + 4 * part) *
+                       load_float4_sse(codes2, params->min + i + 4 * part, params->diff + i + 4 * part);
+                codes1 = _mm_srli_si128(codes1, 4);
+                codes2 = _mm_srli_si128(codes2, 4);
+            }
+        }
+        float PORTABLE_ALIGN32 TmpRes[8];
+        _mm_store_ps(TmpRes, sum);
+        float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+        return 1.0f - res - InnerProduct_float4_from(pVect1, pVect2, params, qty16);
+    }
+
+#endif
+
+#if defined(USE_SSE) || defined(USE_AVX)
+
+    // Folded queries, 16 components per step, remaining ones computed one by one
+    static float
+    L2SqrSIMD16_float4_query(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto residuals = static_cast<const float *>(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto params = static_cast<const TrainParams *>(diff_ptr);
+        const auto qty16 = params->dim >> 4 << 4;
+        auto sum = _mm_set1_ps(0);
+        for (size_t i = 0; i < qty16; i += 16) {
+            auto codes = unpack_float4_sse(pVect2 + i / 2);
+            for (size_t j = i; j < i + 16; j += 4) {
+                const auto t = _mm_loadu_ps(residuals + j) - _mm_loadu_ps(params->diff + j) * _mm_cvtepi32_ps(_mm_cvtepu8_epi32(codes));
+                sum += t * t;
+                codes = _mm_srli_si128(codes, 4);
+            }
+        }
+        float PORTABLE_ALIGN32 TmpRes[8];
+        _mm_store_ps(TmpRes, sum);
+        float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+        return res + L2Sqr_float4_query_from(residuals, pVect2, params, qty16);
+    }
+
+    // `InnerProductSIMD16_quantized_query` over unpacked nibbles
+    static float
+    InnerProductSIMD16_float4_query(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto header = static_cast<const float *>(pVect1v);
+        const auto weights = get_quantized_query_weights(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto qty = static_cast<const TrainParams *>(diff_ptr)->dim;
+        const auto qty16 = qty >> 4 << 4;
+        // A lane grows by at most 4 * 15 * 32767 per step, flushed to floats before overflowing
+        const size_t block = 16384;
+        const auto zero = _mm_setzero_si128();
+        auto sum = _mm_set1_ps(0);
+        for (size_t start = 0; start < qty16; start += block) {
+            const auto end = std::min(start + block, qty16);
+            auto sum_int = _mm_setzero_si128();
+            for (size_t i = start; i < end; i += 16) {
+                const auto codes = unpack_float4_sse(pVect2 + i / 2);
+                const auto w_lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + i));
+                const auto w_hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + i + 8));
+                sum_int = _mm_add_epi32(sum_int, _mm_madd_epi16(_mm_unpacklo_epi8(codes, zero), w_lo));
+                sum_int = _mm_add_epi32(sum_int, _mm_madd_epi16(_mm_unpackhi_epi8(codes, zero), w_hi));
+            }
+            sum += _mm_cvtepi32_ps(sum_int);
+        }
+        float PORTABLE_ALIGN32 TmpRes[8];
+        _mm_store_ps(TmpRes, sum);
+        float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+        return 1.0f - header[0] - header[1] * (res + InnerProduct_float4_query_from(weights, pVect2, qty, qty16));
+    }
+
+#endif
+
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+
+    // The 8 codes in the lowest bytes of `codes`, as floats
+    HNSW_TARGET("avx2,fma")
+    static inline __m256 load_float4_codes_avx2(__m128i codes) {
+        return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(codes));
+    }
+
+    // 16 components per step in two fused multiply-add chains, differences of codes scaled once
+    HNSW_TARGET("avx2,fma")
+    static float
+    L2SqrAVX2_float4(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const uint8_t *>(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto params = static_cast<const TrainParams *>(diff_ptr);
+        const auto qty16 = params->dim >> 4 << 4;
+        auto sum0 = _mm256_setzero_ps();
+        auto sum1 = _mm256_setzero_ps();
+        for (size_t i = 0; i < qty16; i += 16) {
+            const auto codes1 = unpack_float4_sse(pVect1 + i / 2);
+            const auto codes2 = unpack_float4_sse(pVect2 + i / 2);
+            const auto t_lo = _mm256_mul_ps(_mm256_loadu_ps(params->diff + i),
+                                            _mm256_sub_ps(load_float4_codes_avx2(codes1), load_float4_codes_avx2(codes2)));
+            const auto t_hi = _mm256_mul_ps(_mm256_loadu_ps(params->diff + i + 8),
+                                            _mm256_sub_ps(load_float4_codes_avx2(_mm_srli_si128(codes1, 8)),
+                                                          load_float4_codes_avx2(_mm_srli_si128(codes2, 8))));
+            sum0 = _mm256_fmadd_ps(t_lo, t_lo, sum0);
+            sum1 = _mm256_fmadd_ps(t_hi, t_hi, sum1);
+        }
+        return reduce_add_avx(_mm256_add_ps(sum0, sum1)) + L2Sqr_float4_from(pVect1, pVect2, params, qty16);
+    }
+
+    HNSW_TARGET("avx2,fma")
+    static float
+    InnerProductAVX2_float4(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const uint8_t *>(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto params = static_cast<const TrainParams *>(diff_ptr);
+        const auto qty16 = params->dim >> 4 << 4;
+        auto sum0 = _mm256_setzero_ps();
+        auto sum1 = _mm256_setzero_ps();
+        for (size_t i = 0; i < qty16; i += 16) {
+            const auto codes1 = unpack_float4_sse(pVect1 + i / 2);
+            const auto codes2 = unpack_float4_sse(pVect2 + i / 2);
+            const auto diff_lo = _mm256_loadu_ps(params->diff + i);
+            const auto diff_hi = _mm256_loadu_ps(params->diff + i + 8);
+            const auto min_lo = _mm256_loadu_ps(params->min + i);
+            const auto min_hi = _mm256_loadu_ps(params->min + i + 8);
+            sum0 = _mm256_fmadd_ps(_mm256_fmadd_ps(diff_lo, load_float4_codes_avx2(codes1), min_lo),
+                                   _mm256_fmadd_ps(diff_lo, load_float4_codes_avx2(codes2), min_lo), sum0);
+            sum1 = _mm256_fmadd_ps(_mm256_fmadd_ps(diff_hi, load_float4_codes_avx2(_mm_srli_si128(codes1, 8)), min_hi),
+                                   _mm256_fmadd_ps(diff_hi, load_float4_codes_avx2(_mm_srli_si128(codes2, 8)), min_hi), sum1);
+        }
+        return 1.0f - reduce_add_avx(_mm256_add_ps(sum0, sum1)) - InnerProduct_float4_from(pVect1, pVect2, params, qty16);
+    }
+
+    HNSW_TARGET("avx2,fma")
+    static float
+    L2SqrAVX2_float4_query(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto residuals = static_cast<const float *>(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto params = static_cast<const TrainParams *>(diff_ptr);
+        const auto qty16 = params->dim >> 4 << 4;
+        auto sum0 = _mm256_setzero_ps();
+        auto sum1 = _mm256_setzero_ps();
+        for (size_t i = 0; i < qty16; i += 16) {
+            const auto codes = unpack_float4_sse(pVect2 + i / 2);
+            const auto t_lo = _mm256_fnmadd_ps(_mm256_loadu_ps(params->diff + i), load_float4_codes_avx2(codes),
+                                               _mm256_loadu_ps(residuals + i));
+            const auto t_hi = _mm256_fnmadd_ps(_mm256_loadu_ps(params->diff + i + 8), load_float4_codes_avx2(_mm_srli_si128(codes, 8)),
+                                               _mm256_loadu_ps(residuals + i + 8));
+            sum0 = _mm256_fmadd_ps(t_lo, t_lo, sum0);
+            sum1 = _mm256_fmadd_ps(t_hi, t_hi, sum1);
+        }
+        return reduce_add_avx(_mm256_add_ps(sum0, sum1)) + L2Sqr_float4_query_from(residuals, pVect2, params, qty16);
+    }
+
+    // `InnerProductAVX2_quantized_query` over unpacked nibbles
+    HNSW_TARGET("avx2,fma")
+    static float
+    InnerProductAVX2_float4_query(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto header = static_cast<const float *>(pVect1v);
+        const auto weights = get_quantized_query_weights(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto qty = static_cast<const TrainParams *>(diff_ptr)->dim;
+        const auto qty16 = qty >> 4 << 4;
+        // A lane grows by at most 2 * 15 * 32767 per step, flushed to floats before overflowing
+        const size_t block = 32768;
+        auto sum = _mm256_setzero_ps();
+        for (size_t start = 0; start < qty16; start += block) {
+            const auto end = std::min(start + block, qty16);
+            auto sum_int = _mm256_setzero_si256();
+            for (size_t i = start; i < end; i += 16) {
+                const auto codes = _mm256_cvtepu8_epi16(unpack_float4_sse(pVect2 + i / 2));
+                const auto w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i));
+                sum_int = _mm256_add_epi32(sum_int, _mm256_madd_epi16(codes, w));
+            }
+            sum = _mm256_add_ps(sum, _mm256_cvtepi32_ps(sum_int));
+        }
+        const auto res = reduce_add_avx(sum) + InnerProduct_float4_query_from(weights, pVect2, qty, qty16);
+        return 1.0f - header[0] - header[1] * res;
+    }
+
+    HNSW_AVX512_BEGIN
+    // Spreads 32 components (16 bytes) to one byte each, in component order
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static inline __m256i unpack_float4_avx512(const uint8_t *src) {
+        const auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+        const auto mask = _mm_set1_epi8(0x0F);
+        const auto low = _mm_and_si128(packed, mask);
+        const auto high = _mm_and_si128(_mm_srli_epi16(packed, 4), mask);
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi8(low, high)), _mm_unpackhi_epi8(low, high), 1);
+    }
+
+    // The 16 codes of `codes`, as floats
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static inline __m512 load_float4_codes_avx512(__m128i codes) {
+        return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(codes));
+    }
+
+    // 32 components per step in two 512 bits chains, then 16 and one by one, differences of codes scaled once
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static float
+    L2SqrAVX512_float4(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const uint8_t *>(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto params = static_cast<const TrainParams *>(diff_ptr);
+        const auto qty = params->dim;
+        const auto qty32 = qty >> 5 << 5;
+        auto sum0 = _mm512_setzero_ps();
+        auto sum1 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i < qty32; i += 32) {
+            const auto codes1 = unpack_float4_avx512(pVect1 + i / 2);
+            const auto codes2 = unpack_float4_avx512(pVect2 + i / 2);
+            const auto t_lo = _mm512_mul_ps(_mm512_loadu_ps(params->diff + i),
+                                            _mm512_sub_ps(load_float4_codes_avx512(_mm256_castsi256_si128(codes1)),
+                                                          load_float4_codes_avx512(_mm256_castsi256_si128(codes2))));
+            const auto t_hi = _mm512_mul_ps(_mm512_loadu_ps(params->diff + i + 16),
+                                            _mm512_sub_ps(load_float4_codes_avx512(_mm256_extracti128_si256(codes1, 1)),
+                                                          load_float4_codes_avx512(_mm256_extracti128_si256(codes2, 1))));
+            sum0 = _mm512_fmadd_ps(t_lo, t_lo, sum0);
+            sum1 = _mm512_fmadd_ps(t_hi, t_hi, sum1);
+        }
+        if (qty - i >= 16) {
+            const auto t = _mm512_mul_ps(_mm512_loadu_ps(params->diff + i),
+                                         _mm512_sub_ps(load_float4_codes_avx512(unpack_float4_sse(pVect1 + i / 2)),
+                                                       load_float4_codes_avx512(unpack_float4_sse(pVect2 + i / 2))));
+            sum0 = _mm512_fmadd_ps(t, t, sum0);
+            i += 16;
+        }
+        return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1)) + L2Sqr_float4_from(pVect1, pVect2, params, i);
+    }
+
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static float
+    InnerProductAVX512_float4(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const uint8_t *>(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto params = static_cast<const TrainParams *>(diff_ptr);
+        const auto qty = params->dim;
+        const auto qty32 = qty >> 5 << 5;
+        auto sum0 = _mm512_setzero_ps();
+        auto sum1 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i < qty32; i += 32) {
+            const auto codes1 = unpack_float4_avx512(pVect1 + i / 2);
+            const auto codes2 = unpack_float4_avx512(pVect2 + i / 2);
+            const auto diff_lo = _mm512_loadu_ps(params->diff + i);
+            const auto diff_hi = _mm512_loadu_ps(params->diff + i + 16);
+            const auto min_lo = _mm512_loadu_ps(params->min + i);
+            const auto min_hi = _mm512_loadu_ps(params->min + i + 16);
+            sum0 = _mm512_fmadd_ps(_mm512_fmadd_ps(diff_lo, load_float4_codes_avx512(_mm256_castsi256_si128(codes1)), min_lo),
+                                   _mm512_fmadd_ps(diff_lo, load_float4_codes_avx512(_mm256_castsi256_si128(codes2)), min_lo), sum0);
+            sum1 = _mm512_fmadd_ps(_mm512_fmadd_ps(diff_hi, load_float4_codes_avx512(_mm256_extracti128_si256(codes1, 1)), min_hi),
+                                   _mm512_fmadd_ps(diff_hi, load_float4_codes_avx512(_mm256_extracti128_si256(codes2, 1)), min_hi), sum1);
+        }
+        if (qty - i >= 16) {
+            const auto diff = _mm512_loadu_ps(params->diff + i);
+            const auto min = _mm512_loadu_ps(params->min + i);
+            sum0 = _mm512_fmadd_ps(_mm512_fmadd_ps(diff, load_float4_codes_avx512(unpack_float4_sse(pVect1 + i / 2)), min),
+                                   _mm512_fmadd_ps(diff, load_float4_codes_avx512(unpack_float4_sse(pVect2 + i / 2)), min), sum0);
+            i += 16;
+        }
+        return 1.0f - _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1)) - InnerProduct_float4_from(pVect1, pVect2, params, i);
+    }
+
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static float
+    L2SqrAVX512_float4_query(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto residuals = static_cast<const float *>(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto params = static_cast<const TrainParams *>(diff_ptr);
+        const auto qty = params->dim;
+        const auto qty32 = qty >> 5 << 5;
+        auto sum0 = _mm512_setzero_ps();
+        auto sum1 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i < qty32; i += 32) {
+            const auto codes = unpack_float4_avx512(pVect2 + i / 2);
+            const auto t_lo = _mm512_fnmadd_ps(_mm512_loadu_ps(params->diff + i), load_float4_codes_avx512(_mm256_castsi256_si128(codes)),
+                                               _mm512_loadu_ps(residuals + i));
+            const auto t_hi = _mm512_fnmadd_ps(_mm512_loadu_ps(params->diff + i + 16), load_float4_codes_avx512(_mm256_extracti128_si256(codes, 1)),
+                                               _mm512_loadu_ps(residuals + i + 16));
+            sum0 = _mm512_fmadd_ps(t_lo, t_lo, sum0);
+            sum1 = _mm512_fmadd_ps(t_hi, t_hi, sum1);
+        }
+        if (qty - i >= 16) {
+            const auto t = _mm512_fnmadd_ps(_mm512_loadu_ps(params->diff + i), load_float4_codes_avx512(unpack_float4_sse(pVect2 + i / 2)),
+                                            _mm512_loadu_ps(residuals + i));
+            sum0 = _mm512_fmadd_ps(t, t, sum0);
+            i += 16;
+        }
+        return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1)) + L2Sqr_float4_query_from(residuals, pVect2, params, i);
+    }
+
+    // Codes widened to 16 bits, 32 per step
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static float
+    InnerProductAVX512_float4_query(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto header = static_cast<const float *>(pVect1v);
+        const auto weights = get_quantized_query_weights(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto qty = static_cast<const TrainParams *>(diff_ptr)->dim;
+        const auto qty32 = qty >> 5 << 5;
+        // A lane grows by at most 2 * 15 * 32767 per step, flushed to floats before overflowing
+        const size_t block = 65536;
+        auto sum = _mm512_setzero_ps();
+        size_t i = 0;
+        while (i < qty32) {
+            const auto end = std::min(i + block, qty32);
+            auto sum_int = _mm512_setzero_si512();
+            for (; i < end; i += 32) {
+                const auto codes = _mm512_cvtepu8_epi16(unpack_float4_avx512(pVect2 + i / 2));
+                const auto w = _mm512_loadu_si512(weights + i);
+                sum_int = _mm512_add_epi32(sum_int, _mm512_madd_epi16(codes, w));
+            }
+            sum = _mm512_add_ps(sum, _mm512_cvtepi32_ps(sum_int));
+        }
+        auto res = _mm512_reduce_add_ps(sum);
+        if (qty - i >= 16) {
+            const auto codes = _mm256_cvtepu8_epi16(unpack_float4_sse(pVect2 + i / 2));
+            const auto w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i));
+            res += reduce_add_avx(_mm256_cvtepi32_ps(_mm256_madd_epi16(codes, w)));
+            i += 16;
+        }
+        return 1.0f - header[0] - header[1] * (res + InnerProduct_float4_query_from(weights, pVect2, qty, i));
+    }
+    HNSW_AVX512_END
+#endif
+
+    /**
+     * 4-bit scalar quantization: each component is stored on 16 levels of the range seen while
+     * training, two components per byte. Half the size of Float8 at a coarser resolution.
+     **/
+    class Float4TrainedSpace : public SpaceInterface<float> {
+
+        DISTFUNC<float> fstdistfunc_;
+        DISTFUNC<float> fstdist_search_func_;
+        size_t dim_;
+        bool inner_product_;
+        MinMaxRange range_per_component;
+        TrainParams params = TrainParams(dim_);
+
+    public:
+        Float4TrainedSpace(size_t dim, bool inner_product)
+        : dim_(dim), inner_product_(inner_product), range_per_component(dim) {
+            fstdistfunc_ = inner_product ? InnerProduct_float4 : L2Sqr_float4;
+            fstdist_search_func_ = inner_product ? InnerProduct_float4_query : L2Sqr_float4_query;
+        #if defined(USE_SSE) || defined(USE_AVX)
+            if (dim >= 16) {
+                fstdistfunc_ = inner_product ? InnerProductSIMD16_float4 : L2SqrSIMD16_float4;
+                fstdist_search_func_ = inner_product ? InnerProductSIMD16_float4_query : L2SqrSIMD16_float4_query;
+            }
+        #endif
+        #if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+            if (dim >= 16 && cpu_supports_avx2_fma()) {
+                fstdistfunc_ = inner_product ? InnerProductAVX2_float4 : L2SqrAVX2_float4;
+                fstdist_search_func_ = inner_product ? InnerProductAVX2_float4_query : L2SqrAVX2_float4_query;
+            }
+            if (dim >= 16 && cpu_supports_avx512()) {
+                fstdistfunc_ = inner_product ? InnerProductAVX512_float4 : L2SqrAVX512_float4;
+                fstdist_search_func_ = inner_product ? InnerProductAVX512_float4_query : L2SqrAVX512_float4_query;
+            }
+        #endif
+        }
+
+        size_t get_data_size() override {
+            return get_float4_data_size(dim_);
+        }
+
+        DISTFUNC<float> get_dist_func() override {
+            return fstdistfunc_;
+        }
+
+        DISTFUNC<float> get_search_dist_func() const override {
+            return fstdist_search_func_;
+        }
+
+        bool needs_initialization() const override {
+            return range_per_component.nb_examples == 0;
+        }
+
+        void train(const float* vectors) override {
+            range_per_component.add(vectors);
+            range_per_component.update_trained_params(params, float4_max_value);
+        }
+
+        void *get_dist_func_param() override {
+            return &params;
+        }
+
+        const void *prepare_query(const float *query, std::vector<char> &buffer) const override {
+            if (inner_product_)
+                return prepare_quantized_query(query, params, buffer);
+            buffer.resize(dim_ * sizeof(float));
+            const auto residuals = reinterpret_cast<float *>(buffer.data());
+            for (size_t i = 0; i < dim_; i++) {
+                residuals[i] = query[i] - params.min[i];
+            }
+            return residuals;
+        }
+
+        bool has_persistent_params() const override {
+            return true;
+        }
+
+        void save_params(std::ostream &output) const override {
+            writeBinaryPOD(output, dim_);
+            writeBinaryPOD(output, range_per_component.nb_examples);
+            output.write((const char *) range_per_component.min_.data(), dim_ * sizeof(float));
+            output.write((const char *) range_per_component.max_.data(), dim_ * sizeof(float));
+        }
+
+        void load_params(std::istream &input) override {
+            size_t dim, nb_examples;
+            readBinaryPOD(input, dim);
+            readBinaryPOD(input, nb_examples);
+            if (dim != dim_)
+                throw std::runtime_error("Float4 ranges don't match the space of the index");
+            std::vector<float> min(dim), max(dim);
+            input.read((char *) min.data(), dim * sizeof(float));
+            input.read((char *) max.data(), dim * sizeof(float));
+            if (!input)
+                throw std::runtime_error("Truncated float4 ranges");
+            range_per_component.min_ = min;
+            range_per_component.max_ = max;
+            range_per_component.nb_examples = nb_examples;
+            range_per_component.update_trained_params(params, float4_max_value);
+        }
+
+        ~Float4TrainedSpace() override = default;
+    };
+}
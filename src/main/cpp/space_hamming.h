@@ -0,0 +1,179 @@
+#pragma once
+#include "cpu_features.h"
+#include "hnswlib.h"
+#include <vector>
+
+namespace hnswlib {
+
+    /**
+     * Binary codes: bit i is set when component i is above its threshold, 0 (the sign) until
+     * trained, then the mean of the training vectors. Codes are padded to 64 bits words.
+     **/
+    struct HammingParams {
+        size_t dim;
+        size_t words;
+        std::vector<float> thresholds;
+
+        explicit HammingParams(size_t dim): dim(dim), words((dim + 63) / 64), thresholds(dim, 0.f) {}
+    };
+
+    static inline size_t get_binary_data_size(size_t dim) {
+        return (dim + 63) / 64 * sizeof(uint64_t);
+    }
+
+    static inline void encode_binary_vector(const float *src, uint8_t *dst, const HammingParams *param_ptr) {
+        memset(dst, 0, param_ptr->words * sizeof(uint64_t));
+        for (size_t i = 0; i < param_ptr->dim; i++) {
+            if (src[i] > param_ptr->thresholds[i])
+                dst[i >> 3] |= 1 << (i & 7);
+        }
+    }
+
+    // Only the side of the threshold is kept, decoded as -1 or 1
+    static inline void decode_binary_vector(const uint8_t *src, float *dst, const HammingParams *param_ptr) {
+        for (size_t i = 0; i < param_ptr->dim; i++) {
+            dst[i] = (src[i >> 3] >> (i & 7)) & 1 ? 1.f : -1.f;
+        }
+    }
+
+    static inline size_t popcount_xor(const uint8_t *pVect1, const uint8_t *pVect2, size_t words) {
+        size_t res = 0;
+        for (size_t i = 0; i < words; i++) {
+            uint64_t w1, w2;
+            memcpy(&w1, pVect1 + i * sizeof(uint64_t), sizeof(uint64_t));
+            memcpy(&w2, pVect2 + i * sizeof(uint64_t), sizeof(uint64_t));
+            res += __builtin_popcountll(w1 ^ w2);
+        }
+        return res;
+    }
+
+    // Number of differing bits
+    static float
+    Hamming(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+        const auto words = static_cast<const HammingParams *>(param_ptr)->words;
+        return popcount_xor(static_cast<const uint8_t *>(pVect1v), static_cast<const uint8_t *>(pVect2v), words);
+    }
+
+#if defined(HNSW_RUNTIME_DISPATCH)
+
+    // Same loop with `__builtin_popcountll` as a single 64 bits `popcnt`
+    HNSW_TARGET("popcnt")
+    static float
+    HammingPopcnt(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+        const auto words = static_cast<const HammingParams *>(param_ptr)->words;
+        return popcount_xor(static_cast<const uint8_t *>(pVect1v), static_cast<const uint8_t *>(pVect2v), words);
+    }
+
+    // 32 bytes per step, bits of each nibble counted with a `pshufb` lookup and summed with `psadbw`
+    HNSW_TARGET("avx2,popcnt")
+    static float
+    HammingAVX2(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+        const auto pVect1 = static_cast<const uint8_t *>(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto words = static_cast<const HammingParams *>(param_ptr)->words;
+        const auto words4 = words >> 2 << 2;
+        const auto lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                             0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const auto low_mask = _mm256_set1_epi8(0x0F);
+        auto sum = _mm256_setzero_si256();
+        for (size_t i = 0; i < words4; i += 4) {
+            const auto offset = i * sizeof(uint64_t);
+            const auto v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(pVect1 + offset)),
+                                            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pVect2 + offset)));
+            const auto low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_mask));
+            const auto high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask));
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256()));
+        }
+        uint64_t PORTABLE_ALIGN32 TmpRes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(TmpRes), sum);
+        const auto offset = words4 * sizeof(uint64_t);
+        return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] +
+               popcount_xor(pVect1 + offset, pVect2 + offset, words - words4);
+    }
+
+#endif
+
+    /**
+     * 1 bit per component compared with the Hamming distance, 32x smaller than float32. Meant
+     * for a coarse first pass whose candidates are reranked on full precision vectors (see
+     * `Index::enableRerank`).
+     **/
+    class HammingSpace : public SpaceInterface<float> {
+
+        DISTFUNC<float> fstdistfunc_;
+        HammingParams params_;
+        size_t nb_examples_ = 0;
+        bool mean_thresholds_;
+
+    public:
+        // With `mean_thresholds` the space needs training before items are encoded
+        explicit HammingSpace(size_t dim, bool mean_thresholds = false) : params_(dim), mean_thresholds_(mean_thresholds) {
+            fstdistfunc_ = Hamming;
+        #if defined(HNSW_RUNTIME_DISPATCH)
+            // The lookup only pays off over a few words
+            if (params_.words >= 8 && cpu_supports_avx2()) {
+                fstdistfunc_ = HammingAVX2;
+            } else if (cpu_supports_popcnt()) {
+                fstdistfunc_ = HammingPopcnt;
+            }
+        #endif
+        }
+
+        size_t get_data_size() override {
+            return get_binary_data_size(params_.dim);
+        }
+
+        DISTFUNC<float> get_dist_func() override {
+            return fstdistfunc_;
+        }
+
+        DISTFUNC<float> get_search_dist_func() const override {
+            return fstdistfunc_;
+        }
+
+        bool needs_initialization() const override {
+            return mean_thresholds_ && nb_examples_ == 0;
+        }
+
+        // Thresholds become the running mean of the training vectors
+        void train(const float *vector) override {
+            nb_examples_++;
+            for (size_t i = 0; i < params_.dim; i++) {
+                params_.thresholds[i] += (vector[i] - params_.thresholds[i]) / nb_examples_;
+            }
+        }
+
+        void *get_dist_func_param() override {
+            return &params_;
+        }
+
+        const void *prepare_query(const float *query, std::vector<char> &buffer) const override {
+            buffer.resize(get_binary_data_size(params_.dim));
+            encode_binary_vector(query, reinterpret_cast<uint8_t *>(buffer.data()), &params_);
+            return buffer.data();
+        }
+
+        bool has_persistent_params() const override {
+            return true;
+        }
+
+        void save_params(std::ostream &output) const override {
+            writeBinaryPOD(output, params_.dim);
+            writeBinaryPOD(output, nb_examples_);
+            output.write((const char *) params_.thresholds.data(), params_.dim * sizeof(float));
+        }
+
+        void load_params(std::istream &input) override {
+            size_t dim;
+            readBinaryPOD(input, dim);
+            if (dim != params_.dim)
+                throw std::runtime_error("Binary thresholds don't match the space of the index");
+            readBinaryPOD(input, nb_examples_);
+            input.read((char *) params_.thresholds.data(), dim * sizeof(float));
+            if (!input)
+                throw std::runtime_error("Truncated binary thresholds");
+        }
+
+        ~HammingSpace() override = default;
+    };
+}
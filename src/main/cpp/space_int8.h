@@ -0,0 +1,257 @@
+#pragma once
+#include "cpu_features.h"
+#include "hnswlib.h"
+#include "int8.h"
+
+namespace hnswlib {
+
+    // Integer sums of a.b, and of a.a and b.b when NORMS is set
+    struct Int8Sums {
+        int32_t ab;
+        int32_t aa;
+        int32_t bb;
+    };
+
+    typedef void (*INT8SUMSFUNC)(const int8_t *, const int8_t *, size_t, Int8Sums &);
+
+    template<bool NORMS>
+    static void int8_sums(const int8_t *a, const int8_t *b, size_t qty, Int8Sums &sums) {
+        for (size_t i = 0; i < qty; i++) {
+            sums.ab += a[i] * b[i];
+            if (NORMS) {
+                sums.aa += a[i] * a[i];
+                sums.bb += b[i] * b[i];
+            }
+        }
+    }
+
+    /**
+     * SIMD kernels multiply |a| (unsigned) by b with the sign of a (signed), the operand types of
+     * `pmaddubsw` and `vpdpbusd`. Codes never reach -128, so both fit and pairs of products can't
+     * saturate 16 bits.
+     **/
+#if defined(USE_SSE) || defined(USE_AVX)
+
+    template<bool NORMS>
+    static void int8_sums_sse(const int8_t *a, const int8_t *b, size_t qty, Int8Sums &sums) {
+        const auto qty16 = qty >> 4 << 4;
+        const auto ones = _mm_set1_epi16(1);
+        auto ab = _mm_setzero_si128(), aa = _mm_setzero_si128(), bb = _mm_setzero_si128();
+        for (size_t i = 0; i < qty16; i += 16) {
+            const auto va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+            const auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+            const auto abs_a = _mm_sign_epi8(va, va);
+            ab = _mm_add_epi32(ab, _mm_madd_epi16(_mm_maddubs_epi16(abs_a, _mm_sign_epi8(vb, va)), ones));
+            if (NORMS) {
+                const auto abs_b = _mm_sign_epi8(vb, vb);
+                aa = _mm_add_epi32(aa, _mm_madd_epi16(_mm_maddubs_epi16(abs_a, abs_a), ones));
+                bb = _mm_add_epi32(bb, _mm_madd_epi16(_mm_maddubs_epi16(abs_b, abs_b), ones));
+            }
+        }
+        int32_t PORTABLE_ALIGN32 TmpRes[3][4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(TmpRes[0]), ab);
+        _mm_store_si128(reinterpret_cast<__m128i *>(TmpRes[1]), aa);
+        _mm_store_si128(reinterpret_cast<__m128i *>(TmpRes[2]), bb);
+        sums.ab += TmpRes[0][0] + TmpRes[0][1] + TmpRes[0][2] + TmpRes[0][3];
+        sums.aa += TmpRes[1][0] + TmpRes[1][1] + TmpRes[1][2] + TmpRes[1][3];
+        sums.bb += TmpRes[2][0] + TmpRes[2][1] + TmpRes[2][2] + TmpRes[2][3];
+        int8_sums<NORMS>(a + qty16, b + qty16, qty - qty16, sums);
+    }
+
+#endif
+
+#if defined(HNSW_RUNTIME_DISPATCH)
+
+    HNSW_TARGET("avx2")
+    static inline void int8_store_sums_avx2(__m256i ab, __m256i aa, __m256i bb, Int8Sums &sums) {
+        int32_t PORTABLE_ALIGN32 TmpRes[3][8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(TmpRes[0]), ab);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(TmpRes[1]), aa);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(TmpRes[2]), bb);
+        for (size_t i = 0; i < 8; i++) {
+            sums.ab += TmpRes[0][i];
+            sums.aa += TmpRes[1][i];
+            sums.bb += TmpRes[2][i];
+        }
+    }
+
+    template<bool NORMS>
+    HNSW_TARGET("avx2")
+    static void int8_sums_avx2(const int8_t *a, const int8_t *b, size_t qty, Int8Sums &sums) {
+        const auto qty32 = qty >> 5 << 5;
+        const auto ones = _mm256_set1_epi16(1);
+        auto ab = _mm256_setzero_si256(), aa = _mm256_setzero_si256(), bb = _mm256_setzero_si256();
+        for (size_t i = 0; i < qty32; i += 32) {
+            const auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+            const auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+            const auto abs_a = _mm256_sign_epi8(va, va);
+            ab = _mm256_add_epi32(ab, _mm256_madd_epi16(_mm256_maddubs_epi16(abs_a, _mm256_sign_epi8(vb, va)), ones));
+            if (NORMS) {
+                const auto abs_b = _mm256_sign_epi8(vb, vb);
+                aa = _mm256_add_epi32(aa, _mm256_madd_epi16(_mm256_maddubs_epi16(abs_a, abs_a), ones));
+                bb = _mm256_add_epi32(bb, _mm256_madd_epi16(_mm256_maddubs_epi16(abs_b, abs_b), ones));
+            }
+        }
+        int8_store_sums_avx2(ab, aa, bb, sums);
+        int8_sums<NORMS>(a + qty32, b + qty32, qty - qty32, sums);
+    }
+
+    // `vpdpbusd` fuses the multiply, the pairwise sums and the accumulation
+    template<bool NORMS>
+    HNSW_TARGET("avx2,avx512vl,avx512vnni")
+    static void int8_sums_vnni(const int8_t *a, const int8_t *b, size_t qty, Int8Sums &sums) {
+        const auto qty32 = qty >> 5 << 5;
+        auto ab = _mm256_setzero_si256(), aa = _mm256_setzero_si256(), bb = _mm256_setzero_si256();
+        for (size_t i = 0; i < qty32; i += 32) {
+            const auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+            const auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+            const auto abs_a = _mm256_sign_epi8(va, va);
+            ab = _mm256_dpbusd_epi32(ab, abs_a, _mm256_sign_epi8(vb, va));
+            if (NORMS) {
+                const auto abs_b = _mm256_sign_epi8(vb, vb);
+                aa = _mm256_dpbusd_epi32(aa, abs_a, abs_a);
+                bb = _mm256_dpbusd_epi32(bb, abs_b, abs_b);
+            }
+        }
+        int8_store_sums_avx2(ab, aa, bb, sums);
+        int8_sums<NORMS>(a + qty32, b + qty32, qty - qty32, sums);
+    }
+
+#endif
+
+    // Prepared queries are their own scale followed by their codes
+    template<bool QUERY_PREPARED>
+    static inline const int8_t *get_int8_codes(const void *pVect1v, const Int8Params *params, float &scale) {
+        if (QUERY_PREPARED) {
+            scale = *static_cast<const float *>(pVect1v);
+            return reinterpret_cast<const int8_t *>(static_cast<const float *>(pVect1v) + 1);
+        }
+        scale = params->scale;
+        return static_cast<const int8_t *>(pVect1v);
+    }
+
+    template<bool QUERY_PREPARED, INT8SUMSFUNC sums_func>
+    static float
+    InnerProduct_int8(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+        const auto params = static_cast<const Int8Params *>(param_ptr);
+        float scale1;
+        const auto pVect1 = get_int8_codes<QUERY_PREPARED>(pVect1v, params, scale1);
+        Int8Sums sums = {0, 0, 0};
+        sums_func(pVect1, static_cast<const int8_t *>(pVect2v), params->dim, sums);
+        return 1.0f - scale1 * params->scale * sums.ab;
+    }
+
+    // |s1 a - s2 b|^2 = s1^2 a.a + s2^2 b.b - 2 s1 s2 a.b, in double as the terms nearly cancel out
+    template<bool QUERY_PREPARED, INT8SUMSFUNC sums_func>
+    static float
+    L2Sqr_int8(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+        const auto params = static_cast<const Int8Params *>(param_ptr);
+        float scale1;
+        const auto pVect1 = get_int8_codes<QUERY_PREPARED>(pVect1v, params, scale1);
+        Int8Sums sums = {0, 0, 0};
+        sums_func(pVect1, static_cast<const int8_t *>(pVect2v), params->dim, sums);
+        const double s1 = scale1, s2 = params->scale;
+        const auto res = s1 * s1 * sums.aa + s2 * s2 * sums.bb - 2 * s1 * s2 * sums.ab;
+        return static_cast<float>(std::max(res, 0.));
+    }
+
+    /**
+     * Symmetric int8 quantization with a single scale, for zero-centered data: one byte per
+     * component and integer dot products. Training records the largest absolute component.
+     * Queries are quantized with their own scale, so they don't need to fit the trained range.
+     **/
+    class Int8SymmetricSpace : public SpaceInterface<float> {
+
+        DISTFUNC<float> fstdistfunc_;
+        DISTFUNC<float> fstdist_search_func_;
+        Int8Params params_;
+        float max_abs_ = 0;
+        bool trained_ = false;
+
+        template<INT8SUMSFUNC ip_sums, INT8SUMSFUNC l2_sums>
+        void set_dist_funcs(bool inner_product) {
+            fstdistfunc_ = inner_product ? InnerProduct_int8<false, ip_sums> : L2Sqr_int8<false, l2_sums>;
+            fstdist_search_func_ = inner_product ? InnerProduct_int8<true, ip_sums> : L2Sqr_int8<true, l2_sums>;
+        }
+
+    public:
+        Int8SymmetricSpace(size_t dim, bool inner_product) : params_(dim) {
+            set_dist_funcs<int8_sums<false>, int8_sums<true>>(inner_product);
+        #if defined(USE_SSE) || defined(USE_AVX)
+            set_dist_funcs<int8_sums_sse<false>, int8_sums_sse<true>>(inner_product);
+        #endif
+        #if defined(HNSW_RUNTIME_DISPATCH)
+            if (cpu_supports_avx512_vnni()) {
+                set_dist_funcs<int8_sums_vnni<false>, int8_sums_vnni<true>>(inner_product);
+            } else if (cpu_supports_avx2()) {
+                set_dist_funcs<int8_sums_avx2<false>, int8_sums_avx2<true>>(inner_product);
+            }
+        #endif
+        }
+
+        size_t get_data_size() override {
+            return params_.dim;
+        }
+
+        DISTFUNC<float> get_dist_func() override {
+            return fstdistfunc_;
+        }
+
+        DISTFUNC<float> get_search_dist_func() const override {
+            return fstdist_search_func_;
+        }
+
+        bool needs_initialization() const override {
+            return !trained_;
+        }
+
+        void train(const float *vector) override {
+            for (size_t i = 0; i < params_.dim; i++) {
+                max_abs_ = std::max(max_abs_, std::abs(vector[i]));
+            }
+            params_.scale = max_abs_ > 0 ? max_abs_ / int8_max_value : 1.f;
+            trained_ = true;
+        }
+
+        void *get_dist_func_param() override {
+            return &params_;
+        }
+
+        const void *prepare_query(const float *query, std::vector<char> &buffer) const override {
+            buffer.resize(sizeof(float) + params_.dim);
+            float max_abs = 0;
+            for (size_t i = 0; i < params_.dim; i++) {
+                max_abs = std::max(max_abs, std::abs(query[i]));
+            }
+            const auto scale = max_abs > 0 ? max_abs / int8_max_value : 1.f;
+            const auto header = reinterpret_cast<float *>(buffer.data());
+            const auto codes = reinterpret_cast<int8_t *>(header + 1);
+            for (size_t i = 0; i < params_.dim; i++) {
+                codes[i] = encode_int8_component(query[i], scale);
+            }
+            *header = scale;
+            return header;
+        }
+
+        bool has_persistent_params() const override {
+            return true;
+        }
+
+        void save_params(std::ostream &output) const override {
+            writeBinaryPOD(output, params_.dim);
+            writeBinaryPOD(output, params_.scale);
+        }
+
+        void load_params(std::istream &input) override {
+            size_t dim;
+            readBinaryPOD(input, dim);
+            if (dim != params_.dim)
+                throw std::runtime_error("Int8 scale doesn't match the space of the index");
+            readBinaryPOD(input, params_.scale);
+            max_abs_ = params_.scale * int8_max_value;
+            trained_ = true;
+        }
+
+        ~Int8SymmetricSpace() override = default;
+    };
+}
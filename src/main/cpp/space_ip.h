@@ -120,6 +120,31 @@ namespace hnswlib {
         return 1.0f - sum;
     }
 
+    // 8 components or more: the last partial step is loaded with zeros past the end, within the same call
+    template<typename TARG1, typename TARG2>
+    static float
+    InnerProductSIMD8ExtMasked(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+        const auto qty = *static_cast<const size_t*>(qty_ptr);
+        const auto qty8 = qty >> 3 << 3;
+        __m256 sum256 = _mm256_set1_ps(0);
+
+        for (size_t i = 0; i < qty8; i += 8) {
+            sum256 += load_component_avx(pVect1 + i) * load_component_avx(pVect2 + i);
+        }
+
+        float PORTABLE_ALIGN32 TmpRes[8];
+        _mm256_store_ps(TmpRes, sum256);
+        float sum = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+        // Summed apart so that a single leftover component adds exactly as a scalar tail would
+        if (qty8 < qty) {
+            sum += reduce_add_avx(load_component_avx(pVect1 + qty8, qty - qty8) * load_component_avx(pVect2 + qty8, qty - qty8));
+        }
+
+        return 1.0f - sum;
+    }
+
 #elif defined(USE_SSE)
 
 
@@ -158,20 +183,6 @@ namespace hnswlib {
 
 #if defined(USE_SSE) || defined(USE_AVX)
 
-    template<typename TARG1, typename TARG2>
-    static float
-    InnerProductSIMD8ExtResiduals(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
-        const auto qty = *static_cast<const size_t*>(qty_ptr);
-        const auto qty8 = qty >> 3 << 3;
-        const auto res = InnerProductSIMD8Ext<TARG1, TARG2>(pVect1v, pVect2v, &qty8);
-        const auto pVect1 = static_cast<const TARG1*>(pVect1v) + qty8;
-        const auto pVect2 = static_cast<const TARG2*>(pVect2v) + qty8;
-
-        const auto qty_left = qty - qty8;
-        const auto res_tail = InnerProduct<TARG1, TARG2>(pVect1, pVect2, &qty_left);
-        return res + res_tail - 1.0f;
-    }
-
     template<typename TARG1, typename TARG2>
     static float
     InnerProductSIMD4ExtResiduals(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
@@ -187,11 +198,300 @@ namespace hnswlib {
     }
 #endif
 
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+
+    // Two fused multiply-add chains over 16 components per step, the tail loaded under a mask, 8 components or more
+    template<typename TARG1, typename TARG2>
+    HNSW_TARGET("avx2,fma")
+    static float
+    InnerProductAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+        const auto qty = *static_cast<const size_t*>(qty_ptr);
+        const auto qty16 = qty >> 4 << 4;
+        auto sum0 = _mm256_setzero_ps();
+        auto sum1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i < qty16; i += 16) {
+            sum0 = _mm256_fmadd_ps(load_component_avx2(pVect1 + i), load_component_avx2(pVect2 + i), sum0);
+            sum1 = _mm256_fmadd_ps(load_component_avx2(pVect1 + i + 8), load_component_avx2(pVect2 + i + 8), sum1);
+        }
+        if (qty - i >= 8) {
+            sum0 = _mm256_fmadd_ps(load_component_avx2(pVect1 + i), load_component_avx2(pVect2 + i), sum0);
+            i += 8;
+        }
+        auto res = reduce_add_avx(_mm256_add_ps(sum0, sum1));
+        if (i < qty) {
+            res += reduce_add_avx(_mm256_mul_ps(load_component_avx(pVect1 + i, qty - i), load_component_avx(pVect2 + i, qty - i)));
+        }
+        return 1.0f - res;
+    }
+
+    // Four vectors per pass against the query loaded once, each summed in the order of InnerProductAVX2
+    template<typename TARG1, typename TARG2>
+    HNSW_TARGET("avx2,fma")
+    static void
+    InnerProductBatchAVX2(const void *pVect1v, const void *const *data, size_t n, const void *qty_ptr, float *out) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto qty = *static_cast<const size_t*>(qty_ptr);
+        const auto qty16 = qty >> 4 << 4;
+        size_t b = 0;
+        for (; b + 4 <= n; b += 4) {
+            const TARG2 *pVect2[4];
+            __m256 sum0[4], sum1[4];
+            HNSW_UNROLL
+            for (size_t k = 0; k < 4; k++) {
+                pVect2[k] = static_cast<const TARG2*>(data[b + k]);
+                sum0[k] = _mm256_setzero_ps();
+                sum1[k] = _mm256_setzero_ps();
+            }
+            size_t i = 0;
+            for (; i < qty16; i += 16) {
+                const auto v0 = load_component_avx2(pVect1 + i);
+                const auto v1 = load_component_avx2(pVect1 + i + 8);
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    sum0[k] = _mm256_fmadd_ps(v0, load_component_avx2(pVect2[k] + i), sum0[k]);
+                    sum1[k] = _mm256_fmadd_ps(v1, load_component_avx2(pVect2[k] + i + 8), sum1[k]);
+                }
+            }
+            if (qty - i >= 8) {
+                const auto v0 = load_component_avx2(pVect1 + i);
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    sum0[k] = _mm256_fmadd_ps(v0, load_component_avx2(pVect2[k] + i), sum0[k]);
+                }
+                i += 8;
+            }
+            HNSW_UNROLL
+            for (size_t k = 0; k < 4; k++) {
+                out[b + k] = reduce_add_avx(_mm256_add_ps(sum0[k], sum1[k]));
+            }
+            if (i < qty) {
+                const auto v0 = load_component_avx(pVect1 + i, qty - i);
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    out[b + k] += reduce_add_avx(_mm256_mul_ps(v0, load_component_avx(pVect2[k] + i, qty - i)));
+                }
+            }
+            HNSW_UNROLL
+            for (size_t k = 0; k < 4; k++) {
+                out[b + k] = 1.0f - out[b + k];
+            }
+        }
+        for (; b < n; b++) {
+            out[b] = InnerProductAVX2<TARG1, TARG2>(pVect1v, data[b], qty_ptr);
+        }
+    }
+
+    // Fixed size vectors: four fused multiply-add chains over 32 components per step, fully unrolled
+    template<typename TARG1, typename TARG2>
+    struct InnerProductAVX2Fixed {
+        template<size_t DIM>
+        HNSW_TARGET("avx2,fma")
+        static float distance(const void *pVect1v, const void *pVect2v, const void *) {
+            static_assert(DIM % 32 == 0, "Fixed dimensions are multiples of 32");
+            const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+            const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+            auto sum0 = _mm256_setzero_ps();
+            auto sum1 = _mm256_setzero_ps();
+            auto sum2 = _mm256_setzero_ps();
+            auto sum3 = _mm256_setzero_ps();
+            HNSW_UNROLL
+            for (size_t i = 0; i < DIM; i += 32) {
+                sum0 = _mm256_fmadd_ps(load_component_avx2(pVect1 + i), load_component_avx2(pVect2 + i), sum0);
+                sum1 = _mm256_fmadd_ps(load_component_avx2(pVect1 + i + 8), load_component_avx2(pVect2 + i + 8), sum1);
+                sum2 = _mm256_fmadd_ps(load_component_avx2(pVect1 + i + 16), load_component_avx2(pVect2 + i + 16), sum2);
+                sum3 = _mm256_fmadd_ps(load_component_avx2(pVect1 + i + 24), load_component_avx2(pVect2 + i + 24), sum3);
+            }
+            return 1.0f - reduce_add_avx(_mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3)));
+        }
+
+        // Two vectors per pass against the query loaded once, each summed in the order of `distance`
+        template<size_t DIM>
+        HNSW_TARGET("avx2,fma")
+        static void batch(const void *pVect1v, const void *const *data, size_t n, const void *, float *out) {
+            const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+            size_t b = 0;
+            for (; b + 2 <= n; b += 2) {
+                const TARG2 *pVect2[2];
+                __m256 sum[2][4];
+                HNSW_UNROLL
+                for (size_t k = 0; k < 2; k++) {
+                    pVect2[k] = static_cast<const TARG2*>(data[b + k]);
+                    for (size_t c = 0; c < 4; c++) sum[k][c] = _mm256_setzero_ps();
+                }
+                HNSW_UNROLL
+                for (size_t i = 0; i < DIM; i += 32) {
+                    HNSW_UNROLL
+                    for (size_t c = 0; c < 4; c++) {
+                        const auto v = load_component_avx2(pVect1 + i + 8 * c);
+                        HNSW_UNROLL
+                        for (size_t k = 0; k < 2; k++) {
+                            sum[k][c] = _mm256_fmadd_ps(v, load_component_avx2(pVect2[k] + i + 8 * c), sum[k][c]);
+                        }
+                    }
+                }
+                HNSW_UNROLL
+                for (size_t k = 0; k < 2; k++) {
+                    out[b + k] = 1.0f - reduce_add_avx(_mm256_add_ps(_mm256_add_ps(sum[k][0], sum[k][1]), _mm256_add_ps(sum[k][2], sum[k][3])));
+                }
+            }
+            if (b < n) {
+                out[b] = distance<DIM>(pVect1v, data[b], nullptr);
+            }
+        }
+    };
+
+    HNSW_AVX512_BEGIN
+    // Two 512 bits chains over 32 components per step, the tail loaded under a mask, 8 components or more
+    template<typename TARG1, typename TARG2>
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static float
+    InnerProductAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+        const auto qty = *static_cast<const size_t*>(qty_ptr);
+        const auto qty32 = qty >> 5 << 5;
+        const __mmask16 all = 0xFFFF;
+        auto sum0 = _mm512_setzero_ps();
+        auto sum1 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i < qty32; i += 32) {
+            sum0 = _mm512_fmadd_ps(load_component_avx512(pVect1 + i, all), load_component_avx512(pVect2 + i, all), sum0);
+            sum1 = _mm512_fmadd_ps(load_component_avx512(pVect1 + i + 16, all), load_component_avx512(pVect2 + i + 16, all), sum1);
+        }
+        for (; i < qty; i += 16) {
+            const auto mask = get_tail_mask_avx512(qty - i);
+            sum0 = _mm512_fmadd_ps(load_component_avx512(pVect1 + i, mask), load_component_avx512(pVect2 + i, mask), sum0);
+        }
+        return 1.0f - _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+    }
+
+    // Four vectors per pass against the query loaded once, each summed in the order of InnerProductAVX512
+    template<typename TARG1, typename TARG2>
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static void
+    InnerProductBatchAVX512(const void *pVect1v, const void *const *data, size_t n, const void *qty_ptr, float *out) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto qty = *static_cast<const size_t*>(qty_ptr);
+        const auto qty32 = qty >> 5 << 5;
+        const __mmask16 all = 0xFFFF;
+        size_t b = 0;
+        for (; b + 4 <= n; b += 4) {
+            const TARG2 *pVect2[4];
+            __m512 sum0[4], sum1[4];
+            HNSW_UNROLL
+            for (size_t k = 0; k < 4; k++) {
+                pVect2[k] = static_cast<const TARG2*>(data[b + k]);
+                sum0[k] = _mm512_setzero_ps();
+                sum1[k] = _mm512_setzero_ps();
+            }
+            size_t i = 0;
+            for (; i < qty32; i += 32) {
+                const auto v0 = load_component_avx512(pVect1 + i, all);
+                const auto v1 = load_component_avx512(pVect1 + i + 16, all);
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    sum0[k] = _mm512_fmadd_ps(v0, load_component_avx512(pVect2[k] + i, all), sum0[k]);
+                    sum1[k] = _mm512_fmadd_ps(v1, load_component_avx512(pVect2[k] + i + 16, all), sum1[k]);
+                }
+            }
+            for (; i < qty; i += 16) {
+                const auto mask = get_tail_mask_avx512(qty - i);
+                const auto v0 = load_component_avx512(pVect1 + i, mask);
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    sum0[k] = _mm512_fmadd_ps(v0, load_component_avx512(pVect2[k] + i, mask), sum0[k]);
+                }
+            }
+            HNSW_UNROLL
+            for (size_t k = 0; k < 4; k++) {
+                out[b + k] = 1.0f - _mm512_reduce_add_ps(_mm512_add_ps(sum0[k], sum1[k]));
+            }
+        }
+        for (; b < n; b++) {
+            out[b] = InnerProductAVX512<TARG1, TARG2>(pVect1v, data[b], qty_ptr);
+        }
+    }
+
+    // Fixed size vectors: four 512 bits chains over 64 components per step, fully unrolled
+    template<typename TARG1, typename TARG2>
+    struct InnerProductAVX512Fixed {
+        template<size_t DIM>
+        HNSW_TARGET(HNSW_AVX512_ISA)
+        static float distance(const void *pVect1v, const void *pVect2v, const void *) {
+            static_assert(DIM % 32 == 0, "Fixed dimensions are multiples of 32");
+            const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+            const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+            const size_t dim64 = DIM >> 6 << 6;
+            const __mmask16 all = 0xFFFF;
+            auto sum0 = _mm512_setzero_ps();
+            auto sum1 = _mm512_setzero_ps();
+            auto sum2 = _mm512_setzero_ps();
+            auto sum3 = _mm512_setzero_ps();
+            HNSW_UNROLL
+            for (size_t i = 0; i < dim64; i += 64) {
+                sum0 = _mm512_fmadd_ps(load_component_avx512(pVect1 + i, all), load_component_avx512(pVect2 + i, all), sum0);
+                sum1 = _mm512_fmadd_ps(load_component_avx512(pVect1 + i + 16, all), load_component_avx512(pVect2 + i + 16, all), sum1);
+                sum2 = _mm512_fmadd_ps(load_component_avx512(pVect1 + i + 32, all), load_component_avx512(pVect2 + i + 32, all), sum2);
+                sum3 = _mm512_fmadd_ps(load_component_avx512(pVect1 + i + 48, all), load_component_avx512(pVect2 + i + 48, all), sum3);
+            }
+            if (dim64 < DIM) {
+                sum0 = _mm512_fmadd_ps(load_component_avx512(pVect1 + dim64, all), load_component_avx512(pVect2 + dim64, all), sum0);
+                sum1 = _mm512_fmadd_ps(load_component_avx512(pVect1 + dim64 + 16, all), load_component_avx512(pVect2 + dim64 + 16, all), sum1);
+            }
+            return 1.0f - _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(sum0, sum1), _mm512_add_ps(sum2, sum3)));
+        }
+
+        // Four vectors per pass against the query loaded once, each summed in the order of `distance`
+        template<size_t DIM>
+        HNSW_TARGET(HNSW_AVX512_ISA)
+        static void batch(const void *pVect1v, const void *const *data, size_t n, const void *, float *out) {
+            const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+            const size_t dim64 = DIM >> 6 << 6;
+            const __mmask16 all = 0xFFFF;
+            size_t b = 0;
+            for (; b + 4 <= n; b += 4) {
+                const TARG2 *pVect2[4];
+                __m512 sum[4][4];
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    pVect2[k] = static_cast<const TARG2*>(data[b + k]);
+                    for (size_t c = 0; c < 4; c++) sum[k][c] = _mm512_setzero_ps();
+                }
+                HNSW_UNROLL
+                for (size_t i = 0; i < DIM; i += 64) {
+                    // The last 32 components of dimensions that aren't multiples of 64 go to the first two chains
+                    const size_t nb_chains = i < dim64 ? 4 : 2;
+                    HNSW_UNROLL
+                    for (size_t c = 0; c < nb_chains; c++) {
+                        const auto v = load_component_avx512(pVect1 + i + 16 * c, all);
+                        HNSW_UNROLL
+                        for (size_t k = 0; k < 4; k++) {
+                            sum[k][c] = _mm512_fmadd_ps(v, load_component_avx512(pVect2[k] + i + 16 * c, all), sum[k][c]);
+                        }
+                    }
+                }
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    out[b + k] = 1.0f - _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(sum[k][0], sum[k][1]), _mm512_add_ps(sum[k][2], sum[k][3])));
+                }
+            }
+            for (; b < n; b++) {
+                out[b] = distance<DIM>(pVect1v, data[b], nullptr);
+            }
+        }
+    };
+    HNSW_AVX512_END
+#endif
+
     template<typename TCOMPR=float>
     class InnerProductSpace : public SpaceInterface<float> {
 
         DISTFUNC<float> fstdistfunc_;
         DISTFUNC<float> fstdist_search_func_;
+        DISTBATCHFUNC<float> fstdist_search_batch_func_ = nullptr;
         const size_t data_size_;
         size_t dim_;
     public:
@@ -210,13 +510,31 @@ namespace hnswlib {
                 fstdist_search_func_ = InnerProductSIMD8Ext<float, TCOMPR>;
             }
             else if (dim > 8) {
-                fstdistfunc_ = InnerProductSIMD8ExtResiduals<TCOMPR, TCOMPR>;
-                fstdist_search_func_ = InnerProductSIMD8ExtResiduals<float, TCOMPR>;
+                fstdistfunc_ = InnerProductSIMD8ExtMasked<TCOMPR, TCOMPR>;
+                fstdist_search_func_ = InnerProductSIMD8ExtMasked<float, TCOMPR>;
             }
             else if (dim > 4) {
                 fstdistfunc_ = InnerProductSIMD4ExtResiduals<TCOMPR, TCOMPR>;
                 fstdist_search_func_ = InnerProductSIMD4ExtResiduals<float, TCOMPR>;
             }
+    #endif
+    #if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+            if (dim >= 8 && cpu_supports_avx2_fma()) {
+                fstdistfunc_ = InnerProductAVX2<TCOMPR, TCOMPR>;
+                fstdist_search_func_ = InnerProductAVX2<float, TCOMPR>;
+                fstdist_search_batch_func_ = InnerProductBatchAVX2<float, TCOMPR>;
+                use_fixed_dim_func<InnerProductAVX2Fixed<TCOMPR, TCOMPR>>(dim, fstdistfunc_);
+                if (use_fixed_dim_func<InnerProductAVX2Fixed<float, TCOMPR>>(dim, fstdist_search_func_))
+                    fstdist_search_batch_func_ = get_fixed_dim_batch_func<InnerProductAVX2Fixed<float, TCOMPR>>(dim);
+            }
+            if (dim >= 16 && cpu_supports_avx512()) {
+                fstdistfunc_ = InnerProductAVX512<TCOMPR, TCOMPR>;
+                fstdist_search_func_ = InnerProductAVX512<float, TCOMPR>;
+                fstdist_search_batch_func_ = InnerProductBatchAVX512<float, TCOMPR>;
+                use_fixed_dim_func<InnerProductAVX512Fixed<TCOMPR, TCOMPR>>(dim, fstdistfunc_);
+                if (use_fixed_dim_func<InnerProductAVX512Fixed<float, TCOMPR>>(dim, fstdist_search_func_))
+                    fstdist_search_batch_func_ = get_fixed_dim_batch_func<InnerProductAVX512Fixed<float, TCOMPR>>(dim);
+            }
     #endif
         }
 
@@ -232,6 +550,10 @@ namespace hnswlib {
             return fstdist_search_func_;
         }
 
+        DISTBATCHFUNC<float> get_search_dist_batch_func() const override {
+            return fstdist_search_batch_func_;
+        }
+
         void *get_dist_func_param() override {
             return &dim_;
         }
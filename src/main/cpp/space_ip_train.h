@@ -1,5 +1,6 @@
 #pragma once
 #include "hnswlib.h"
+#include <type_traits>
 
 namespace hnswlib {
 
@@ -142,26 +143,38 @@ namespace hnswlib {
         return 1.0f - sum;
     }
 
-#endif
-
-#if defined(USE_SSE) || defined(USE_AVX)
-
+    // 8 components or more: the last partial step is loaded with zeros past the end, within the same call
     template<typename TARG1, typename TARG2>
     static float
-    InnerProductSIMD8ExtResiduals_trained(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+    InnerProductSIMD8ExtMasked_trained(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto pVect2 = static_cast<const TARG2*>(pVect2v);
         const auto params = static_cast<const TrainParams*>(diff_ptr);
         const auto qty = params->dim;
         const auto qty8 = qty >> 3 << 3;
-        TrainParams params8(params->min, params->diff, qty8, true);
-        const auto res = InnerProductSIMD8Ext_trained<TARG1, TARG2>(pVect1v, pVect2v, &params8);
-        const auto pVect1 = static_cast<const TARG1*>(pVect1v) + qty8;
-        const auto pVect2 = static_cast<const TARG2*>(pVect2v) + qty8;
+        const auto pMin = params->min;
+        const auto pDiff = params->diff;
+        __m256 sum256 = _mm256_set1_ps(0);
 
-        const auto qty_left = qty - qty8;
-        TrainParams params_left(params->min + qty8, params->diff + qty8, qty_left, true);
-        const auto res_tail = InnerProduct_trained<TARG1, TARG2>(pVect1, pVect2, &params_left);
-        return res + res_tail - 1.0f;
+        for (size_t i = 0; i < qty8; i += 8) {
+            sum256 += load_component_avx(pVect1 + i, pMin + i, pDiff + i) * load_component_avx(pVect2 + i, pMin + i, pDiff + i);
+        }
+        if (qty8 < qty) {
+            const auto qty_left = qty - qty8;
+            const auto v1 = load_component_avx(pVect1 + qty8, pMin + qty8, pDiff + qty8, qty_left);
+            const auto v2 = load_component_avx(pVect2 + qty8, pMin + qty8, pDiff + qty8, qty_left);
+            sum256 += v1 * v2;
+        }
+
+        float PORTABLE_ALIGN32 TmpRes[8];
+        _mm256_store_ps(TmpRes, sum256);
+        float sum = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+
+        return 1.0f - sum;
     }
+#endif
+
+#if defined(USE_SSE) || defined(USE_AVX)
 
     template<typename TARG1, typename TARG2>
     static float
@@ -181,6 +194,171 @@ namespace hnswlib {
     }
 #endif
 
+    /**
+     * Float8 queries folded with the trained ranges once per search: q.(min + diff * code) equals
+     * bias + scale * sum(weight * code), weights being q * diff quantized on 16 bits. The buffer
+     * holds `bias`, `scale` then the `dim` weights.
+     **/
+    static const float quantized_query_max_weight = 32767.f;
+
+    static inline const int16_t *get_quantized_query_weights(const void *pVect1v) {
+        return reinterpret_cast<const int16_t *>(static_cast<const float *>(pVect1v) + 2);
+    }
+
+    // Writes `bias`, `scale` and the weights of `query` to `buffer`, for Float8 and Float4 codes alike
+    static inline const void *prepare_quantized_query(const float *query, const TrainParams &params, std::vector<char> &buffer) {
+        const auto dim = params.dim;
+        buffer.resize(2 * sizeof(float) + dim * sizeof(int16_t));
+        const auto header = reinterpret_cast<float *>(buffer.data());
+        const auto weights = reinterpret_cast<int16_t *>(header + 2);
+        float bias = 0, max_weight = 0;
+        for (size_t i = 0; i < dim; i++) {
+            bias += query[i] * params.min[i];
+            max_weight = std::max(max_weight, std::abs(query[i] * params.diff[i]));
+        }
+        const auto scale = max_weight > 0 ? max_weight / quantized_query_max_weight : 1.f;
+        for (size_t i = 0; i < dim; i++) {
+            weights[i] = static_cast<int16_t>(std::round(query[i] * params.diff[i] / scale));
+        }
+        header[0] = bias;
+        header[1] = scale;
+        return header;
+    }
+
+    static inline float
+    InnerProduct_quantized_query(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto header = static_cast<const float *>(pVect1v);
+        const auto weights = get_quantized_query_weights(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto qty = static_cast<const TrainParams *>(diff_ptr)->dim;
+        int64_t res = 0;
+        for (size_t i = 0; i < qty; i++) {
+            res += weights[i] * pVect2[i];
+        }
+        return 1.0f - header[0] - header[1] * res;
+    }
+
+#if defined(USE_SSE) || defined(USE_AVX)
+
+    // 16 components per step with 16 bits products summed pairwise in 32 bits lanes, no AVX2 needed
+    static inline float
+    InnerProductSIMD16_quantized_query(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto header = static_cast<const float *>(pVect1v);
+        const auto weights = get_quantized_query_weights(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto qty = static_cast<const TrainParams *>(diff_ptr)->dim;
+        const auto qty16 = qty >> 4 << 4;
+        // A lane grows by at most 4 * 255 * 32767 per step, flushed to floats before overflowing
+        const size_t block = 512;
+        const auto zero = _mm_setzero_si128();
+        auto sum = _mm_set1_ps(0);
+        for (size_t start = 0; start < qty16; start += block) {
+            const auto end = std::min(start + block, qty16);
+            auto sum_int = _mm_setzero_si128();
+            for (size_t i = start; i < end; i += 16) {
+                const auto codes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pVect2 + i));
+                const auto w_lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + i));
+                const auto w_hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + i + 8));
+                sum_int = _mm_add_epi32(sum_int, _mm_madd_epi16(_mm_unpacklo_epi8(codes, zero), w_lo));
+                sum_int = _mm_add_epi32(sum_int, _mm_madd_epi16(_mm_unpackhi_epi8(codes, zero), w_hi));
+            }
+            sum += _mm_cvtepi32_ps(sum_int);
+        }
+        float PORTABLE_ALIGN32 TmpRes[8];
+        _mm_store_ps(TmpRes, sum);
+        float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+        int32_t res_tail = 0;
+        for (size_t i = qty16; i < qty; i++) {
+            res_tail += weights[i] * pVect2[i];
+        }
+        return 1.0f - header[0] - header[1] * (res + res_tail);
+    }
+
+#endif
+
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+
+    // 8 components per step accumulated with fused multiply-adds, the tail loaded under a mask, 8 components or more
+    template<typename TARG1, typename TARG2>
+    HNSW_TARGET("avx2,fma")
+    static float
+    InnerProductAVX2_trained(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+        const auto params = static_cast<const TrainParams*>(diff_ptr);
+        const auto qty = params->dim;
+        const auto qty8 = qty >> 3 << 3;
+        const auto pMin = params->min;
+        const auto pDiff = params->diff;
+        auto sum = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i < qty8; i += 8) {
+            const auto v1 = load_component_avx2(pVect1 + i, pMin + i, pDiff + i);
+            const auto v2 = load_component_avx2(pVect2 + i, pMin + i, pDiff + i);
+            sum = _mm256_fmadd_ps(v1, v2, sum);
+        }
+        if (i < qty) {
+            const auto v1 = load_component_avx(pVect1 + i, pMin + i, pDiff + i, qty - i);
+            const auto v2 = load_component_avx(pVect2 + i, pMin + i, pDiff + i, qty - i);
+            sum = _mm256_fmadd_ps(v1, v2, sum);
+        }
+        return 1.0f - reduce_add_avx(sum);
+    }
+
+    HNSW_AVX512_BEGIN
+    // 16 components per step, the tail loaded under a mask, 8 components or more
+    template<typename TARG1, typename TARG2>
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static float
+    InnerProductAVX512_trained(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+        const auto params = static_cast<const TrainParams*>(diff_ptr);
+        const auto qty = params->dim;
+        const auto pMin = params->min;
+        const auto pDiff = params->diff;
+        auto sum = _mm512_setzero_ps();
+        for (size_t i = 0; i < qty; i += 16) {
+            const auto mask = get_tail_mask_avx512(qty - i);
+            const auto v1 = load_component_avx512(pVect1 + i, pMin + i, pDiff + i, mask);
+            const auto v2 = load_component_avx512(pVect2 + i, pMin + i, pDiff + i, mask);
+            sum = _mm512_fmadd_ps(v1, v2, sum);
+        }
+        return 1.0f - _mm512_reduce_add_ps(sum);
+    }
+    HNSW_AVX512_END
+
+    // `InnerProductSIMD16_quantized_query` with codes widened to 16 bits in a single 256 bits register
+    HNSW_TARGET("avx2,fma")
+    static inline float
+    InnerProductAVX2_quantized_query(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto header = static_cast<const float *>(pVect1v);
+        const auto weights = get_quantized_query_weights(pVect1v);
+        const auto pVect2 = static_cast<const uint8_t *>(pVect2v);
+        const auto qty = static_cast<const TrainParams *>(diff_ptr)->dim;
+        const auto qty16 = qty >> 4 << 4;
+        // A lane grows by at most 2 * 255 * 32767 per step, flushed to floats before overflowing
+        const size_t block = 1024;
+        auto sum = _mm256_setzero_ps();
+        for (size_t start = 0; start < qty16; start += block) {
+            const auto end = std::min(start + block, qty16);
+            auto sum_int = _mm256_setzero_si256();
+            for (size_t i = start; i < end; i += 16) {
+                const auto codes = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pVect2 + i)));
+                const auto w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i));
+                sum_int = _mm256_add_epi32(sum_int, _mm256_madd_epi16(codes, w));
+            }
+            sum = _mm256_add_ps(sum, _mm256_cvtepi32_ps(sum_int));
+        }
+        const auto res = reduce_add_avx(sum);
+        int32_t res_tail = 0;
+        for (size_t i = qty16; i < qty; i++) {
+            res_tail += weights[i] * pVect2[i];
+        }
+        return 1.0f - header[0] - header[1] * (res + res_tail);
+    }
+#endif
+
     template<typename TCOMPR=uint8_t>
     class InnerProductTrainedSpace : public SpaceInterface<float> {
 
@@ -205,14 +383,34 @@ namespace hnswlib {
                 fstdist_search_func_ = InnerProductSIMD8Ext_trained<float, TCOMPR>;
             }
             else if (dim > 8) {
-                fstdistfunc_ = InnerProductSIMD8ExtResiduals_trained<TCOMPR, TCOMPR>;
-                fstdist_search_func_ = InnerProductSIMD8ExtResiduals_trained<float, TCOMPR>;
+                fstdistfunc_ = InnerProductSIMD8ExtMasked_trained<TCOMPR, TCOMPR>;
+                fstdist_search_func_ = InnerProductSIMD8ExtMasked_trained<float, TCOMPR>;
             }
             else if (dim > 4) {
                 fstdistfunc_ = InnerProductSIMD4ExtResiduals_trained<TCOMPR, TCOMPR>;
                 fstdist_search_func_ = InnerProductSIMD4ExtResiduals_trained<float, TCOMPR>;
             }
     #endif
+    #if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+            const auto use_avx2 = dim >= 8 && cpu_supports_avx2_fma();
+            if (use_avx2) {
+                fstdistfunc_ = InnerProductAVX2_trained<TCOMPR, TCOMPR>;
+                fstdist_search_func_ = InnerProductAVX2_trained<float, TCOMPR>;
+            }
+            if (dim >= 16 && cpu_supports_avx512()) {
+                fstdistfunc_ = InnerProductAVX512_trained<TCOMPR, TCOMPR>;
+                fstdist_search_func_ = InnerProductAVX512_trained<float, TCOMPR>;
+            }
+    #endif
+            if (std::is_same<TCOMPR, uint8_t>::value) {
+                fstdist_search_func_ = InnerProduct_quantized_query;
+            #if defined(USE_SSE) || defined(USE_AVX)
+                if (dim >= 16) fstdist_search_func_ = InnerProductSIMD16_quantized_query;
+            #endif
+            #if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+                if (dim >= 16 && use_avx2) fstdist_search_func_ = InnerProductAVX2_quantized_query;
+            #endif
+            }
         }
 
         size_t get_data_size() override {
@@ -240,6 +438,11 @@ namespace hnswlib {
             return &params;
         }
 
+        const void *prepare_query(const float *query, std::vector<char> &buffer) const override {
+            if (!std::is_same<TCOMPR, uint8_t>::value) return query;
+            return prepare_quantized_query(query, params, buffer);
+        }
+
         ~InnerProductTrainedSpace() override = default;
     };
 
@@ -1,10 +1,23 @@
 #pragma once
+#include "cpu_features.h"
 #include "hnswlib.h"
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
 
 
 namespace hnswlib {
 
+    // Pairs ordered the same way in both vectors count 1, the others -1, ties included
+    static inline float kendall_distance(size_t concordant, size_t qty) {
+        const size_t pairs = qty * (qty - 1) / 2;
+        float res = static_cast<float>(2 * concordant) - static_cast<float>(pairs);
+        res /= pairs;
+        return (1.0f - res);
+    }
+
     static float
     Kendall(const void *pVect1, const void *pVect2, const void *qty_ptr) {
         size_t qty = *((size_t *) qty_ptr);
@@ -28,6 +41,274 @@ namespace hnswlib {
         return (1.0f - res);
     }
 
+    // Pairs tied in a sorted sequence
+    template<typename T, typename EQUAL>
+    static inline size_t count_tied_pairs(const T *values, size_t qty, EQUAL equal) {
+        size_t tied = 0;
+        size_t run = 1;
+        for (size_t i = 1; i < qty; i++) {
+            if (equal(values[i - 1], values[i])) {
+                tied += run++;
+            } else {
+                run = 1;
+            }
+        }
+        return tied;
+    }
+
+    // Unsigned integers in the order of the components, -0 and 0 as one value
+    static inline uint32_t order_key(float x) {
+        x += 0.0f;
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(float));
+        return bits ^ ((bits >> 31) ? 0xFFFFFFFFu : 0x80000000u);
+    }
+
+    static inline uint32_t order_key(uint8_t x) {
+        return x;
+    }
+
+    static inline uint32_t order_key(uint16_t x) {
+        return x;
+    }
+
+    // Sorts `values` bottom-up and returns the number of pairs i < j with values[i] > values[j]
+    static inline size_t merge_sort_inversions(uint32_t *values, uint32_t *buffer, size_t qty) {
+        size_t inversions = 0;
+        auto src = values;
+        auto dst = buffer;
+        for (size_t width = 1; width < qty; width *= 2) {
+            for (size_t start = 0; start < qty; start += 2 * width) {
+                const auto middle = std::min(start + width, qty);
+                const auto end = std::min(start + 2 * width, qty);
+                size_t left = start, right = middle, out = start;
+                // Branchless, which side is taken is as good as random
+                while (left < middle && right < end) {
+                    const auto l = src[left];
+                    const auto r = src[right];
+                    const bool take_right = r < l;
+                    dst[out++] = take_right ? r : l;
+                    inversions += take_right ? middle - left : 0;
+                    right += take_right;
+                    left += !take_right;
+                }
+                while (left < middle) dst[out++] = src[left++];
+                while (right < end) dst[out++] = src[right++];
+            }
+            std::swap(src, dst);
+        }
+        if (src != values)
+            memcpy(values, src, qty * sizeof(uint32_t));
+        return inversions;
+    }
+
+    /**
+     * Knight's O(n log n) algorithm: components sorted by the first vector, ties broken by the
+     * second, then the discordant pairs are the inversions of the second vector in that order,
+     * counted by a merge sort. Concordant pairs are the others minus the tied ones. Both vectors
+     * are sorted as integer keys, the first one in the high half of 64 bits.
+     **/
+    template<typename T>
+    static float
+    KendallMergeSort(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+        const auto pVect1 = static_cast<const T *>(pVect1v);
+        const auto pVect2 = static_cast<const T *>(pVect2v);
+        const size_t qty = *static_cast<const size_t *>(qty_ptr);
+        // Scratch of the calling thread, searches and insertions run in parallel
+        static thread_local std::vector<uint64_t> keys_buffer;
+        static thread_local std::vector<uint32_t> sorted_buffer;
+        auto &keys = keys_buffer;
+        auto &sorted = sorted_buffer;
+        keys.resize(qty);
+        sorted.resize(2 * qty);
+        for (size_t i = 0; i < qty; i++) {
+            keys[i] = static_cast<uint64_t>(order_key(pVect1[i])) << 32 | order_key(pVect2[i]);
+        }
+        std::sort(keys.begin(), keys.end());
+        const auto tied1 = count_tied_pairs(keys.data(), qty, [](uint64_t a, uint64_t b) { return (a >> 32) == (b >> 32); });
+        const auto tied_both = count_tied_pairs(keys.data(), qty, [](uint64_t a, uint64_t b) { return a == b; });
+        for (size_t i = 0; i < qty; i++) {
+            sorted[i] = static_cast<uint32_t>(keys[i]);
+        }
+        const auto discordant = merge_sort_inversions(sorted.data(), sorted.data() + qty, qty);
+        const auto tied2 = count_tied_pairs(sorted.data(), qty, [](uint32_t a, uint32_t b) { return a == b; });
+        const size_t pairs = qty * (qty - 1) / 2;
+        return kendall_distance(pairs - discordant - tied1 - tied2 + tied_both, qty);
+    }
+
+    /**
+     * Only the order of the components matters to Kendall distances, vectors can be stored as their
+     * dense ranks: 0 for the smallest component, tied components share a rank. Exact as long as
+     * the number of distinct components fits in TRANK.
+     **/
+    template<typename TRANK>
+    static inline void encode_rank_vector(const float *src, TRANK *dst, const size_t *qty_ptr) {
+        const size_t qty = *qty_ptr;
+        std::vector<uint64_t> keys(qty);
+        for (size_t i = 0; i < qty; i++) {
+            keys[i] = static_cast<uint64_t>(order_key(src[i])) << 32 | i;
+        }
+        std::sort(keys.begin(), keys.end());
+        TRANK rank = 0;
+        for (size_t i = 0; i < qty; i++) {
+            if (i > 0 && (keys[i] >> 32) != (keys[i - 1] >> 32))
+                rank++;
+            dst[static_cast<uint32_t>(keys[i])] = rank;
+        }
+    }
+
+    // The ranks, in the same order as the original components
+    template<typename TRANK>
+    static inline void decode_rank_vector(const TRANK *src, float *dst, const size_t *qty_ptr) {
+        for (size_t i = 0; i < *qty_ptr; i++) {
+            dst[i] = src[i];
+        }
+    }
+
+    template<typename TRANK>
+    static float
+    KendallRanks(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+        const auto pVect1 = static_cast<const TRANK *>(pVect1v);
+        const auto pVect2 = static_cast<const TRANK *>(pVect2v);
+        const size_t qty = *static_cast<const size_t *>(qty_ptr);
+        size_t concordant = 0;
+        for (size_t i = 0; i + 1 < qty; i++) {
+            for (size_t j = i + 1; j < qty; j++) {
+                concordant += (pVect1[i] < pVect1[j] && pVect2[i] < pVect2[j]) ||
+                              (pVect1[i] > pVect1[j] && pVect2[i] > pVect2[j]);
+            }
+        }
+        return kendall_distance(concordant, qty);
+    }
+
+#if defined(HNSW_RUNTIME_DISPATCH)
+
+    /**
+     * Same pairs as `Kendall`, component i compared with 8 following ones per step: pairs where
+     * both vectors increase or both decrease are set in a `movemask` and counted with `popcnt`.
+     * The last step loads under a mask.
+     **/
+    HNSW_TARGET("avx2,popcnt")
+    static float
+    KendallAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+        const auto pVect1 = static_cast<const float *>(pVect1v);
+        const auto pVect2 = static_cast<const float *>(pVect2v);
+        const size_t qty = *static_cast<const size_t *>(qty_ptr);
+        const auto lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        size_t concordant = 0;
+        for (size_t i = 0; i + 1 < qty; i++) {
+            const auto v1 = _mm256_set1_ps(pVect1[i]);
+            const auto u1 = _mm256_set1_ps(pVect2[i]);
+            for (size_t j = i + 1; j < qty; j += 8) {
+                __m256 v2, u2;
+                if (j + 8 <= qty) {
+                    v2 = _mm256_loadu_ps(pVect1 + j);
+                    u2 = _mm256_loadu_ps(pVect2 + j);
+                } else {
+                    const auto mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(qty - j), lanes);
+                    v2 = _mm256_maskload_ps(pVect1 + j, mask);
+                    u2 = _mm256_maskload_ps(pVect2 + j, mask);
+                }
+                const auto increasing = _mm256_and_ps(_mm256_cmp_ps(v1, v2, _CMP_LT_OQ), _mm256_cmp_ps(u1, u2, _CMP_LT_OQ));
+                const auto decreasing = _mm256_and_ps(_mm256_cmp_ps(v1, v2, _CMP_GT_OQ), _mm256_cmp_ps(u1, u2, _CMP_GT_OQ));
+                auto bits = static_cast<unsigned>(_mm256_movemask_ps(_mm256_or_ps(increasing, decreasing)));
+                if (j + 8 > qty)
+                    bits &= (1u << (qty - j)) - 1;
+                concordant += _mm_popcnt_u32(bits);
+            }
+        }
+        return kendall_distance(concordant, qty);
+    }
+
+
+    template<typename TRANK>
+    struct RankLanes;
+
+    // 32 ranks per step, compared as signed bytes once shifted by 128
+    template<>
+    struct RankLanes<uint8_t> {
+        static const size_t lanes = 32;
+        static const size_t bits_per_lane = 1;
+
+        HNSW_TARGET("avx2")
+        static inline __m256i broadcast(uint8_t x) {
+            return _mm256_set1_epi8(static_cast<char>(x ^ 0x80));
+        }
+
+        HNSW_TARGET("avx2")
+        static inline __m256i load(const uint8_t *ranks) {
+            return _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(ranks)), _mm256_set1_epi8(static_cast<char>(0x80)));
+        }
+
+        HNSW_TARGET("avx2")
+        static inline __m256i greater(__m256i a, __m256i b) {
+            return _mm256_cmpgt_epi8(a, b);
+        }
+    };
+
+    // 16 ranks per step, each sets 2 bits of the byte mask
+    template<>
+    struct RankLanes<uint16_t> {
+        static const size_t lanes = 16;
+        static const size_t bits_per_lane = 2;
+
+        HNSW_TARGET("avx2")
+        static inline __m256i broadcast(uint16_t x) {
+            return _mm256_set1_epi16(static_cast<short>(x ^ 0x8000));
+        }
+
+        HNSW_TARGET("avx2")
+        static inline __m256i load(const uint16_t *ranks) {
+            return _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(ranks)), _mm256_set1_epi16(static_cast<short>(0x8000)));
+        }
+
+        HNSW_TARGET("avx2")
+        static inline __m256i greater(__m256i a, __m256i b) {
+            return _mm256_cmpgt_epi16(a, b);
+        }
+    };
+
+    /**
+     * `KendallAVX2` on ranks, 4 or 2 times more pairs per step. The last step reads a zero padded
+     * copy of the tail.
+     **/
+    template<typename TRANK>
+    HNSW_TARGET("avx2,popcnt")
+    static float
+    KendallRanksAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+        typedef RankLanes<TRANK> R;
+        const auto pVect1 = static_cast<const TRANK *>(pVect1v);
+        const auto pVect2 = static_cast<const TRANK *>(pVect2v);
+        const size_t qty = *static_cast<const size_t *>(qty_ptr);
+        TRANK tail1[R::lanes], tail2[R::lanes];
+        size_t concordant = 0;
+        for (size_t i = 0; i + 1 < qty; i++) {
+            const auto v1 = R::broadcast(pVect1[i]);
+            const auto u1 = R::broadcast(pVect2[i]);
+            for (size_t j = i + 1; j < qty; j += R::lanes) {
+                const auto left = qty - j;
+                const auto full = left >= R::lanes;
+                if (!full) {
+                    memset(tail1, 0, sizeof(tail1));
+                    memset(tail2, 0, sizeof(tail2));
+                    memcpy(tail1, pVect1 + j, left * sizeof(TRANK));
+                    memcpy(tail2, pVect2 + j, left * sizeof(TRANK));
+                }
+                const auto v2 = R::load(full ? pVect1 + j : tail1);
+                const auto u2 = R::load(full ? pVect2 + j : tail2);
+                const auto increasing = _mm256_and_si256(R::greater(v2, v1), R::greater(u2, u1));
+                const auto decreasing = _mm256_and_si256(R::greater(v1, v2), R::greater(u1, u2));
+                auto bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(increasing, decreasing)));
+                if (!full)
+                    bits &= (1u << (left * R::bits_per_lane)) - 1;
+                concordant += _mm_popcnt_u32(bits);
+            }
+        }
+        return kendall_distance(concordant / R::bits_per_lane, qty);
+    }
+
+#endif
+
     class KendallSpace : public SpaceInterface<float> {
 
         DISTFUNC<float> fstdistfunc_;
@@ -35,7 +316,13 @@ namespace hnswlib {
         size_t dim_;
     public:
         KendallSpace(size_t dim) {
-            fstdistfunc_ = Kendall;
+            // The sort overtakes the quadratic loop from a few dozen components
+            fstdistfunc_ = dim >= 32 ? KendallMergeSort<float> : Kendall;
+        #if defined(HNSW_RUNTIME_DISPATCH)
+            // and the vectorized one from several hundreds
+            if (dim < 768 && cpu_supports_avx2() && cpu_supports_popcnt())
+                fstdistfunc_ = KendallAVX2;
+        #endif
             dim_ = dim;
             data_size_ = dim * sizeof(float);
         }
@@ -58,4 +345,58 @@ namespace hnswlib {
 
         ~KendallSpace() override = default;
     };
+
+    // Ranks of `TRANK` can number `dim` components
+    template<typename TRANK>
+    static inline bool ranks_fit(size_t dim) {
+        return dim <= static_cast<size_t>(std::numeric_limits<TRANK>::max()) + 1;
+    }
+
+    /**
+     * Kendall distances on the ranks of the components (see `encode_rank_vector`): uint8_t ranks
+     * up to 256 components, uint16_t up to 65536, 4 and 2 times smaller than float32.
+     **/
+    template<typename TRANK>
+    class KendallRankSpace : public SpaceInterface<float> {
+
+        DISTFUNC<float> fstdistfunc_;
+        size_t dim_;
+    public:
+        explicit KendallRankSpace(size_t dim) : dim_(dim) {
+            if (!ranks_fit<TRANK>(dim))
+                throw std::runtime_error("Too many components for " + std::to_string(8 * sizeof(TRANK)) + " bits ranks: " + std::to_string(dim));
+            fstdistfunc_ = dim >= 32 ? KendallMergeSort<TRANK> : KendallRanks<TRANK>;
+        #if defined(HNSW_RUNTIME_DISPATCH)
+            if (dim < kendall_ranks_avx2_dim && cpu_supports_avx2() && cpu_supports_popcnt())
+                fstdistfunc_ = KendallRanksAVX2<TRANK>;
+        #endif
+        }
+
+        // More pairs per step than the float kernel push the sort back to about 1500 components
+        static const size_t kendall_ranks_avx2_dim = 1536;
+
+        size_t get_data_size() override {
+            return dim_ * sizeof(TRANK);
+        }
+
+        DISTFUNC<float> get_dist_func() override {
+            return fstdistfunc_;
+        }
+
+        DISTFUNC<float> get_search_dist_func() const override {
+            return fstdistfunc_;
+        }
+
+        void *get_dist_func_param() override {
+            return &dim_;
+        }
+
+        const void *prepare_query(const float *query, std::vector<char> &buffer) const override {
+            buffer.resize(dim_ * sizeof(TRANK));
+            encode_rank_vector(query, reinterpret_cast<TRANK *>(buffer.data()), &dim_);
+            return buffer.data();
+        }
+
+        ~KendallRankSpace() override = default;
+    };
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "encoding.h"
+#include "fixed_dim.h"
 #include "hnswlib.h"
 
 namespace hnswlib {
@@ -48,18 +49,30 @@ namespace hnswlib {
         return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
     }
 
+    // 8 components or more: the last partial step is loaded with zeros past the end, within the same call
     template<typename TARG1, typename TARG2>
     static float
-    L2SqrSIMD8ExtResiduals(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    L2SqrSIMD8ExtMasked(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto pVect2 = static_cast<const TARG2*>(pVect2v);
         const auto qty = *static_cast<const size_t*>(qty_ptr);
         const auto qty8 = qty >> 3 << 3;
-        const auto res = L2SqrSIMD8Ext<TARG1, TARG2>(pVect1v, pVect2v, &qty8);
-        const auto pVect1 = static_cast<const TARG1*>(pVect1v) + qty8;
-        const auto pVect2 = static_cast<const TARG2*>(pVect2v) + qty8;
+        auto sum = _mm256_set1_ps(0);
 
-        const auto qty_left = qty - qty8;
-        const auto res_tail = L2Sqr<TARG1, TARG2>(pVect1, pVect2, &qty_left);
-        return (res + res_tail);
+        for (size_t i = 0; i < qty8; i += 8) {
+            const auto diff = load_component_avx(pVect1 + i) - load_component_avx(pVect2 + i);
+            sum += diff * diff;
+        }
+
+        float PORTABLE_ALIGN32 TmpRes[8];
+        _mm256_store_ps(TmpRes, sum);
+        auto res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+        // Summed apart so that a single leftover component adds exactly as a scalar tail would
+        if (qty8 < qty) {
+            const auto diff = load_component_avx(pVect1 + qty8, qty - qty8) - load_component_avx(pVect2 + qty8, qty - qty8);
+            res += reduce_add_avx(diff * diff);
+        }
+        return res;
     }
 #endif
 
@@ -103,11 +116,322 @@ namespace hnswlib {
     }
 #endif
 
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+
+    // Two fused multiply-add chains over 16 components per step, the tail loaded under a mask, 8 components or more
+    template<typename TARG1, typename TARG2>
+    HNSW_TARGET("avx2,fma")
+    static float
+    L2SqrAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+        const auto qty = *static_cast<const size_t*>(qty_ptr);
+        const auto qty16 = qty >> 4 << 4;
+        auto sum0 = _mm256_setzero_ps();
+        auto sum1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i < qty16; i += 16) {
+            const auto diff0 = _mm256_sub_ps(load_component_avx2(pVect1 + i), load_component_avx2(pVect2 + i));
+            const auto diff1 = _mm256_sub_ps(load_component_avx2(pVect1 + i + 8), load_component_avx2(pVect2 + i + 8));
+            sum0 = _mm256_fmadd_ps(diff0, diff0, sum0);
+            sum1 = _mm256_fmadd_ps(diff1, diff1, sum1);
+        }
+        if (qty - i >= 8) {
+            const auto diff = _mm256_sub_ps(load_component_avx2(pVect1 + i), load_component_avx2(pVect2 + i));
+            sum0 = _mm256_fmadd_ps(diff, diff, sum0);
+            i += 8;
+        }
+        auto res = reduce_add_avx(_mm256_add_ps(sum0, sum1));
+        if (i < qty) {
+            const auto diff = _mm256_sub_ps(load_component_avx(pVect1 + i, qty - i), load_component_avx(pVect2 + i, qty - i));
+            res += reduce_add_avx(_mm256_mul_ps(diff, diff));
+        }
+        return res;
+    }
+
+    // Four vectors per pass against the query loaded once, each summed in the order of L2SqrAVX2
+    template<typename TARG1, typename TARG2>
+    HNSW_TARGET("avx2,fma")
+    static void
+    L2SqrBatchAVX2(const void *pVect1v, const void *const *data, size_t n, const void *qty_ptr, float *out) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto qty = *static_cast<const size_t*>(qty_ptr);
+        const auto qty16 = qty >> 4 << 4;
+        size_t b = 0;
+        for (; b + 4 <= n; b += 4) {
+            const TARG2 *pVect2[4];
+            __m256 sum0[4], sum1[4];
+            HNSW_UNROLL
+            for (size_t k = 0; k < 4; k++) {
+                pVect2[k] = static_cast<const TARG2*>(data[b + k]);
+                sum0[k] = _mm256_setzero_ps();
+                sum1[k] = _mm256_setzero_ps();
+            }
+            size_t i = 0;
+            for (; i < qty16; i += 16) {
+                const auto v0 = load_component_avx2(pVect1 + i);
+                const auto v1 = load_component_avx2(pVect1 + i + 8);
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    const auto diff0 = _mm256_sub_ps(v0, load_component_avx2(pVect2[k] + i));
+                    const auto diff1 = _mm256_sub_ps(v1, load_component_avx2(pVect2[k] + i + 8));
+                    sum0[k] = _mm256_fmadd_ps(diff0, diff0, sum0[k]);
+                    sum1[k] = _mm256_fmadd_ps(diff1, diff1, sum1[k]);
+                }
+            }
+            if (qty - i >= 8) {
+                const auto v0 = load_component_avx2(pVect1 + i);
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    const auto diff = _mm256_sub_ps(v0, load_component_avx2(pVect2[k] + i));
+                    sum0[k] = _mm256_fmadd_ps(diff, diff, sum0[k]);
+                }
+                i += 8;
+            }
+            HNSW_UNROLL
+            for (size_t k = 0; k < 4; k++) {
+                out[b + k] = reduce_add_avx(_mm256_add_ps(sum0[k], sum1[k]));
+            }
+            if (i < qty) {
+                const auto v0 = load_component_avx(pVect1 + i, qty - i);
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    const auto diff = _mm256_sub_ps(v0, load_component_avx(pVect2[k] + i, qty - i));
+                    out[b + k] += reduce_add_avx(_mm256_mul_ps(diff, diff));
+                }
+            }
+        }
+        for (; b < n; b++) {
+            out[b] = L2SqrAVX2<TARG1, TARG2>(pVect1v, data[b], qty_ptr);
+        }
+    }
+
+    // Fixed size vectors: four fused multiply-add chains over 32 components per step, fully unrolled
+    template<typename TARG1, typename TARG2>
+    struct L2SqrAVX2Fixed {
+        template<size_t DIM>
+        HNSW_TARGET("avx2,fma")
+        static float distance(const void *pVect1v, const void *pVect2v, const void *) {
+            static_assert(DIM % 32 == 0, "Fixed dimensions are multiples of 32");
+            const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+            const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+            auto sum0 = _mm256_setzero_ps();
+            auto sum1 = _mm256_setzero_ps();
+            auto sum2 = _mm256_setzero_ps();
+            auto sum3 = _mm256_setzero_ps();
+            HNSW_UNROLL
+            for (size_t i = 0; i < DIM; i += 32) {
+                const auto diff0 = _mm256_sub_ps(load_component_avx2(pVect1 + i), load_component_avx2(pVect2 + i));
+                const auto diff1 = _mm256_sub_ps(load_component_avx2(pVect1 + i + 8), load_component_avx2(pVect2 + i + 8));
+                const auto diff2 = _mm256_sub_ps(load_component_avx2(pVect1 + i + 16), load_component_avx2(pVect2 + i + 16));
+                const auto diff3 = _mm256_sub_ps(load_component_avx2(pVect1 + i + 24), load_component_avx2(pVect2 + i + 24));
+                sum0 = _mm256_fmadd_ps(diff0, diff0, sum0);
+                sum1 = _mm256_fmadd_ps(diff1, diff1, sum1);
+                sum2 = _mm256_fmadd_ps(diff2, diff2, sum2);
+                sum3 = _mm256_fmadd_ps(diff3, diff3, sum3);
+            }
+            return reduce_add_avx(_mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3)));
+        }
+
+        // Two vectors per pass against the query loaded once, each summed in the order of `distance`
+        template<size_t DIM>
+        HNSW_TARGET("avx2,fma")
+        static void batch(const void *pVect1v, const void *const *data, size_t n, const void *, float *out) {
+            const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+            size_t b = 0;
+            for (; b + 2 <= n; b += 2) {
+                const TARG2 *pVect2[2];
+                __m256 sum[2][4];
+                HNSW_UNROLL
+                for (size_t k = 0; k < 2; k++) {
+                    pVect2[k] = static_cast<const TARG2*>(data[b + k]);
+                    for (size_t c = 0; c < 4; c++) sum[k][c] = _mm256_setzero_ps();
+                }
+                HNSW_UNROLL
+                for (size_t i = 0; i < DIM; i += 32) {
+                    HNSW_UNROLL
+                    for (size_t c = 0; c < 4; c++) {
+                        const auto v = load_component_avx2(pVect1 + i + 8 * c);
+                        HNSW_UNROLL
+                        for (size_t k = 0; k < 2; k++) {
+                            const auto diff = _mm256_sub_ps(v, load_component_avx2(pVect2[k] + i + 8 * c));
+                            sum[k][c] = _mm256_fmadd_ps(diff, diff, sum[k][c]);
+                        }
+                    }
+                }
+                HNSW_UNROLL
+                for (size_t k = 0; k < 2; k++) {
+                    out[b + k] = reduce_add_avx(_mm256_add_ps(_mm256_add_ps(sum[k][0], sum[k][1]), _mm256_add_ps(sum[k][2], sum[k][3])));
+                }
+            }
+            if (b < n) {
+                out[b] = distance<DIM>(pVect1v, data[b], nullptr);
+            }
+        }
+    };
+
+    HNSW_AVX512_BEGIN
+    // Two 512 bits chains over 32 components per step, the tail loaded under a mask, 8 components or more
+    template<typename TARG1, typename TARG2>
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static float
+    L2SqrAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+        const auto qty = *static_cast<const size_t*>(qty_ptr);
+        const auto qty32 = qty >> 5 << 5;
+        const __mmask16 all = 0xFFFF;
+        auto sum0 = _mm512_setzero_ps();
+        auto sum1 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i < qty32; i += 32) {
+            const auto diff0 = _mm512_sub_ps(load_component_avx512(pVect1 + i, all), load_component_avx512(pVect2 + i, all));
+            const auto diff1 = _mm512_sub_ps(load_component_avx512(pVect1 + i + 16, all), load_component_avx512(pVect2 + i + 16, all));
+            sum0 = _mm512_fmadd_ps(diff0, diff0, sum0);
+            sum1 = _mm512_fmadd_ps(diff1, diff1, sum1);
+        }
+        for (; i < qty; i += 16) {
+            const auto mask = get_tail_mask_avx512(qty - i);
+            const auto diff = _mm512_sub_ps(load_component_avx512(pVect1 + i, mask), load_component_avx512(pVect2 + i, mask));
+            sum0 = _mm512_fmadd_ps(diff, diff, sum0);
+        }
+        return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+    }
+
+    // Four vectors per pass against the query loaded once, each summed in the order of L2SqrAVX512
+    template<typename TARG1, typename TARG2>
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static void
+    L2SqrBatchAVX512(const void *pVect1v, const void *const *data, size_t n, const void *qty_ptr, float *out) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto qty = *static_cast<const size_t*>(qty_ptr);
+        const auto qty32 = qty >> 5 << 5;
+        const __mmask16 all = 0xFFFF;
+        size_t b = 0;
+        for (; b + 4 <= n; b += 4) {
+            const TARG2 *pVect2[4];
+            __m512 sum0[4], sum1[4];
+            HNSW_UNROLL
+            for (size_t k = 0; k < 4; k++) {
+                pVect2[k] = static_cast<const TARG2*>(data[b + k]);
+                sum0[k] = _mm512_setzero_ps();
+                sum1[k] = _mm512_setzero_ps();
+            }
+            size_t i = 0;
+            for (; i < qty32; i += 32) {
+                const auto v0 = load_component_avx512(pVect1 + i, all);
+                const auto v1 = load_component_avx512(pVect1 + i + 16, all);
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    const auto diff0 = _mm512_sub_ps(v0, load_component_avx512(pVect2[k] + i, all));
+                    const auto diff1 = _mm512_sub_ps(v1, load_component_avx512(pVect2[k] + i + 16, all));
+                    sum0[k] = _mm512_fmadd_ps(diff0, diff0, sum0[k]);
+                    sum1[k] = _mm512_fmadd_ps(diff1, diff1, sum1[k]);
+                }
+            }
+            for (; i < qty; i += 16) {
+                const auto mask = get_tail_mask_avx512(qty - i);
+                const auto v0 = load_component_avx512(pVect1 + i, mask);
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    const auto diff = _mm512_sub_ps(v0, load_component_avx512(pVect2[k] + i, mask));
+                    sum0[k] = _mm512_fmadd_ps(diff, diff, sum0[k]);
+                }
+            }
+            HNSW_UNROLL
+            for (size_t k = 0; k < 4; k++) {
+                out[b + k] = _mm512_reduce_add_ps(_mm512_add_ps(sum0[k], sum1[k]));
+            }
+        }
+        for (; b < n; b++) {
+            out[b] = L2SqrAVX512<TARG1, TARG2>(pVect1v, data[b], qty_ptr);
+        }
+    }
+
+    // Fixed size vectors: four 512 bits chains over 64 components per step, fully unrolled
+    template<typename TARG1, typename TARG2>
+    struct L2SqrAVX512Fixed {
+        template<size_t DIM>
+        HNSW_TARGET(HNSW_AVX512_ISA)
+        static float distance(const void *pVect1v, const void *pVect2v, const void *) {
+            static_assert(DIM % 32 == 0, "Fixed dimensions are multiples of 32");
+            const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+            const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+            const size_t dim64 = DIM >> 6 << 6;
+            const __mmask16 all = 0xFFFF;
+            auto sum0 = _mm512_setzero_ps();
+            auto sum1 = _mm512_setzero_ps();
+            auto sum2 = _mm512_setzero_ps();
+            auto sum3 = _mm512_setzero_ps();
+            HNSW_UNROLL
+            for (size_t i = 0; i < dim64; i += 64) {
+                const auto diff0 = _mm512_sub_ps(load_component_avx512(pVect1 + i, all), load_component_avx512(pVect2 + i, all));
+                const auto diff1 = _mm512_sub_ps(load_component_avx512(pVect1 + i + 16, all), load_component_avx512(pVect2 + i + 16, all));
+                const auto diff2 = _mm512_sub_ps(load_component_avx512(pVect1 + i + 32, all), load_component_avx512(pVect2 + i + 32, all));
+                const auto diff3 = _mm512_sub_ps(load_component_avx512(pVect1 + i + 48, all), load_component_avx512(pVect2 + i + 48, all));
+                sum0 = _mm512_fmadd_ps(diff0, diff0, sum0);
+                sum1 = _mm512_fmadd_ps(diff1, diff1, sum1);
+                sum2 = _mm512_fmadd_ps(diff2, diff2, sum2);
+                sum3 = _mm512_fmadd_ps(diff3, diff3, sum3);
+            }
+            if (dim64 < DIM) {
+                const auto diff0 = _mm512_sub_ps(load_component_avx512(pVect1 + dim64, all), load_component_avx512(pVect2 + dim64, all));
+                const auto diff1 = _mm512_sub_ps(load_component_avx512(pVect1 + dim64 + 16, all), load_component_avx512(pVect2 + dim64 + 16, all));
+                sum0 = _mm512_fmadd_ps(diff0, diff0, sum0);
+                sum1 = _mm512_fmadd_ps(diff1, diff1, sum1);
+            }
+            return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(sum0, sum1), _mm512_add_ps(sum2, sum3)));
+        }
+
+        // Four vectors per pass against the query loaded once, each summed in the order of `distance`
+        template<size_t DIM>
+        HNSW_TARGET(HNSW_AVX512_ISA)
+        static void batch(const void *pVect1v, const void *const *data, size_t n, const void *, float *out) {
+            const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+            const size_t dim64 = DIM >> 6 << 6;
+            const __mmask16 all = 0xFFFF;
+            size_t b = 0;
+            for (; b + 4 <= n; b += 4) {
+                const TARG2 *pVect2[4];
+                __m512 sum[4][4];
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    pVect2[k] = static_cast<const TARG2*>(data[b + k]);
+                    for (size_t c = 0; c < 4; c++) sum[k][c] = _mm512_setzero_ps();
+                }
+                HNSW_UNROLL
+                for (size_t i = 0; i < DIM; i += 64) {
+                    // The last 32 components of dimensions that aren't multiples of 64 go to the first two chains
+                    const size_t nb_chains = i < dim64 ? 4 : 2;
+                    HNSW_UNROLL
+                    for (size_t c = 0; c < nb_chains; c++) {
+                        const auto v = load_component_avx512(pVect1 + i + 16 * c, all);
+                        HNSW_UNROLL
+                        for (size_t k = 0; k < 4; k++) {
+                            const auto diff = _mm512_sub_ps(v, load_component_avx512(pVect2[k] + i + 16 * c, all));
+                            sum[k][c] = _mm512_fmadd_ps(diff, diff, sum[k][c]);
+                        }
+                    }
+                }
+                HNSW_UNROLL
+                for (size_t k = 0; k < 4; k++) {
+                    out[b + k] = _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(sum[k][0], sum[k][1]), _mm512_add_ps(sum[k][2], sum[k][3])));
+                }
+            }
+            for (; b < n; b++) {
+                out[b] = distance<DIM>(pVect1v, data[b], nullptr);
+            }
+        }
+    };
+    HNSW_AVX512_END
+#endif
+
     template<typename TCOMPR=float>
     class L2Space : public SpaceInterface<float> {
 
         DISTFUNC<float> fstdistfunc_;
         DISTFUNC<float> fstdist_search_func_;
+        DISTBATCHFUNC<float> fstdist_search_batch_func_ = nullptr;
         const size_t data_size_;
         size_t dim_;
     public:
@@ -126,14 +450,32 @@ namespace hnswlib {
                 fstdist_search_func_ = L2SqrSIMD4Ext<float, TCOMPR>;
             }
             else if (dim > 8) {
-                fstdistfunc_ = L2SqrSIMD8ExtResiduals<TCOMPR, TCOMPR>;
-                fstdist_search_func_ = L2SqrSIMD8ExtResiduals<float, TCOMPR>;
+                fstdistfunc_ = L2SqrSIMD8ExtMasked<TCOMPR, TCOMPR>;
+                fstdist_search_func_ = L2SqrSIMD8ExtMasked<float, TCOMPR>;
             }
             else if (dim > 4) {
                 fstdistfunc_ = L2SqrSIMD4ExtResiduals<TCOMPR, TCOMPR>;
                 fstdist_search_func_ = L2SqrSIMD4ExtResiduals<float, TCOMPR>;
             }
         #endif
+        #if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+            if (dim >= 8 && cpu_supports_avx2_fma()) {
+                fstdistfunc_ = L2SqrAVX2<TCOMPR, TCOMPR>;
+                fstdist_search_func_ = L2SqrAVX2<float, TCOMPR>;
+                fstdist_search_batch_func_ = L2SqrBatchAVX2<float, TCOMPR>;
+                use_fixed_dim_func<L2SqrAVX2Fixed<TCOMPR, TCOMPR>>(dim, fstdistfunc_);
+                if (use_fixed_dim_func<L2SqrAVX2Fixed<float, TCOMPR>>(dim, fstdist_search_func_))
+                    fstdist_search_batch_func_ = get_fixed_dim_batch_func<L2SqrAVX2Fixed<float, TCOMPR>>(dim);
+            }
+            if (dim >= 16 && cpu_supports_avx512()) {
+                fstdistfunc_ = L2SqrAVX512<TCOMPR, TCOMPR>;
+                fstdist_search_func_ = L2SqrAVX512<float, TCOMPR>;
+                fstdist_search_batch_func_ = L2SqrBatchAVX512<float, TCOMPR>;
+                use_fixed_dim_func<L2SqrAVX512Fixed<TCOMPR, TCOMPR>>(dim, fstdistfunc_);
+                if (use_fixed_dim_func<L2SqrAVX512Fixed<float, TCOMPR>>(dim, fstdist_search_func_))
+                    fstdist_search_batch_func_ = get_fixed_dim_batch_func<L2SqrAVX512Fixed<float, TCOMPR>>(dim);
+            }
+        #endif
         }
 
         size_t get_data_size() override {
@@ -148,6 +490,10 @@ namespace hnswlib {
             return fstdist_search_func_;
         }
 
+        DISTBATCHFUNC<float> get_search_dist_batch_func() const override {
+            return fstdist_search_batch_func_;
+        }
+
         void *get_dist_func_param() override {
             return &dim_;
         }
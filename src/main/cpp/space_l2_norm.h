@@ -0,0 +1,129 @@
+#pragma once
+#include "hnswlib.h"
+#include "space_ip.h"
+
+namespace hnswlib {
+
+    /**
+     * Euclidean distances from inner products, |a - b|^2 = |a|^2 + |b|^2 - 2 a.b, with the squared
+     * norm of each vector stored after its components. `dim` comes first so that encoders and
+     * inner product kernels read these params as the dimension.
+     **/
+    struct NormParams {
+        size_t dim;
+        DISTFUNC<float> ip;
+        DISTFUNC<float> ip_search;
+        DISTBATCHFUNC<float> ip_search_batch;
+    };
+
+    static inline float load_norm(const void *vector, size_t offset) {
+        float norm;
+        memcpy(&norm, static_cast<const char *>(vector) + offset, sizeof(float));
+        return norm;
+    }
+
+    // Inner product kernels return 1 - a.b, rounding can take close vectors slightly below 0
+    static inline float l2_from_inner_product(float norm1, float norm2, float ip_distance) {
+        return std::max(0.f, norm1 + norm2 - 2 * (1.0f - ip_distance));
+    }
+
+    template<typename TCOMPR>
+    static float
+    L2SqrFromNorms(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+        const auto params = static_cast<const NormParams*>(param_ptr);
+        const auto offset = params->dim * sizeof(TCOMPR);
+        return l2_from_inner_product(load_norm(pVect1v, offset), load_norm(pVect2v, offset),
+                                     params->ip(pVect1v, pVect2v, param_ptr));
+    }
+
+    // From a query prepared by `L2NormSpace::prepare_query`
+    template<typename TCOMPR>
+    static float
+    L2SqrFromNormsSearch(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+        const auto params = static_cast<const NormParams*>(param_ptr);
+        return l2_from_inner_product(load_norm(pVect1v, params->dim * sizeof(float)),
+                                     load_norm(pVect2v, params->dim * sizeof(TCOMPR)),
+                                     params->ip_search(pVect1v, pVect2v, param_ptr));
+    }
+
+    template<typename TCOMPR>
+    static void
+    L2SqrFromNormsBatch(const void *pVect1v, const void *const *data, size_t n, const void *param_ptr, float *out) {
+        const auto params = static_cast<const NormParams*>(param_ptr);
+        params->ip_search_batch(pVect1v, data, n, param_ptr, out);
+        const auto query_norm = load_norm(pVect1v, params->dim * sizeof(float));
+        for (size_t i = 0; i < n; i++) {
+            out[i] = l2_from_inner_product(query_norm, load_norm(data[i], params->dim * sizeof(TCOMPR)), out[i]);
+        }
+    }
+
+    /**
+     * Euclidean space running the inner product kernels of `InnerProductSpace<TCOMPR>`: a multiply-add
+     * per component instead of a subtraction and a multiply-add, plus two norms per distance.
+     * Items are the encoded components followed by their squared norm, see `complete_item`.
+     **/
+    template<typename TCOMPR=float>
+    class L2NormSpace : public SpaceInterface<float> {
+
+        InnerProductSpace<TCOMPR> ip_space_;
+        NormParams params_;
+        DISTBATCHFUNC<float> fstdist_search_batch_func_ = nullptr;
+    public:
+        explicit L2NormSpace(size_t dim) : ip_space_(dim) {
+            params_.dim = dim;
+            params_.ip = ip_space_.get_dist_func();
+            params_.ip_search = ip_space_.get_search_dist_func();
+            params_.ip_search_batch = ip_space_.get_search_dist_batch_func();
+            if (params_.ip_search_batch != nullptr)
+                fstdist_search_batch_func_ = L2SqrFromNormsBatch<TCOMPR>;
+        }
+
+        size_t get_data_size() override {
+            return params_.dim * sizeof(TCOMPR) + sizeof(float);
+        }
+
+        DISTFUNC<float> get_dist_func() override {
+            return L2SqrFromNorms<TCOMPR>;
+        }
+
+        DISTFUNC<float> get_search_dist_func() const override {
+            return L2SqrFromNormsSearch<TCOMPR>;
+        }
+
+        DISTBATCHFUNC<float> get_search_dist_batch_func() const override {
+            return fstdist_search_batch_func_;
+        }
+
+        void *get_dist_func_param() override {
+            return &params_;
+        }
+
+        // The query followed by its squared norm
+        const void *prepare_query(const float *query, std::vector<char> &buffer) const override {
+            buffer.resize((params_.dim + 1) * sizeof(float));
+            const auto prepared = reinterpret_cast<float *>(buffer.data());
+            memcpy(prepared, query, params_.dim * sizeof(float));
+            prepared[params_.dim] = squared_norm(query);
+            return prepared;
+        }
+
+        // Norm of the components as encoded, so that distances to the item itself stay 0
+        void complete_item(void *data) const override {
+            const auto norm = squared_norm(static_cast<const TCOMPR *>(data));
+            memcpy(static_cast<char *>(data) + params_.dim * sizeof(TCOMPR), &norm, sizeof(float));
+        }
+
+        ~L2NormSpace() override = default;
+
+    private:
+        template<typename T>
+        float squared_norm(const T *vector) const {
+            float norm = 0;
+            for (size_t i = 0; i < params_.dim; i++) {
+                const auto x = load_component(vector + i);
+                norm += x * x;
+            }
+            return norm;
+        }
+    };
+}
@@ -60,21 +60,34 @@ namespace hnswlib {
         return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
     }
 
+    // 8 components or more: the last partial step is loaded with zeros past the end, within the same call
     template<typename TARG1, typename TARG2>
     static float
-    L2SqrSIMD8ExtResiduals_trained(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+    L2SqrSIMD8ExtMasked_trained(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto pVect2 = static_cast<const TARG2*>(pVect2v);
         const auto params = static_cast<const TrainParams*>(diff_ptr);
         const auto qty = params->dim;
         const auto qty8 = qty >> 3 << 3;
-        TrainParams params8(params->min, params->diff, qty8, true);
-        const auto res = L2SqrSIMD8Ext_trained<TARG1, TARG2>(pVect1v, pVect2v, &params8);
-        const auto pVect1 = static_cast<const TARG1*>(pVect1v) + qty8;
-        const auto pVect2 = static_cast<const TARG2*>(pVect2v) + qty8;
+        const auto pMin = params->min;
+        const auto pDiff = params->diff;
+        auto sum = _mm256_set1_ps(0);
 
-        const auto qty_left = qty - qty8;
-        TrainParams params_left(params->min + qty8, params->diff + qty8, qty_left, true);
-        const auto res_tail = L2Sqr_trained<TARG1, TARG2>(pVect1, pVect2, &params_left);
-        return (res + res_tail);
+        for (size_t i = 0; i < qty8; i += 8) {
+            const auto t = load_component_avx(pVect1 + i, pMin + i, pDiff + i) - load_component_avx(pVect2 + i, pMin + i, pDiff + i);
+            sum += t * t;
+        }
+        if (qty8 < qty) {
+            const auto qty_left = qty - qty8;
+            const auto v1 = load_component_avx(pVect1 + qty8, pMin + qty8, pDiff + qty8, qty_left);
+            const auto v2 = load_component_avx(pVect2 + qty8, pMin + qty8, pDiff + qty8, qty_left);
+            const auto t = v1 - v2;
+            sum += t * t;
+        }
+
+        float PORTABLE_ALIGN32 TmpRes[8];
+        _mm256_store_ps(TmpRes, sum);
+        return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
     }
 #endif
 
@@ -127,6 +140,62 @@ namespace hnswlib {
     }
 #endif
 
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+
+    // 8 components per step accumulated with fused multiply-adds, the tail loaded under a mask, 8 components or more
+    template<typename TARG1, typename TARG2>
+    HNSW_TARGET("avx2,fma")
+    static float
+    L2SqrAVX2_trained(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+        const auto params = static_cast<const TrainParams*>(diff_ptr);
+        const auto qty = params->dim;
+        const auto qty8 = qty >> 3 << 3;
+        const auto pMin = params->min;
+        const auto pDiff = params->diff;
+        auto sum = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i < qty8; i += 8) {
+            const auto v1 = load_component_avx2(pVect1 + i, pMin + i, pDiff + i);
+            const auto v2 = load_component_avx2(pVect2 + i, pMin + i, pDiff + i);
+            const auto t = _mm256_sub_ps(v1, v2);
+            sum = _mm256_fmadd_ps(t, t, sum);
+        }
+        if (i < qty) {
+            const auto v1 = load_component_avx(pVect1 + i, pMin + i, pDiff + i, qty - i);
+            const auto v2 = load_component_avx(pVect2 + i, pMin + i, pDiff + i, qty - i);
+            const auto t = _mm256_sub_ps(v1, v2);
+            sum = _mm256_fmadd_ps(t, t, sum);
+        }
+        return reduce_add_avx(sum);
+    }
+
+    HNSW_AVX512_BEGIN
+    // 16 components per step, the tail loaded under a mask, 8 components or more
+    template<typename TARG1, typename TARG2>
+    HNSW_TARGET(HNSW_AVX512_ISA)
+    static float
+    L2SqrAVX512_trained(const void *pVect1v, const void *pVect2v, const void *diff_ptr) {
+        const auto pVect1 = static_cast<const TARG1*>(pVect1v);
+        const auto pVect2 = static_cast<const TARG2*>(pVect2v);
+        const auto params = static_cast<const TrainParams*>(diff_ptr);
+        const auto qty = params->dim;
+        const auto pMin = params->min;
+        const auto pDiff = params->diff;
+        auto sum = _mm512_setzero_ps();
+        for (size_t i = 0; i < qty; i += 16) {
+            const auto mask = get_tail_mask_avx512(qty - i);
+            const auto v1 = load_component_avx512(pVect1 + i, pMin + i, pDiff + i, mask);
+            const auto v2 = load_component_avx512(pVect2 + i, pMin + i, pDiff + i, mask);
+            const auto t = _mm512_sub_ps(v1, v2);
+            sum = _mm512_fmadd_ps(t, t, sum);
+        }
+        return _mm512_reduce_add_ps(sum);
+    }
+    HNSW_AVX512_END
+#endif
+
     template<typename TCOMPR=float>
     class L2TrainedSpace : public SpaceInterface<float> {
 
@@ -153,14 +222,24 @@ namespace hnswlib {
                 fstdist_search_func_ = L2SqrSIMD4Ext_trained<float, TCOMPR>;
             }
             else if (dim > 8) {
-                fstdistfunc_ = L2SqrSIMD8ExtResiduals_trained<TCOMPR, TCOMPR>;
-                fstdist_search_func_ = L2SqrSIMD8ExtResiduals_trained<float, TCOMPR>;
+                fstdistfunc_ = L2SqrSIMD8ExtMasked_trained<TCOMPR, TCOMPR>;
+                fstdist_search_func_ = L2SqrSIMD8ExtMasked_trained<float, TCOMPR>;
             }
             else if (dim > 4) {
                 fstdistfunc_ = L2SqrSIMD4ExtResiduals_trained<TCOMPR, TCOMPR>;
                 fstdist_search_func_ = L2SqrSIMD4ExtResiduals_trained<float, TCOMPR>;
             }
         #endif
+        #if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+            if (dim >= 8 && cpu_supports_avx2_fma()) {
+                fstdistfunc_ = L2SqrAVX2_trained<TCOMPR, TCOMPR>;
+                fstdist_search_func_ = L2SqrAVX2_trained<float, TCOMPR>;
+            }
+            if (dim >= 16 && cpu_supports_avx512()) {
+                fstdistfunc_ = L2SqrAVX512_trained<TCOMPR, TCOMPR>;
+                fstdist_search_func_ = L2SqrAVX512_trained<float, TCOMPR>;
+            }
+        #endif
         }
 
         size_t get_data_size() override {
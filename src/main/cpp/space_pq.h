@@ -0,0 +1,350 @@
+#pragma once
+#include "hnswlib.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace hnswlib {
+
+    /**
+     * Product quantization codebooks: the space is split into `m` contiguous sub-spaces (of
+     * dim / m components, the first ones one component shorter when it doesn't divide) each with
+     * its own codebook of 256 centroids. A vector is stored as the m bytes of its nearest centroids.
+     **/
+    struct PQParams {
+        static const size_t ksub = 256;
+
+        size_t dim;
+        size_t m;
+        // Distance = bias + sum of per sub-space terms: 0 + squared L2 or 1 - inner product
+        float bias;
+        bool inner_product;
+        // m + 1 boundaries of the sub-spaces
+        std::vector<size_t> offsets;
+        std::vector<size_t> lengths;
+        // Sub-space j holds its ksub centroids of lengths[j] components from ksub * offsets[j]
+        std::vector<float> centroids;
+        // Term between every pair of centroids of each sub-space, m * ksub * ksub
+        std::vector<float> sdc_table;
+        // Kernels matching the length of each sub-space
+        std::vector<DISTFUNC<float>> l2_funcs;
+        std::vector<DISTFUNC<float>> ip_funcs;
+
+        PQParams(size_t dim, size_t m, bool inner_product)
+            : dim(dim), m(m), bias(inner_product ? 1.f : 0.f), inner_product(inner_product) {
+            if (m == 0 || m > dim)
+                throw std::runtime_error("Number of PQ sub-spaces must be in [1, dim]");
+            for (size_t j = 0; j <= m; j++) {
+                offsets.push_back(j * dim / m);
+            }
+            for (size_t j = 0; j < m; j++) {
+                lengths.push_back(offsets[j + 1] - offsets[j]);
+                l2_funcs.push_back(L2Space<float>(lengths[j]).get_dist_func());
+                ip_funcs.push_back(InnerProductSpace<float>(lengths[j]).get_dist_func());
+            }
+        }
+
+        inline bool isTrained() const {
+            return !centroids.empty();
+        }
+
+        inline const float *centroid(size_t j, size_t k) const {
+            return centroids.data() + ksub * offsets[j] + k * lengths[j];
+        }
+
+        // Contribution of sub-space j to the distance between `x` and `y`
+        inline float term(size_t j, const float *x, const float *y) const {
+            // The inner product kernel returns 1 - <x, y>
+            return inner_product ? ip_funcs[j](x, y, &lengths[j]) - 1.f : l2_funcs[j](x, y, &lengths[j]);
+        }
+    };
+
+    // Symmetric distance between two codes, used while building the graph
+    static float
+    PQ_sdc(const void *pCode1v, const void *pCode2v, const void *params_ptr) {
+        auto pCode1 = static_cast<const uint8_t *>(pCode1v);
+        auto pCode2 = static_cast<const uint8_t *>(pCode2v);
+        const auto params = static_cast<const PQParams *>(params_ptr);
+        const auto ksub = PQParams::ksub;
+        auto table = params->sdc_table.data();
+        float res = params->bias;
+        for (size_t j = 0; j < params->m; j++) {
+            res += table[pCode1[j] * ksub + pCode2[j]];
+            table += ksub * ksub;
+        }
+        return res;
+    }
+
+    // Asymmetric distance from a query table (see PQSpace::prepare_query) to a code, m lookups
+    static float
+    PQ_adc(const void *pTablev, const void *pCodev, const void *params_ptr) {
+        auto table = static_cast<const float *>(pTablev);
+        auto pCode = static_cast<const uint8_t *>(pCodev);
+        const auto params = static_cast<const PQParams *>(params_ptr);
+        const auto ksub = PQParams::ksub;
+        const auto m = params->m;
+        const auto m4 = m >> 2 << 2;
+        // Independent accumulators so that lookups don't wait for each other
+        float res0 = 0, res1 = 0, res2 = 0, res3 = 0;
+        size_t j = 0;
+        for (; j < m4; j += 4) {
+            res0 += table[pCode[j]];
+            res1 += table[ksub + pCode[j + 1]];
+            res2 += table[2 * ksub + pCode[j + 2]];
+            res3 += table[3 * ksub + pCode[j + 3]];
+            table += 4 * ksub;
+        }
+        for (; j < m; j++) {
+            res0 += table[pCode[j]];
+            table += ksub;
+        }
+        return params->bias + (res0 + res1) + (res2 + res3);
+    }
+
+    // Encoding F32 -> PQ codes, nearest centroid of each sub-space
+    static inline void encode_pq_vector(const float *src, uint8_t *dst, const PQParams *params) {
+        if (!params->isTrained())
+            throw std::runtime_error("PQ codebooks must be trained before encoding");
+        for (size_t j = 0; j < params->m; j++) {
+            const auto sub_vector = src + params->offsets[j];
+            float best_dist = std::numeric_limits<float>::max();
+            for (size_t k = 0; k < PQParams::ksub; k++) {
+                const auto dist = params->l2_funcs[j](sub_vector, params->centroid(j, k), &params->lengths[j]);
+                if (dist < best_dist) {
+                    best_dist = dist;
+                    dst[j] = (uint8_t) k;
+                }
+            }
+        }
+    }
+
+    // Decoding PQ codes -> F32, concatenation of the centroids
+    static inline void decode_pq_vector(const uint8_t *src, float *dst, const PQParams *params) {
+        for (size_t j = 0; j < params->m; j++) {
+            const auto centroid = params->centroid(j, src[j]);
+            std::copy(centroid, centroid + params->lengths[j], dst + params->offsets[j]);
+        }
+    }
+
+    /**
+     * Lloyd's k-means over `data` (n vectors of `d` components), `centroids` receives k * d floats.
+     * With fewer samples than centroids, samples are used as centroids as is.
+     **/
+    static void kmeans(const std::vector<float> &data, size_t d, size_t k, size_t nb_iterations,
+                       std::default_random_engine &rng, float *centroids) {
+        const auto n = data.size() / d;
+        const auto l2_func = L2Space<float>(d).get_dist_func();
+        std::vector<size_t> permutation(n);
+        std::iota(permutation.begin(), permutation.end(), 0);
+        std::shuffle(permutation.begin(), permutation.end(), rng);
+        for (size_t c = 0; c < k; c++) {
+            std::copy_n(data.data() + permutation[c % n] * d, d, centroids + c * d);
+        }
+        if (n <= k)
+            return;
+
+        std::vector<uint32_t> assignment(n);
+        std::vector<size_t> counts(k);
+        std::uniform_int_distribution<size_t> random_sample(0, n - 1);
+        for (size_t iteration = 0; iteration < nb_iterations; iteration++) {
+            bool changed = false;
+            for (size_t i = 0; i < n; i++) {
+                const auto vector = data.data() + i * d;
+                float best_dist = std::numeric_limits<float>::max();
+                uint32_t best = 0;
+                for (size_t c = 0; c < k; c++) {
+                    const auto dist = l2_func(vector, centroids + c * d, &d);
+                    if (dist < best_dist) {
+                        best_dist = dist;
+                        best = c;
+                    }
+                }
+                changed |= iteration == 0 || assignment[i] != best;
+                assignment[i] = best;
+            }
+            if (!changed)
+                break;
+
+            std::fill(centroids, centroids + k * d, 0.f);
+            std::fill(counts.begin(), counts.end(), 0);
+            for (size_t i = 0; i < n; i++) {
+                const auto vector = data.data() + i * d;
+                const auto centroid = centroids + assignment[i] * d;
+                for (size_t l = 0; l < d; l++) centroid[l] += vector[l];
+                counts[assignment[i]]++;
+            }
+            for (size_t c = 0; c < k; c++) {
+                const auto centroid = centroids + c * d;
+                if (counts[c] == 0) {
+                    // Empty cluster, restarted from a random sample
+                    std::copy_n(data.data() + random_sample(rng) * d, d, centroid);
+                } else {
+                    for (size_t l = 0; l < d; l++) centroid[l] /= counts[c];
+                }
+            }
+        }
+    }
+
+    /**
+     * Product quantization space, m bytes per vector (m = dim / 4 by default, 16x smaller than
+     * float32).
+     *
+     * Training samples passed to `train` are buffered (uniformly subsampled above
+     * `max_training_samples`) and codebooks are fit with k-means by `complete_training`, once
+     * even when several threads encode their first items at the same time.
+     * The graph is built with symmetric code to code distances looked up in precomputed tables,
+     * searches with per-query tables of the distances from the query to every centroid
+     * (`prepare_query`), so each distance is m lookups. The code to code tables hold m x 256 x 256
+     * floats, 256 KiB per sub-space: 48 MiB at dim 768 with the default m, a smaller m bounds them.
+     **/
+    class PQSpace : public SpaceInterface<float> {
+
+        PQParams params_;
+        std::vector<float> samples_;
+        size_t nb_samples_seen_ = 0;
+        std::default_random_engine rng_;
+        std::atomic<bool> fitted_{false};
+        std::mutex fit_lock_;
+
+    public:
+        static const size_t max_training_samples = 32768;
+        static const size_t nb_iterations = 20;
+
+        PQSpace(size_t dim, bool inner_product, size_t m = 0)
+            : params_(dim, m == 0 ? std::max(dim / 4, (size_t) 1) : m, inner_product) {
+        }
+
+        size_t get_data_size() override {
+            return params_.m;
+        }
+
+        DISTFUNC<float> get_dist_func() override {
+            return PQ_sdc;
+        }
+
+        DISTFUNC<float> get_search_dist_func() const override {
+            return PQ_adc;
+        }
+
+        bool needs_initialization() const override {
+            return !params_.isTrained() && samples_.empty();
+        }
+
+        void train(const float *vector) override {
+            if (params_.isTrained())
+                throw std::runtime_error("PQ codebooks are already trained");
+            // Reservoir sampling keeps a uniform subset of everything seen
+            if (nb_samples_seen_ < max_training_samples) {
+                samples_.insert(samples_.end(), vector, vector + params_.dim);
+            } else {
+                const auto i = std::uniform_int_distribution<size_t>(0, nb_samples_seen_)(rng_);
+                if (i < max_training_samples)
+                    std::copy_n(vector, params_.dim, samples_.begin() + i * params_.dim);
+            }
+            nb_samples_seen_++;
+        }
+
+        void complete_training() override {
+            if (fitted_)
+                return;
+            std::lock_guard<std::mutex> lock(fit_lock_);
+            if (!params_.isTrained() && !samples_.empty())
+                fit();
+            if (!params_.isTrained())
+                throw std::runtime_error("PQ codebooks must be trained before encoding");
+            fitted_ = true;
+        }
+
+        void *get_dist_func_param() override {
+            return &params_;
+        }
+
+        const void *prepare_query(const float *query, std::vector<char> &buffer) const override {
+            if (!params_.isTrained())
+                throw std::runtime_error("PQ codebooks must be trained before searching");
+            const auto ksub = PQParams::ksub;
+            buffer.resize(params_.m * ksub * sizeof(float));
+            auto table = reinterpret_cast<float *>(buffer.data());
+            for (size_t j = 0; j < params_.m; j++) {
+                const auto sub_query = query + params_.offsets[j];
+                for (size_t k = 0; k < ksub; k++) {
+                    table[j * ksub + k] = params_.term(j, sub_query, params_.centroid(j, k));
+                }
+            }
+            return buffer.data();
+        }
+
+        bool has_persistent_params() const override {
+            return true;
+        }
+
+        void save_params(std::ostream &output) const override {
+            if (!params_.isTrained())
+                throw std::runtime_error("PQ codebooks must be trained before saving");
+            writeBinaryPOD(output, params_.dim);
+            writeBinaryPOD(output, params_.m);
+            writeBinaryPOD(output, params_.inner_product);
+            output.write((const char *) params_.centroids.data(), params_.centroids.size() * sizeof(float));
+        }
+
+        void load_params(std::istream &input) override {
+            size_t dim, m;
+            bool inner_product;
+            readBinaryPOD(input, dim);
+            readBinaryPOD(input, m);
+            readBinaryPOD(input, inner_product);
+            if (dim != params_.dim || inner_product != params_.inner_product)
+                throw std::runtime_error("PQ codebooks don't match the space of the index");
+            // Assigned in place, algorithms keep a pointer to the params
+            PQParams loaded(dim, m, inner_product);
+            loaded.centroids.resize(PQParams::ksub * dim);
+            input.read((char *) loaded.centroids.data(), loaded.centroids.size() * sizeof(float));
+            if (!input)
+                throw std::runtime_error("Truncated PQ codebooks");
+            params_ = loaded;
+            initTables();
+            samples_.clear();
+            fitted_ = true;
+        }
+
+        ~PQSpace() override = default;
+
+    private:
+        void fit() {
+            const auto ksub = PQParams::ksub;
+            const auto nb_samples = samples_.size() / params_.dim;
+            std::vector<float> centroids(ksub * params_.dim);
+            std::vector<float> sub_samples;
+            for (size_t j = 0; j < params_.m; j++) {
+                const auto length = params_.lengths[j];
+                sub_samples.resize(nb_samples * length);
+                for (size_t i = 0; i < nb_samples; i++) {
+                    const auto sample = samples_.data() + i * params_.dim + params_.offsets[j];
+                    std::copy_n(sample, length, sub_samples.data() + i * length);
+                }
+                kmeans(sub_samples, length, ksub, nb_iterations, rng_, centroids.data() + ksub * params_.offsets[j]);
+            }
+            params_.centroids.swap(centroids);
+            initTables();
+            samples_.clear();
+            samples_.shrink_to_fit();
+        }
+
+        void initTables() {
+            const auto ksub = PQParams::ksub;
+            params_.sdc_table.resize(params_.m * ksub * ksub);
+            auto table = params_.sdc_table.data();
+            for (size_t j = 0; j < params_.m; j++) {
+                for (size_t a = 0; a < ksub; a++) {
+                    for (size_t b = 0; b < ksub; b++) {
+                        *table++ = params_.term(j, params_.centroid(j, a), params_.centroid(j, b));
+                    }
+                }
+            }
+        }
+    };
+}
@@ -80,6 +80,59 @@ public class HnswIndex {
         HnswLib.saveIndex(pointer, path);
     }
 
+    /**
+     * Stores labels on 32 bits in indices created or loaded afterwards, saving 4 bytes per item.
+     * Ids must then fit in an unsigned 32-bit integer.
+     */
+    public void useCompactLabels(boolean compact) {
+        HnswLib.useCompactLabels(pointer, compact);
+    }
+
+    /**
+     * Stores the squared norm of each item after its vector so that Euclidean distances run the
+     * inner product kernels, for Float32, Float16 and BFloat16 indices. Costs 4 bytes per item
+     * and must be set before the index is created or loaded.
+     */
+    public void useNormSlot(boolean use) {
+        HnswLib.useNormSlot(pointer, use);
+    }
+
+    /**
+     * Sets the bits of Binary indices when components are above their mean over the training
+     * vectors instead of above 0. Loading a float32 index then trains the means on its items.
+     * Must be set before the index is created or loaded.
+     */
+    public void useBinaryThresholds(boolean use) {
+        HnswLib.useBinaryThresholds(pointer, use);
+    }
+
+    /**
+     * Sets the number of sub-spaces of PQ indices, the bytes stored per item, dim / 4 by default.
+     * Each sub-space keeps a 256 KiB table of code to code distances (48 MiB at dim 768 with the
+     * default), fewer sub-spaces bound that memory at the cost of accuracy. Must be set before
+     * the index is trained, created or loaded.
+     */
+    public void usePQSubspaces(long m) {
+        HnswLib.usePQSubspaces(pointer, m);
+    }
+
+    /**
+     * Builds InnerProduct indices (Float32, Float16 or BFloat16) in Euclidean space by adding the
+     * coordinate sqrt(maxNorm^2 - |x|^2) to items, which connects the graphs of some unnormalized
+     * data better. Results keep their inner product distances. Items must have a norm of
+     * at most {@code maxNorm}. Must be set before the index is created or loaded, with the same
+     * {@code maxNorm} as when it was built.
+     *
+     * <p>It often costs recall: on synthetic data of 20k items at dim 64, recall@10 dropped from
+     * 1.00 to 0.53 at ef 20 on clustered items of lognormal norms, and from 0.92 to 0.54 at ef 80
+     * on isotropic ones. Compare both at the same ef before enabling it, and otherwise keep a
+     * direct inner product index. For Euclidean data, {@link #useNormSlot} speeds up distances
+     * while returning the same results.
+     */
+    public void useMipsTransform(float maxNorm) {
+        HnswLib.useMipsTransform(pointer, maxNorm);
+    }
+
     public void initNewIndex(long maxElements, long M, long efConstruction, long randomSeed) {
         HnswLib.initNewIndex(pointer, maxElements, M, efConstruction, randomSeed);
     }
@@ -96,6 +149,48 @@ public class HnswIndex {
         HnswLib.setEf(pointer, ef);
     }
 
+    /**
+     * Keeps one read-only copy of the index per NUMA node and routes each search to the copy local
+     * to the calling thread. The index can't be modified afterwards.
+     * @return number of copies serving searches (1 on single socket hosts)
+     */
+    public long enableNumaReplicas() {
+        return HnswLib.enableNumaReplicas(pointer, 0);
+    }
+
+    /**
+     * Compacts the index into an immutable layout once it is fully built: lower memory footprint,
+     * items can't be added afterwards.
+     */
+    public void freeze() {
+        HnswLib.freeze(pointer);
+    }
+
+    /**
+     * Two-stage search: keeps a copy of the items added afterwards in {@code rerankPrecision}
+     * (float32, float16 or bfloat16). Searches fetch {@code nbCandidates} items on the codes of
+     * the index and return the closest ones by distances on that copy.
+     */
+    public void enableRerank(String rerankPrecision, long nbCandidates) {
+        HnswLib.enableRerank(pointer, Precision.getVal(rerankPrecision), nbCandidates);
+    }
+
+    public void setRerankCandidates(long nbCandidates) {
+        HnswLib.setRerankCandidates(pointer, nbCandidates);
+    }
+
+    public void saveRerankVectors(String path) {
+        HnswLib.saveRerankVectors(pointer, path);
+    }
+
+    /**
+     * Loads the rerank copy saved with {@link #saveRerankVectors}, after {@link #enableRerank}.
+     * @param mmap maps the vectors from the file instead of reading them in memory
+     */
+    public void loadRerankVectors(String path, boolean mmap) {
+        HnswLib.loadRerankVectors(pointer, path, mmap);
+    }
+
     public void unload() {
         HnswLib.destroy(pointer);
     }
@@ -116,6 +211,11 @@ public class HnswIndex {
         return FloatByteBuf.wrappedBuffer(buffer);
     }
 
+    /**
+     * Stored vector of {@code label} decoded into floats. Kendall indices of float16 or float8
+     * precision store the ranks of the components, their items decode to ranks rather than to
+     * the added values.
+     */
     public FloatByteBuf getItemDecoded(long label) throws Exception {
         try (FloatByteBuf item = getItem(label)) {
             return decode(item);
@@ -172,7 +272,7 @@ public class HnswIndex {
         if (src == null) {
             return null;
         }
-        if (precision == Precision.Float32Val) {
+        if (isPlainFloat32()) {
             FloatByteBuf ret = new FloatByteBuf(dimension);
             ret.writeBytes(src);
             return ret;
@@ -184,15 +284,20 @@ public class HnswIndex {
     }
 
     public ByteBuffer encode(ByteBuffer src) {
-        if (precision == Precision.Float32Val) {
+        if (isPlainFloat32()) {
             return src;
         }
-        int size_per_component = Precision.getBytesPerComponent(precision);
-        ByteBuffer dst = ByteBuffer.allocateDirect(dimension * size_per_component);
+        // Encoded size isn't proportional to the dimension for all precisions (PQ codes)
+        ByteBuffer dst = ByteBuffer.allocateDirect((int) HnswLib.getDataSize(pointer));
         HnswLib.encode(pointer, src, dst);
         return dst;
     }
 
+    // Float32 items are the vector itself unless a norm slot or a MIPS coordinate follows it
+    private boolean isPlainFloat32() {
+        return precision == Precision.Float32Val && HnswLib.getDataSize(pointer) == 4L * dimension;
+    }
+
     public boolean needsTraining() {
         return HnswLib.encodingNeedsTraining(pointer);
     }
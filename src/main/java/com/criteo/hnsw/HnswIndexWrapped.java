@@ -162,6 +162,8 @@ public class HnswIndexWrapped implements Index {
                 return 3E-7f;
             case Precision.Float16Val:
                 return 2E-4f;
+            case Precision.BFloat16Val:
+                return 4E-3f;
             default:
                 return 1E7f;
         }
@@ -46,6 +46,28 @@ public class HnswLib {
 
     public static native void setEf(long pointer, long ef_search);
 
+    public static native void useCompactLabels(long pointer, boolean compact);
+
+    public static native void useNormSlot(long pointer, boolean use);
+
+    public static native void useBinaryThresholds(long pointer, boolean use);
+
+    public static native void usePQSubspaces(long pointer, long m);
+
+    public static native void useMipsTransform(long pointer, float max_norm);
+
+    public static native long enableNumaReplicas(long pointer, long nb_replicas);
+
+    public static native void freeze(long pointer);
+
+    public static native void enableRerank(long pointer, int precision, long nb_candidates);
+
+    public static native void setRerankCandidates(long pointer, long nb_candidates);
+
+    public static native void saveRerankVectors(long pointer, String path);
+
+    public static native void loadRerankVectors(long pointer, String path, boolean use_mmap);
+
     public static native void saveIndex(long pointer, String path);
 
     public static native void loadIndex(long pointer, String path);
@@ -78,6 +100,8 @@ public class HnswLib {
 
     public static native int getDimension(long index);
 
+    public static native long getDataSize(long index);
+
     public static native boolean encodingNeedsTraining(long index);
 
     public static native void trainEncodingSpace(long pointer, float[] vector);
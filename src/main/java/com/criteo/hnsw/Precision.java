@@ -4,11 +4,21 @@ public class Precision {
     public static final String Float32 = "float32";
     public static final String Float16 = "float16";
     public static final String Float8 = "float8";
+    public static final String PQ = "pq";
+    public static final String Float4 = "float4";
+    public static final String BFloat16 = "bfloat16";
+    public static final String Int8Symmetric = "int8";
+    public static final String Binary = "binary";
 
     // See mapping int hnswindex.h `Precision` enum
     public static final int Float32Val = 1;
     public static final int Float16Val = 2;
     public static final int Float8Val = 3;
+    public static final int PQVal = 4;
+    public static final int Float4Val = 5;
+    public static final int BFloat16Val = 6;
+    public static final int Int8SymmetricVal = 7;
+    public static final int BinaryVal = 8;
 
     public static final int FLOAT_32_SIZE_IN_BYTES = 4;
     public static final int FLOAT_16_SIZE_IN_BYTES = 2;
@@ -22,6 +32,16 @@ public class Precision {
                 return Float16Val;
             case Precision.Float8:
                 return Float8Val;
+            case Precision.PQ:
+                return PQVal;
+            case Precision.Float4:
+                return Float4Val;
+            case Precision.BFloat16:
+                return BFloat16Val;
+            case Precision.Int8Symmetric:
+                return Int8SymmetricVal;
+            case Precision.Binary:
+                return BinaryVal;
             default:
                 throw new UnsupportedOperationException();
         }
@@ -35,6 +55,16 @@ public class Precision {
                 return Float16;
             case Precision.Float8Val:
                 return Float8;
+            case Precision.PQVal:
+                return PQ;
+            case Precision.Float4Val:
+                return Float4;
+            case Precision.BFloat16Val:
+                return BFloat16;
+            case Precision.Int8SymmetricVal:
+                return Int8Symmetric;
+            case Precision.BinaryVal:
+                return Binary;
             default:
                 throw new UnsupportedOperationException();
         }
@@ -45,8 +75,10 @@ public class Precision {
             case Precision.Float32Val:
                 return FLOAT_32_SIZE_IN_BYTES;
             case Precision.Float16Val:
+            case Precision.BFloat16Val:
                 return FLOAT_16_SIZE_IN_BYTES;
             case Precision.Float8Val:
+            case Precision.Int8SymmetricVal:
                 return FLOAT_8_SIZE_IN_BYTES;
             default:
                 throw new UnsupportedOperationException();
@@ -58,8 +90,10 @@ public class Precision {
             case Precision.Float32:
                 return FLOAT_32_SIZE_IN_BYTES;
             case Precision.Float16:
+            case Precision.BFloat16:
                 return FLOAT_16_SIZE_IN_BYTES;
             case Precision.Float8:
+            case Precision.Int8Symmetric:
                 return FLOAT_8_SIZE_IN_BYTES;
             default:
                 throw new UnsupportedOperationException();
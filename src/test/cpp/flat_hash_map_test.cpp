@@ -0,0 +1,82 @@
+#include "common.h"
+#include <unordered_map>
+
+TEST_CASE("FlatHashMap behaves as std::unordered_map on inserts, lookups and erases") {
+    hnswlib::LabelLookup lookup;
+    std::unordered_map<hnswlib::labeltype, hnswlib::tableint> expected;
+    srand(seed);
+
+    SUBCASE("Sequential labels") {
+        for (hnswlib::tableint i = 0; i < 10000; i++) {
+            lookup[i] = i;
+            expected[i] = i;
+        }
+    }
+
+    SUBCASE("Random labels with overwrites and erases") {
+        for (hnswlib::tableint i = 0; i < 20000; i++) {
+            const hnswlib::labeltype label = ((size_t) rand() << 20) ^ (size_t) (rand() % 5000);
+            if (i % 7 == 0) {
+                REQUIRE_EQ(expected.erase(label), lookup.erase(label));
+            } else {
+                lookup[label] = i;
+                expected[label] = i;
+            }
+        }
+    }
+
+    REQUIRE_EQ(expected.size(), lookup.size());
+    for (const auto &entry: expected) {
+        CAPTURE(entry.first);
+        REQUIRE_EQ(1, lookup.count(entry.first));
+        const auto found = lookup.find(entry.first);
+        REQUIRE(found != lookup.end());
+        REQUIRE_EQ(entry.second, found->second);
+    }
+    size_t nb_iterated = 0;
+    for (const auto &entry: lookup) {
+        REQUIRE_EQ(expected[entry.first], entry.second);
+        nb_iterated++;
+    }
+    REQUIRE_EQ(expected.size(), nb_iterated);
+    REQUIRE(lookup.find(std::numeric_limits<hnswlib::labeltype>::max()) == lookup.end());
+}
+
+TEST_CASE("FlatHashMap reserve avoids rehashing") {
+    hnswlib::LabelLookup lookup;
+    lookup.reserve(1000);
+    const auto memory = lookup.memoryUsage();
+    for (hnswlib::tableint i = 0; i < 1000; i++) {
+        lookup[i * 31] = i;
+    }
+    REQUIRE_EQ(memory, lookup.memoryUsage());
+    REQUIRE_EQ(1000, lookup.size());
+}
+
+TEST_CASE("Frozen FlatHashMap keeps its entries in a compact read-only array") {
+    hnswlib::LabelLookup lookup;
+    for (hnswlib::tableint i = 0; i < 1000; i++) {
+        lookup[1000 - i] = i;
+    }
+    lookup.freeze();
+    REQUIRE(lookup.isFrozen());
+    REQUIRE_EQ(1000, lookup.size());
+    REQUIRE_EQ(1000 * sizeof(hnswlib::LabelLookup::Entry), lookup.memoryUsage());
+    for (hnswlib::tableint i = 0; i < 1000; i++) {
+        const auto found = lookup.find(1000 - i);
+        REQUIRE(found != lookup.end());
+        REQUIRE_EQ(i, found->second);
+    }
+    REQUIRE(lookup.find(0) == lookup.end());
+    REQUIRE(lookup.find(1001) == lookup.end());
+    size_t nb_iterated = 0;
+    hnswlib::labeltype previous = 0;
+    for (const auto &entry: lookup) {
+        REQUIRE(entry.first > previous);
+        previous = entry.first;
+        nb_iterated++;
+    }
+    REQUIRE_EQ(1000, nb_iterated);
+    REQUIRE_THROWS(lookup[1001] = 0);
+    REQUIRE_THROWS(lookup.erase(1));
+}
@@ -121,3 +121,44 @@ TEST_CASE("Float8 encoding-decoding on large vectors") {
         }
     }
 }
+
+TEST_CASE("Float4 encoding-decoding should stay within half a step") {
+    srand(seed);
+    std::vector<size_t> dimensions;
+    for (size_t dim = 1; dim <= 40; dim++) dimensions.push_back(dim);
+    dimensions.push_back(256);
+    for (const auto dim: dimensions) {
+        CAPTURE(dim);
+        std::vector<float> a(dim), min(dim), max(dim);
+        for (size_t i = 0; i < dim; i++) {
+            min[i] = get_random_float(-1, 1);
+            max[i] = get_random_float(min[i], 1);
+            a[i] = get_random_float(min[i], max[i]);
+        }
+        hnswlib::MinMaxRange range(min, max);
+        auto params = hnswlib::TrainParams(dim);
+        range.update_trained_params(params, hnswlib::float4_max_value);
+        std::vector<uint8_t> a_f4(hnswlib::get_float4_data_size(dim));
+        hnswlib::encode_float4_vector(a.data(), a_f4.data(), &params);
+        std::vector<float> a_f32(dim);
+        hnswlib::decode_float4_vector(a_f4.data(), a_f32.data(), &params);
+        for (size_t i = 0; i < dim; i++) {
+            CAPTURE(i);
+            CAPTURE(a[i]);
+            CAPTURE(a_f32[i]);
+            REQUIRE(std::abs(a[i] - a_f32[i]) <= params.diff[i] / 2 + 1e-6f);
+        }
+
+        // Out of range values are clamped to the bounds
+        std::vector<float> outside(dim);
+        for (size_t i = 0; i < dim; i++) {
+            outside[i] = i % 2 ? max[i] + 1 : min[i] - 1;
+        }
+        hnswlib::encode_float4_vector(outside.data(), a_f4.data(), &params);
+        hnswlib::decode_float4_vector(a_f4.data(), a_f32.data(), &params);
+        for (size_t i = 0; i < dim; i++) {
+            CAPTURE(i);
+            REQUIRE(a_f32[i] == doctest::Approx(i % 2 ? max[i] : min[i]).epsilon(1e-5));
+        }
+    }
+}
@@ -55,6 +55,53 @@ TEST_CASE("Check Float16 encoding-decoding on large vectors") {
     }
 }
 
+TEST_CASE("Check BFloat16 encoding-decoding and distances") {
+    // Round to nearest even on ties, infinities and NaN are preserved
+    REQUIRE_EQ(0x3F80, hnswlib::encode_bf16(1.f).bits);
+    REQUIRE_EQ(0x3F80, hnswlib::encode_bf16(1.f + 1.f / 256).bits);
+    REQUIRE_EQ(0x3F82, hnswlib::encode_bf16(1.f + 3.f / 256).bits);
+    REQUIRE_EQ(0x7F80, hnswlib::encode_bf16(INFINITY).bits);
+    REQUIRE(std::isnan(hnswlib::decode_bf16(hnswlib::encode_bf16(NAN))));
+
+    srand(seed);
+    for (size_t dim = 1; dim <= 40; dim++) {
+        CAPTURE(dim);
+        std::vector<float> a(dim), b(dim);
+        for (size_t i = 0; i < dim; i++) {
+            a[i] = get_random_float(-10, 10);
+            b[i] = get_random_float(-10, 10);
+        }
+        a[0] = NAN;
+        const auto encode_func = hnswlib::get_fast_encode_func<float, hnswlib::bfloat16_t>(dim);
+        const auto decode_func = hnswlib::get_fast_encode_func<hnswlib::bfloat16_t, float>(dim);
+        std::vector<hnswlib::bfloat16_t> a_bf16(dim), b_bf16(dim);
+        std::vector<float> a_f32(dim), b_f32(dim);
+        encode_func(a.data(), a_bf16.data(), &dim);
+        decode_func(a_bf16.data(), a_f32.data(), &dim);
+        REQUIRE(std::isnan(a_f32[0]));
+        for (size_t i = 1; i < dim; i++) {
+            // SIMD encoding matches the scalar one, 8 bits of mantissa are kept
+            REQUIRE_EQ(hnswlib::encode_bf16(a[i]).bits, a_bf16[i].bits);
+            REQUIRE(is_approx_equal(a_f32[i], a[i], std::abs(a[i]) / 256));
+        }
+
+        a[0] = 0.f;
+        encode_func(a.data(), a_bf16.data(), &dim);
+        encode_func(b.data(), b_bf16.data(), &dim);
+        decode_func(a_bf16.data(), a_f32.data(), &dim);
+        decode_func(b_bf16.data(), b_f32.data(), &dim);
+        const auto l2_32 = hnswlib::L2Space<float>(dim);
+        const auto l2_16 = hnswlib::L2Space<hnswlib::bfloat16_t>(dim);
+        const auto ip_32 = hnswlib::InnerProductSpace<float>(dim);
+        const auto ip_16 = hnswlib::InnerProductSpace<hnswlib::bfloat16_t>(dim);
+        REQUIRE_EQ(2 * dim, const_cast<hnswlib::L2Space<hnswlib::bfloat16_t>&>(l2_16).get_data_size());
+        REQUIRE(get_distance(a_bf16.data(), b_bf16.data(), &l2_16) ==
+                doctest::Approx(get_distance(a_f32.data(), b_f32.data(), &l2_32)).epsilon(1E-5));
+        REQUIRE(get_distance(a_bf16.data(), b_bf16.data(), &ip_16) ==
+                doctest::Approx(get_distance(a_f32.data(), b_f32.data(), &ip_32)).epsilon(1E-5));
+    }
+}
+
 TEST_CASE("Check L2 squared distance computation on small vectors") {
     const std::vector<float> a {1.0, 2.0, 3.0, 0.5, 0.1,  0.2, -0.2,  0.005, 1.001};
     const std::vector<float> b {2.0, 4.0, 6.0, 0.0, 0.3, -0.2, -0.45, 0.006, 2.009};
@@ -258,4 +305,533 @@ TEST_CASE ("Check Inner Product distance computation on large vectors") {
         CAPTURE(result8);
         REQUIRE(is_approx_equal(result8, expected_distance, epsilon8));
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Float8 inner product with a quantized query should match the float query distance") {
+    srand(seed);
+    std::vector<size_t> dimensions;
+    for (size_t dim = 1; dim <= 40; dim++) dimensions.push_back(dim);
+    // Integer sums are flushed every 512 components
+    for (size_t dim: {100, 256, 1000, 1100}) dimensions.push_back(dim);
+    for (const auto dim: dimensions) {
+        CAPTURE(dim);
+        std::vector<float> query(dim), b(dim), min(dim), max(dim);
+        for (size_t i = 0; i < dim; i++) {
+            min[i] = get_random_float(-1, 1);
+            max[i] = get_random_float(min[i], 1);
+            query[i] = get_random_float(-1, 1);
+            b[i] = get_random_float(min[i], max[i]);
+        }
+        auto space8 = hnswlib::InnerProductTrainedSpace<uint8_t>(dim);
+        space8.train(min.data());
+        space8.train(max.data());
+        const auto params = static_cast<hnswlib::TrainParams*>(space8.get_dist_func_param());
+        std::vector<uint8_t> b_f8(dim);
+        to_float8(b, b_f8, params);
+
+        std::vector<char> buffer;
+        const auto prepared = space8.prepare_query(query.data(), buffer);
+        REQUIRE(prepared != static_cast<const void*>(query.data()));
+        const auto actual = space8.get_search_dist_func()(prepared, b_f8.data(), params);
+        const auto expected = hnswlib::InnerProduct_trained<float, uint8_t>(query.data(), b_f8.data(), params);
+        CAPTURE(actual);
+        CAPTURE(expected);
+        // Weights are rounded to 1 / 65534 of the largest one
+        REQUIRE(is_approx_equal(actual, expected, 1E-4f));
+    }
+}
+
+TEST_CASE("Int8 symmetric kernels should match distances between decoded vectors") {
+    srand(seed);
+    std::vector<std::pair<hnswlib::INT8SUMSFUNC, hnswlib::INT8SUMSFUNC>> kernels {
+        {hnswlib::int8_sums<false>, hnswlib::int8_sums<true>},
+        {hnswlib::int8_sums_sse<false>, hnswlib::int8_sums_sse<true>},
+    };
+    if (hnswlib::cpu_supports_avx2())
+        kernels.push_back({hnswlib::int8_sums_avx2<false>, hnswlib::int8_sums_avx2<true>});
+    if (hnswlib::cpu_supports_avx512_vnni())
+        kernels.push_back({hnswlib::int8_sums_vnni<false>, hnswlib::int8_sums_vnni<true>});
+    std::vector<size_t> dimensions;
+    for (size_t dim = 1; dim <= 40; dim++) dimensions.push_back(dim);
+    for (size_t dim: {64, 100, 256, 1000}) dimensions.push_back(dim);
+    for (const auto dim: dimensions) {
+        CAPTURE(dim);
+        std::vector<int8_t> a(dim), b(dim);
+        for (size_t i = 0; i < dim; i++) {
+            a[i] = static_cast<int8_t>(rand() % 255 - 127);
+            b[i] = static_cast<int8_t>(rand() % 255 - 127);
+        }
+        hnswlib::Int8Sums expected = {0, 0, 0};
+        for (size_t i = 0; i < dim; i++) {
+            expected.ab += a[i] * b[i];
+            expected.aa += a[i] * a[i];
+            expected.bb += b[i] * b[i];
+        }
+        for (const auto &kernel: kernels) {
+            hnswlib::Int8Sums ip = {0, 0, 0}, l2 = {0, 0, 0};
+            kernel.first(a.data(), b.data(), dim, ip);
+            kernel.second(a.data(), b.data(), dim, l2);
+            REQUIRE_EQ(expected.ab, ip.ab);
+            REQUIRE_EQ(expected.ab, l2.ab);
+            REQUIRE_EQ(expected.aa, l2.aa);
+            REQUIRE_EQ(expected.bb, l2.bb);
+        }
+
+        for (auto inner_product: {false, true}) {
+            CAPTURE(inner_product);
+            std::vector<float> x(dim), y(dim);
+            for (size_t i = 0; i < dim; i++) {
+                x[i] = get_random_float(-1, 1);
+                y[i] = get_random_float(-1, 1);
+            }
+            auto space = hnswlib::Int8SymmetricSpace(dim, inner_product);
+            REQUIRE(space.needs_initialization());
+            space.train(x.data());
+            space.train(y.data());
+            REQUIRE_FALSE(space.needs_initialization());
+            const auto params = static_cast<hnswlib::Int8Params*>(space.get_dist_func_param());
+            std::vector<int8_t> x_i8(dim), y_i8(dim);
+            std::vector<float> x_f32(dim), y_f32(dim);
+            hnswlib::encode_int8_vector(x.data(), x_i8.data(), params);
+            hnswlib::encode_int8_vector(y.data(), y_i8.data(), params);
+            hnswlib::decode_int8_vector(x_i8.data(), x_f32.data(), params);
+            hnswlib::decode_int8_vector(y_i8.data(), y_f32.data(), params);
+            for (size_t i = 0; i < dim; i++) {
+                REQUIRE(std::abs(x_f32[i] - x[i]) <= params->scale / 2 + 1E-6f);
+            }
+            const auto exact_func = inner_product ? hnswlib::InnerProduct<float, float> : hnswlib::L2Sqr<float, float>;
+            const auto expected_distance = exact_func(x_f32.data(), y_f32.data(), &dim);
+            REQUIRE(space.get_dist_func()(x_i8.data(), y_i8.data(), params) == doctest::Approx(expected_distance).epsilon(1E-4));
+
+            // Queries are quantized with their own scale
+            std::vector<float> query(y);
+            for (auto &component: query) component *= 10;
+            std::vector<char> buffer;
+            const auto prepared = space.prepare_query(query.data(), buffer);
+            const auto query_scale = *static_cast<const float*>(prepared);
+            CAPTURE(query_scale);
+            const auto search_distance = space.get_search_dist_func()(prepared, x_i8.data(), params);
+            const auto expected_search_distance = exact_func(query.data(), x_f32.data(), &dim);
+            const auto error = inner_product ? query_scale * dim : query_scale * 10 * dim;
+            REQUIRE(std::abs(search_distance - expected_search_distance) <= error);
+        }
+    }
+}
+
+TEST_CASE("Hamming kernels should count differing bits") {
+    srand(seed);
+    std::vector<hnswlib::DISTFUNC<float>> kernels {hnswlib::Hamming};
+    if (hnswlib::cpu_supports_popcnt()) kernels.push_back(hnswlib::HammingPopcnt);
+    if (hnswlib::cpu_supports_avx2()) kernels.push_back(hnswlib::HammingAVX2);
+    for (size_t dim: {1, 7, 63, 64, 65, 200, 256, 300, 768, 1000}) {
+        CAPTURE(dim);
+        auto space = hnswlib::HammingSpace(dim);
+        REQUIRE_EQ((dim + 63) / 64 * 8, space.get_data_size());
+        REQUIRE_FALSE(space.needs_initialization());
+        const auto params = static_cast<hnswlib::HammingParams*>(space.get_dist_func_param());
+        std::vector<float> a(dim), b(dim);
+        size_t expected = 0;
+        for (size_t i = 0; i < dim; i++) {
+            a[i] = get_random_float(-1, 1);
+            b[i] = get_random_float(-1, 1);
+            expected += (a[i] > 0) != (b[i] > 0);
+        }
+        std::vector<uint8_t> a_bin(space.get_data_size()), b_bin(space.get_data_size());
+        hnswlib::encode_binary_vector(a.data(), a_bin.data(), params);
+        hnswlib::encode_binary_vector(b.data(), b_bin.data(), params);
+        std::vector<float> decoded(dim);
+        hnswlib::decode_binary_vector(a_bin.data(), decoded.data(), params);
+        for (size_t i = 0; i < dim; i++) {
+            REQUIRE_EQ(a[i] > 0 ? 1.f : -1.f, decoded[i]);
+        }
+        for (auto kernel: kernels) {
+            REQUIRE_EQ(expected, kernel(a_bin.data(), b_bin.data(), params));
+        }
+        std::vector<char> buffer;
+        REQUIRE_EQ(expected, space.get_search_dist_func()(space.prepare_query(a.data(), buffer), b_bin.data(), params));
+
+        // Trained thresholds are the mean of the training vectors
+        space.train(a.data());
+        space.train(b.data());
+        REQUIRE(params->thresholds[0] == doctest::Approx((a[0] + b[0]) / 2));
+    }
+}
+
+TEST_CASE("Kendall kernels should match the quadratic one") {
+    srand(seed);
+    std::vector<hnswlib::DISTFUNC<float>> kernels {hnswlib::KendallMergeSort<float>};
+    if (hnswlib::cpu_supports_avx2() && hnswlib::cpu_supports_popcnt()) kernels.push_back(hnswlib::KendallAVX2);
+    for (size_t dim: {2, 3, 7, 8, 9, 31, 32, 100, 257, 1000}) {
+        // Rounded components to get ties, within and across vectors
+        for (float scale: {1000.f, 3.f}) {
+            CAPTURE(dim);
+            CAPTURE(scale);
+            std::vector<float> a(dim), b(dim);
+            for (size_t i = 0; i < dim; i++) {
+                a[i] = std::round(get_random_float(-1, 1) * scale);
+                b[i] = std::round(get_random_float(-1, 1) * scale);
+            }
+            a[0] = -0.f;
+            b[dim - 1] = a[dim - 1];
+            const auto expected = hnswlib::Kendall(a.data(), b.data(), &dim);
+            for (auto kernel: kernels) {
+                REQUIRE_EQ(expected, kernel(a.data(), b.data(), &dim));
+                REQUIRE_EQ(expected, kernel(b.data(), a.data(), &dim));
+            }
+            REQUIRE_EQ(expected, hnswlib::KendallSpace(dim).get_dist_func()(a.data(), b.data(), &dim));
+        }
+        // Same and reversed orders
+        std::vector<float> increasing(dim), decreasing(dim);
+        for (size_t i = 0; i < dim; i++) {
+            increasing[i] = i;
+            decreasing[i] = -0.5f * i;
+        }
+        for (auto kernel: kernels) {
+            REQUIRE_EQ(0.f, kernel(increasing.data(), increasing.data(), &dim));
+            REQUIRE_EQ(2.f, kernel(increasing.data(), decreasing.data(), &dim));
+        }
+    }
+}
+
+template<typename TRANK>
+static void check_kendall_rank_kernels(size_t dim, float scale) {
+    std::vector<hnswlib::DISTFUNC<float>> kernels {hnswlib::KendallRanks<TRANK>, hnswlib::KendallMergeSort<TRANK>};
+    if (hnswlib::cpu_supports_avx2() && hnswlib::cpu_supports_popcnt()) kernels.push_back(hnswlib::KendallRanksAVX2<TRANK>);
+    auto space = hnswlib::KendallRankSpace<TRANK>(dim);
+    REQUIRE_EQ(dim * sizeof(TRANK), space.get_data_size());
+    std::vector<float> a(dim), b(dim);
+    for (size_t i = 0; i < dim; i++) {
+        a[i] = std::round(get_random_float(-1, 1) * scale);
+        b[i] = std::round(get_random_float(-1, 1) * scale);
+    }
+    std::vector<TRANK> a_ranks(dim), b_ranks(dim);
+    hnswlib::encode_rank_vector(a.data(), a_ranks.data(), &dim);
+    hnswlib::encode_rank_vector(b.data(), b_ranks.data(), &dim);
+    // Dense ranks in the order of the components
+    std::vector<float> decoded(dim);
+    hnswlib::decode_rank_vector(a_ranks.data(), decoded.data(), &dim);
+    for (size_t i = 0; i < dim; i++) {
+        for (size_t j = 0; j < std::min<size_t>(dim, 64); j++) {
+            REQUIRE_EQ(a[i] < a[j], decoded[i] < decoded[j]);
+        }
+        REQUIRE(decoded[i] < dim);
+    }
+    const auto expected = hnswlib::Kendall(a.data(), b.data(), &dim);
+    for (auto kernel: kernels) {
+        REQUIRE_EQ(expected, kernel(a_ranks.data(), b_ranks.data(), &dim));
+    }
+    std::vector<char> buffer;
+    REQUIRE_EQ(expected, space.get_search_dist_func()(space.prepare_query(a.data(), buffer), b_ranks.data(), &dim));
+}
+
+TEST_CASE("Kendall kernels on ranks should match the float distances") {
+    srand(seed);
+    for (size_t dim: {2, 7, 31, 32, 33, 100, 256, 257, 1000}) {
+        for (float scale: {1000.f, 3.f}) {
+            CAPTURE(dim);
+            CAPTURE(scale);
+            if (dim <= 256) check_kendall_rank_kernels<uint8_t>(dim, scale);
+            check_kendall_rank_kernels<uint16_t>(dim, scale);
+        }
+    }
+    REQUIRE_THROWS(hnswlib::KendallRankSpace<uint8_t>(257));
+}
+
+TEST_CASE("Float4 distances should match distances between decoded vectors") {
+    srand(seed);
+    std::vector<size_t> dimensions;
+    for (size_t dim = 1; dim <= 40; dim++) dimensions.push_back(dim);
+    // Steps of 32 and 16 components then one by one
+    for (size_t dim: {48, 63, 100, 256, 1000}) dimensions.push_back(dim);
+    for (const auto dim: dimensions) {
+        for (auto inner_product: {false, true}) {
+            CAPTURE(dim);
+            CAPTURE(inner_product);
+            std::vector<float> a(dim), b(dim), min(dim), max(dim);
+            for (size_t i = 0; i < dim; i++) {
+                min[i] = get_random_float(-1, 1);
+                max[i] = get_random_float(min[i], 1);
+                a[i] = get_random_float(min[i], max[i]);
+                b[i] = get_random_float(min[i], max[i]);
+            }
+            auto space4 = hnswlib::Float4TrainedSpace(dim, inner_product);
+            REQUIRE_EQ((dim + 1) / 2, space4.get_data_size());
+            space4.train(min.data());
+            space4.train(max.data());
+            const auto params = static_cast<hnswlib::TrainParams*>(space4.get_dist_func_param());
+            std::vector<uint8_t> a_f4(space4.get_data_size()), b_f4(space4.get_data_size());
+            hnswlib::encode_float4_vector(a.data(), a_f4.data(), params);
+            hnswlib::encode_float4_vector(b.data(), b_f4.data(), params);
+            std::vector<float> a_decoded(dim), b_decoded(dim);
+            hnswlib::decode_float4_vector(a_f4.data(), a_decoded.data(), params);
+            hnswlib::decode_float4_vector(b_f4.data(), b_decoded.data(), params);
+
+            const auto space32 = inner_product ? (hnswlib::SpaceInterface<float> *) new hnswlib::InnerProductSpace<float>(dim)
+                                               : (hnswlib::SpaceInterface<float> *) new hnswlib::L2Space<float>(dim);
+            const auto expected = get_distance(a_decoded.data(), b_decoded.data(), space32);
+            const auto expected_search = get_distance(a.data(), b_decoded.data(), space32);
+            std::vector<char> buffer;
+            const auto query = space4.prepare_query(a.data(), buffer);
+
+            // Every kernel the CPU runs, the space picking the last one
+            std::vector<std::pair<hnswlib::DISTFUNC<float>, hnswlib::DISTFUNC<float>>> kernels {
+                {inner_product ? hnswlib::InnerProduct_float4 : hnswlib::L2Sqr_float4,
+                 inner_product ? hnswlib::InnerProduct_float4_query : hnswlib::L2Sqr_float4_query}};
+#if defined(USE_SSE) || defined(USE_AVX)
+            kernels.emplace_back(inner_product ? hnswlib::InnerProductSIMD16_float4 : hnswlib::L2SqrSIMD16_float4,
+                                 inner_product ? hnswlib::InnerProductSIMD16_float4_query : hnswlib::L2SqrSIMD16_float4_query);
+#endif
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+            if (hnswlib::cpu_supports_avx2_fma())
+                kernels.emplace_back(inner_product ? hnswlib::InnerProductAVX2_float4 : hnswlib::L2SqrAVX2_float4,
+                                     inner_product ? hnswlib::InnerProductAVX2_float4_query : hnswlib::L2SqrAVX2_float4_query);
+            if (hnswlib::cpu_supports_avx512())
+                kernels.emplace_back(inner_product ? hnswlib::InnerProductAVX512_float4 : hnswlib::L2SqrAVX512_float4,
+                                     inner_product ? hnswlib::InnerProductAVX512_float4_query : hnswlib::L2SqrAVX512_float4_query);
+#endif
+            if (dim >= 16)
+                REQUIRE(space4.get_search_dist_func() == kernels.back().second);
+            for (const auto &kernel: kernels) {
+                const auto result = kernel.first(a_f4.data(), b_f4.data(), params);
+                CAPTURE(expected);
+                CAPTURE(result);
+                REQUIRE(is_approx_equal(result, expected, 1e-5f));
+
+                // Search distance from a folded float32 query, inner product weights rounded to 1 / 65534 of the largest one
+                const auto result_search = kernel.second(query, b_f4.data(), params);
+                CAPTURE(expected_search);
+                CAPTURE(result_search);
+                REQUIRE(is_approx_equal(result_search, expected_search, inner_product ? 1e-4f : 1e-5f));
+            }
+            delete space32;
+        }
+    }
+}
+
+#if defined(HNSW_RUNTIME_DISPATCH) && defined(USE_AVX)
+struct DistanceKernels {
+    hnswlib::DISTFUNC<float> l2, l2_search, ip, ip_search;
+};
+
+// Tails of 256 bits kernels are read from the last 8 components, AVX-512 ones under a mask
+template<typename T>
+static std::vector<DistanceKernels> get_dispatched_kernels(size_t dim) {
+    std::vector<DistanceKernels> kernels;
+    if (dim >= 8)
+        kernels.push_back({hnswlib::L2SqrSIMD8ExtMasked<T, T>, hnswlib::L2SqrSIMD8ExtMasked<float, T>,
+                           hnswlib::InnerProductSIMD8ExtMasked<T, T>, hnswlib::InnerProductSIMD8ExtMasked<float, T>});
+    if (dim >= 8 && hnswlib::cpu_supports_avx2_fma())
+        kernels.push_back({hnswlib::L2SqrAVX2<T, T>, hnswlib::L2SqrAVX2<float, T>,
+                           hnswlib::InnerProductAVX2<T, T>, hnswlib::InnerProductAVX2<float, T>});
+    if (hnswlib::cpu_supports_avx512())
+        kernels.push_back({hnswlib::L2SqrAVX512<T, T>, hnswlib::L2SqrAVX512<float, T>,
+                           hnswlib::InnerProductAVX512<T, T>, hnswlib::InnerProductAVX512<float, T>});
+    return kernels;
+}
+
+static std::vector<DistanceKernels> get_dispatched_trained_kernels(size_t dim) {
+    std::vector<DistanceKernels> kernels;
+    if (dim >= 8)
+        kernels.push_back({hnswlib::L2SqrSIMD8ExtMasked_trained<uint8_t, uint8_t>, hnswlib::L2SqrSIMD8ExtMasked_trained<float, uint8_t>,
+                           hnswlib::InnerProductSIMD8ExtMasked_trained<uint8_t, uint8_t>, hnswlib::InnerProductSIMD8ExtMasked_trained<float, uint8_t>});
+    if (dim >= 8 && hnswlib::cpu_supports_avx2_fma())
+        kernels.push_back({hnswlib::L2SqrAVX2_trained<uint8_t, uint8_t>, hnswlib::L2SqrAVX2_trained<float, uint8_t>,
+                           hnswlib::InnerProductAVX2_trained<uint8_t, uint8_t>, hnswlib::InnerProductAVX2_trained<float, uint8_t>});
+    if (hnswlib::cpu_supports_avx512())
+        kernels.push_back({hnswlib::L2SqrAVX512_trained<uint8_t, uint8_t>, hnswlib::L2SqrAVX512_trained<float, uint8_t>,
+                           hnswlib::InnerProductAVX512_trained<uint8_t, uint8_t>, hnswlib::InnerProductAVX512_trained<float, uint8_t>});
+    return kernels;
+}
+
+static void check_distances(const std::vector<DistanceKernels> &kernels, const DistanceKernels &expected,
+                            const void *a, const void *b, const float *query, const void *params) {
+    for (const auto &kernel: kernels) {
+        REQUIRE(is_approx_equal(kernel.l2(a, b, params), expected.l2(a, b, params), 1E-5f));
+        REQUIRE(is_approx_equal(kernel.l2_search(query, b, params), expected.l2_search(query, b, params), 1E-5f));
+        REQUIRE(is_approx_equal(kernel.ip(a, b, params), expected.ip(a, b, params), 1E-5f));
+        REQUIRE(is_approx_equal(kernel.ip_search(query, b, params), expected.ip_search(query, b, params), 1E-5f));
+    }
+}
+
+template<typename T>
+static void check_dispatched_distances(const T *a, const T *b, const float *query, size_t dim) {
+    const DistanceKernels expected {hnswlib::L2Sqr<T, T>, hnswlib::L2Sqr<float, T>,
+                                    hnswlib::InnerProduct<T, T>, hnswlib::InnerProduct<float, T>};
+    check_distances(get_dispatched_kernels<T>(dim), expected, a, b, query, &dim);
+}
+
+template<typename T>
+static void check_fixed_dim_distances(const T *a, const T *b, const float *query, size_t dim) {
+    const DistanceKernels expected {hnswlib::L2Sqr<T, T>, hnswlib::L2Sqr<float, T>,
+                                    hnswlib::InnerProduct<T, T>, hnswlib::InnerProduct<float, T>};
+    std::vector<DistanceKernels> kernels;
+    if (hnswlib::cpu_supports_avx2_fma())
+        kernels.push_back({hnswlib::get_fixed_dim_func<hnswlib::L2SqrAVX2Fixed<T, T>>(dim),
+                           hnswlib::get_fixed_dim_func<hnswlib::L2SqrAVX2Fixed<float, T>>(dim),
+                           hnswlib::get_fixed_dim_func<hnswlib::InnerProductAVX2Fixed<T, T>>(dim),
+                           hnswlib::get_fixed_dim_func<hnswlib::InnerProductAVX2Fixed<float, T>>(dim)});
+    if (hnswlib::cpu_supports_avx512())
+        kernels.push_back({hnswlib::get_fixed_dim_func<hnswlib::L2SqrAVX512Fixed<T, T>>(dim),
+                           hnswlib::get_fixed_dim_func<hnswlib::L2SqrAVX512Fixed<float, T>>(dim),
+                           hnswlib::get_fixed_dim_func<hnswlib::InnerProductAVX512Fixed<T, T>>(dim),
+                           hnswlib::get_fixed_dim_func<hnswlib::InnerProductAVX512Fixed<float, T>>(dim)});
+    check_distances(kernels, expected, a, b, query, &dim);
+}
+
+// Conversions match the scalar ones bit for bit and don't write past the vector
+template<typename SRC, typename DST>
+static void check_dispatched_conversions(const SRC *src, size_t dim) {
+    std::vector<hnswlib::DECODEFUNC<SRC, DST, size_t>> funcs;
+    if (hnswlib::cpu_supports_avx2_fma()) funcs.push_back(hnswlib::encode_decode_vector_avx2<SRC, DST>);
+    if (hnswlib::cpu_supports_avx512()) funcs.push_back(hnswlib::encode_decode_vector_avx512<SRC, DST>);
+    std::vector<DST> expected(dim + 16);
+    hnswlib::encode_decode_vector<SRC, DST, hnswlib::encode_component, 1>(src, expected.data(), &dim);
+    for (const auto &func: funcs) {
+        std::vector<DST> actual(expected);
+        memset(actual.data(), 0, dim * sizeof(DST));
+        func(src, actual.data(), &dim);
+        REQUIRE(memcmp(expected.data(), actual.data(), actual.size() * sizeof(DST)) == 0);
+    }
+}
+
+TEST_CASE("Masked tail and runtime dispatched kernels should match the scalar ones") {
+    srand(seed);
+    std::vector<size_t> dimensions;
+    for (size_t dim = 1; dim <= 40; dim++) dimensions.push_back(dim);
+    for (size_t dim: {100, 101, 256, 1000, 1100}) dimensions.push_back(dim);
+    for (const auto dim: dimensions) {
+        CAPTURE(dim);
+        std::vector<float> a(dim), b(dim), min(dim), max(dim);
+        for (size_t i = 0; i < dim; i++) {
+            min[i] = get_random_float(-1, 1);
+            max[i] = get_random_float(min[i], 1);
+            a[i] = get_random_float(min[i], max[i]);
+            b[i] = get_random_float(min[i], max[i]);
+        }
+        check_dispatched_distances(a.data(), b.data(), a.data(), dim);
+
+        std::vector<uint16_t> a_f16(dim), b_f16(dim);
+        std::vector<hnswlib::bfloat16_t> a_bf16(dim), b_bf16(dim);
+        for (size_t i = 0; i < dim; i++) {
+            a_f16[i] = hnswlib::encode_fp16(a[i]);
+            b_f16[i] = hnswlib::encode_fp16(b[i]);
+            a_bf16[i] = hnswlib::encode_bf16(a[i]);
+            b_bf16[i] = hnswlib::encode_bf16(b[i]);
+        }
+        check_dispatched_conversions<float, uint16_t>(a.data(), dim);
+        check_dispatched_conversions<uint16_t, float>(a_f16.data(), dim);
+        check_dispatched_conversions<float, hnswlib::bfloat16_t>(a.data(), dim);
+        check_dispatched_conversions<hnswlib::bfloat16_t, float>(a_bf16.data(), dim);
+        check_dispatched_distances(a_f16.data(), b_f16.data(), a.data(), dim);
+        check_dispatched_distances(a_bf16.data(), b_bf16.data(), a.data(), dim);
+
+        auto space8 = hnswlib::InnerProductTrainedSpace<uint8_t>(dim);
+        space8.train(min.data());
+        space8.train(max.data());
+        const auto params = static_cast<hnswlib::TrainParams*>(space8.get_dist_func_param());
+        std::vector<uint8_t> a_f8(dim), b_f8(dim);
+        to_float8(a, a_f8, params);
+        to_float8(b, b_f8, params);
+        const DistanceKernels expected {hnswlib::L2Sqr_trained<uint8_t, uint8_t>, hnswlib::L2Sqr_trained<float, uint8_t>,
+                                        hnswlib::InnerProduct_trained<uint8_t, uint8_t>, hnswlib::InnerProduct_trained<float, uint8_t>};
+        check_distances(get_dispatched_trained_kernels(dim), expected, a_f8.data(), b_f8.data(), a.data(), params);
+        if (!hnswlib::cpu_supports_avx2_fma()) continue;
+        std::vector<float> expected_f8(dim), decoded_f8(dim);
+        hnswlib::encode_trained_vector<uint8_t, float, hnswlib::encode_component, 1>(a_f8.data(), expected_f8.data(), params);
+        hnswlib::decode_trained_vector_avx2(a_f8.data(), decoded_f8.data(), params);
+        for (size_t i = 0; i < dim; i++) {
+            REQUIRE(is_approx_equal(expected_f8[i], decoded_f8[i], 1E-6f));
+        }
+        std::vector<char> buffer;
+        const auto prepared = space8.prepare_query(a.data(), buffer);
+        REQUIRE(is_approx_equal(hnswlib::InnerProductAVX2_quantized_query(prepared, b_f8.data(), params),
+                                hnswlib::InnerProduct_quantized_query(prepared, b_f8.data(), params), 1E-5f));
+    }
+}
+
+TEST_CASE("Fixed dimension kernels should match the scalar ones") {
+    srand(seed);
+    REQUIRE(hnswlib::get_fixed_dim_func<hnswlib::L2SqrAVX2Fixed<float, float>>(100) == nullptr);
+    for (size_t dim: {64, 96, 128, 256, 384, 512, 768}) {
+        CAPTURE(dim);
+        REQUIRE(hnswlib::get_fixed_dim_func<hnswlib::L2SqrAVX2Fixed<float, float>>(dim) != nullptr);
+        std::vector<float> a(dim), b(dim);
+        std::vector<uint16_t> a_f16(dim), b_f16(dim);
+        std::vector<hnswlib::bfloat16_t> a_bf16(dim), b_bf16(dim);
+        for (size_t i = 0; i < dim; i++) {
+            a[i] = get_random_float(-1, 1);
+            b[i] = get_random_float(-1, 1);
+            a_f16[i] = hnswlib::encode_fp16(a[i]);
+            b_f16[i] = hnswlib::encode_fp16(b[i]);
+            a_bf16[i] = hnswlib::encode_bf16(a[i]);
+            b_bf16[i] = hnswlib::encode_bf16(b[i]);
+        }
+        check_fixed_dim_distances(a.data(), b.data(), a.data(), dim);
+        check_fixed_dim_distances(a_f16.data(), b_f16.data(), a.data(), dim);
+        check_fixed_dim_distances(a_bf16.data(), b_bf16.data(), a.data(), dim);
+    }
+}
+
+template<typename T>
+static void check_batch_distances(const std::vector<std::vector<T>> &vectors, const float *query, size_t dim) {
+    std::vector<std::pair<hnswlib::DISTBATCHFUNC<float>, hnswlib::DISTFUNC<float>>> kernels;
+    if (hnswlib::cpu_supports_avx2_fma()) {
+        kernels.emplace_back(hnswlib::L2SqrBatchAVX2<float, T>, hnswlib::L2SqrAVX2<float, T>);
+        kernels.emplace_back(hnswlib::InnerProductBatchAVX2<float, T>, hnswlib::InnerProductAVX2<float, T>);
+    }
+    if (hnswlib::cpu_supports_avx512()) {
+        kernels.emplace_back(hnswlib::L2SqrBatchAVX512<float, T>, hnswlib::L2SqrAVX512<float, T>);
+        kernels.emplace_back(hnswlib::InnerProductBatchAVX512<float, T>, hnswlib::InnerProductAVX512<float, T>);
+    }
+    // Fixed dimension kernels against their single vector versions
+    if (hnswlib::cpu_supports_avx2_fma() && hnswlib::get_fixed_dim_func<hnswlib::L2SqrAVX2Fixed<float, T>>(dim) != nullptr) {
+        kernels.emplace_back(hnswlib::get_fixed_dim_batch_func<hnswlib::L2SqrAVX2Fixed<float, T>>(dim), hnswlib::get_fixed_dim_func<hnswlib::L2SqrAVX2Fixed<float, T>>(dim));
+        kernels.emplace_back(hnswlib::get_fixed_dim_batch_func<hnswlib::InnerProductAVX2Fixed<float, T>>(dim), hnswlib::get_fixed_dim_func<hnswlib::InnerProductAVX2Fixed<float, T>>(dim));
+    }
+    if (hnswlib::cpu_supports_avx512() && hnswlib::get_fixed_dim_func<hnswlib::L2SqrAVX512Fixed<float, T>>(dim) != nullptr) {
+        kernels.emplace_back(hnswlib::get_fixed_dim_batch_func<hnswlib::L2SqrAVX512Fixed<float, T>>(dim), hnswlib::get_fixed_dim_func<hnswlib::L2SqrAVX512Fixed<float, T>>(dim));
+        kernels.emplace_back(hnswlib::get_fixed_dim_batch_func<hnswlib::InnerProductAVX512Fixed<float, T>>(dim), hnswlib::get_fixed_dim_func<hnswlib::InnerProductAVX512Fixed<float, T>>(dim));
+    }
+    std::vector<const void *> data;
+    for (const auto &vector: vectors) {
+        data.push_back(vector.data());
+    }
+    for (const auto &kernel: kernels) {
+        for (size_t n = 0; n <= data.size(); n++) {
+            std::vector<float> distances(n + 1, -1.f);
+            kernel.first(query, data.data(), n, &dim, distances.data());
+            for (size_t i = 0; i < n; i++) {
+                REQUIRE_EQ(kernel.second(query, data[i], &dim), distances[i]);
+            }
+            REQUIRE_EQ(-1.f, distances[n]);
+        }
+    }
+}
+
+TEST_CASE("Batched search kernels should match the single vector ones") {
+    srand(seed);
+    const size_t nb_vectors = 9;
+    std::vector<size_t> dimensions;
+    for (size_t dim = 8; dim <= 40; dim++) dimensions.push_back(dim);
+    for (size_t dim: {64, 96, 101, 128, 256, 768, 1000}) dimensions.push_back(dim);
+    for (const auto dim: dimensions) {
+        CAPTURE(dim);
+        std::vector<float> query(dim);
+        for (size_t i = 0; i < dim; i++) {
+            query[i] = get_random_float(-1, 1);
+        }
+        std::vector<std::vector<float>> vectors(nb_vectors, std::vector<float>(dim));
+        std::vector<std::vector<uint16_t>> vectors_f16(nb_vectors, std::vector<uint16_t>(dim));
+        std::vector<std::vector<hnswlib::bfloat16_t>> vectors_bf16(nb_vectors, std::vector<hnswlib::bfloat16_t>(dim));
+        for (size_t v = 0; v < nb_vectors; v++) {
+            for (size_t i = 0; i < dim; i++) {
+                vectors[v][i] = get_random_float(-1, 1);
+                vectors_f16[v][i] = hnswlib::encode_fp16(vectors[v][i]);
+                vectors_bf16[v][i] = hnswlib::encode_bf16(vectors[v][i]);
+            }
+        }
+        check_batch_distances(vectors, query.data(), dim);
+        check_batch_distances(vectors_f16, query.data(), dim);
+        check_batch_distances(vectors_bf16, query.data(), dim);
+    }
+}
+#endif
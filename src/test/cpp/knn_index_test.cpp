@@ -1,4 +1,5 @@
 #include "common.h"
+#include <thread>
 
 TEST_CASE("Serialize and deserialize indices") {
     const int M = 15;
@@ -145,3 +146,644 @@ TEST_CASE("Deserialize Float32 as Float8 indices") {
         }
     }
 }
+
+TEST_CASE("Frozen index should serve the same items and searches") {
+    const int M = 15;
+    const int efConstruction = 200;
+    const size_t nbItems = 1000;
+    const size_t K = 10;
+    const size_t dim = 16;
+    srand(seed);
+
+    // Capacity larger than the number of items, trimmed when frozen
+    auto hnsw = Index<float>(InnerProduct, dim, Float32);
+    hnsw.initNewIndex(2 * nbItems, M, efConstruction, seed);
+    std::vector<std::vector<float>> vectors;
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> item(dim);
+        for (size_t i = 0; i < dim; i++) {
+            item[i] = get_random_float(-1, 1);
+        }
+        vectors.push_back(item);
+        hnsw.addItem(item.data(), 10 * id);
+    }
+
+    std::vector<std::vector<size_t>> expected_labels;
+    for (size_t q = 0; q < 20; q++) {
+        std::vector<size_t> labels(K);
+        std::vector<float> distances(K);
+        std::vector<float*> pointers(K);
+        hnsw.knnQuery(vectors[q].data(), labels.data(), distances.data(), pointers.data(), K);
+        expected_labels.push_back(labels);
+    }
+
+    hnsw.freeze();
+    REQUIRE_EQ(nbItems, hnsw.getNbItems());
+    REQUIRE_EQ(nbItems, hnsw.getLabels().size());
+    for (size_t id = 0; id < nbItems; id++) {
+        const auto item = static_cast<float *>(hnsw.getItem(10 * id));
+        REQUIRE(item != nullptr);
+        REQUIRE_EQ(vectors[id], std::vector<float>(item, item + dim));
+    }
+    REQUIRE(hnsw.getItem(1) == nullptr);
+    for (size_t q = 0; q < expected_labels.size(); q++) {
+        std::vector<size_t> labels(K);
+        std::vector<float> distances(K);
+        std::vector<float*> pointers(K);
+        hnsw.knnQuery(vectors[q].data(), labels.data(), distances.data(), pointers.data(), K);
+        REQUIRE_EQ(expected_labels[q], labels);
+    }
+    REQUIRE_THROWS(hnsw.addItem(vectors[0].data(), 1));
+
+    // Frozen indices are saved in the regular format
+    const auto indexPath = "./hnsw-frozen.bin";
+    hnsw.saveIndex(indexPath);
+    auto loaded = Index<float>(InnerProduct, dim, Float32);
+    loaded.loadIndex(indexPath);
+    REQUIRE_EQ(nbItems, loaded.getNbItems());
+    for (size_t q = 0; q < expected_labels.size(); q++) {
+        std::vector<size_t> labels(K);
+        std::vector<float> distances(K);
+        std::vector<float*> pointers(K);
+        loaded.knnQuery(vectors[q].data(), labels.data(), distances.data(), pointers.data(), K);
+        REQUIRE_EQ(expected_labels[q], labels);
+    }
+}
+
+TEST_CASE("Concurrent insertions should link every item") {
+    const int M = 8;
+    const int efConstruction = 100;
+    const size_t nbItems = 2000;
+    const size_t nbThreads = 4;
+    const size_t dim = 8;
+    srand(seed);
+
+    std::vector<std::vector<float>> vectors;
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> item(dim);
+        for (size_t i = 0; i < dim; i++) {
+            item[i] = get_random_float(-1, 1);
+        }
+        vectors.push_back(item);
+    }
+
+    auto hnsw = Index<float>(Euclidean, dim, Float32);
+    hnsw.initNewIndex(nbItems, M, efConstruction, seed);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nbThreads; t++) {
+        threads.emplace_back([&hnsw, &vectors, t, nbThreads]() {
+            for (size_t id = t; id < vectors.size(); id += nbThreads) {
+                hnsw.addItem(vectors[id].data(), id);
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    REQUIRE_EQ(nbItems, hnsw.getNbItems());
+
+    size_t nb_found = 0;
+    for (size_t id = 0; id < nbItems; id++) {
+        size_t label;
+        float distance;
+        float *pointer;
+        hnsw.knnQuery(vectors[id].data(), &label, &distance, &pointer, 1);
+        nb_found += label == id;
+    }
+    REQUIRE(nb_found > 0.99 * nbItems);
+}
+
+TEST_CASE("Compact labels should round trip with regular label indices") {
+    const int M = 12;
+    const int efConstruction = 100;
+    const size_t nbItems = 500;
+    const size_t K = 5;
+    const size_t dim = 8;
+    srand(seed);
+
+    std::vector<std::vector<float>> vectors;
+    auto regular = Index<float>(Euclidean, dim, Float16);
+    regular.initNewIndex(nbItems, M, efConstruction, seed);
+    auto compact = Index<float>(Euclidean, dim, Float16);
+    compact.useCompactLabels(true);
+    compact.initNewIndex(nbItems, M, efConstruction, seed);
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> item(dim);
+        for (size_t i = 0; i < dim; i++) {
+            item[i] = get_random_float(-1, 1);
+        }
+        vectors.push_back(item);
+        regular.addItem(item.data(), 7 * id + 3);
+        compact.addItem(item.data(), 7 * id + 3);
+    }
+    REQUIRE_THROWS(compact.addItem(vectors[0].data(), (size_t) 1 << 32));
+
+    const auto regularPath = "./hnsw-regular-labels.bin";
+    const auto compactPath = "./hnsw-compact-labels.bin";
+    regular.saveIndex(regularPath);
+    compact.saveIndex(compactPath);
+
+    // Every combination of saved and loaded label width serves the same labels
+    for (auto path: {regularPath, compactPath}) {
+        for (auto compact_labels: {false, true}) {
+            CAPTURE(path);
+            CAPTURE(compact_labels);
+            auto loaded = Index<float>(Euclidean, dim, Float16);
+            loaded.useCompactLabels(compact_labels);
+            loaded.loadIndex(path);
+            REQUIRE_EQ(nbItems, loaded.getNbItems());
+            for (size_t id = 0; id < nbItems; id++) {
+                REQUIRE(loaded.getItem(7 * id + 3) != nullptr);
+            }
+            for (size_t q = 0; q < 20; q++) {
+                std::vector<size_t> labels(K);
+                std::vector<float> distances(K);
+                std::vector<float*> pointers(K);
+                loaded.knnQuery(vectors[q].data(), labels.data(), distances.data(), pointers.data(), K);
+                REQUIRE_EQ(7 * q + 3, labels[0]);
+            }
+        }
+    }
+
+    // Labels above 32 bits can't be loaded in compact mode
+    auto large = Index<float>(Euclidean, dim, Float32);
+    large.initNewIndex(1, M, efConstruction, seed);
+    large.addItem(vectors[0].data(), (size_t) 1 << 40);
+    large.saveIndex(regularPath);
+    auto loaded = Index<float>(Euclidean, dim, Float32);
+    loaded.useCompactLabels(true);
+    REQUIRE_THROWS(loaded.loadIndex(regularPath));
+}
+
+TEST_CASE("Int8 symmetric indices should find items and persist their scale") {
+    const int M = 12;
+    const int efConstruction = 100;
+    const size_t nbItems = 500;
+    const size_t K = 5;
+    const size_t dim = 40;
+    srand(seed);
+
+    for (auto distance: {Euclidean, InnerProduct}) {
+        CAPTURE(distance);
+        std::vector<std::vector<float>> vectors;
+        auto hnsw = Index<float>(distance, dim, Int8Symmetric);
+        hnsw.initNewIndex(nbItems, M, efConstruction, seed);
+        for (size_t id = 0; id < nbItems; id++) {
+            std::vector<float> item(dim);
+            for (size_t i = 0; i < dim; i++) {
+                item[i] = get_random_float(-1, 1);
+            }
+            vectors.push_back(item);
+            hnsw.space->train(item.data());
+        }
+        REQUIRE_EQ(dim, hnsw.space->get_data_size());
+        for (size_t id = 0; id < nbItems; id++) {
+            hnsw.addItem(vectors[id].data(), id);
+        }
+
+        const auto indexPath = "./hnsw-int8.bin";
+        hnsw.saveIndex(indexPath);
+        auto loaded = Index<float>(distance, dim, Int8Symmetric);
+        loaded.loadIndex(indexPath);
+        REQUIRE_FALSE(loaded.space->needs_initialization());
+        const auto scale = static_cast<hnswlib::Int8Params*>(hnsw.space->get_dist_func_param())->scale;
+        REQUIRE_EQ(scale, static_cast<hnswlib::Int8Params*>(loaded.space->get_dist_func_param())->scale);
+        for (size_t q = 0; q < 20; q++) {
+            std::vector<size_t> labels(K), loaded_labels(K);
+            std::vector<float> distances(K);
+            std::vector<float*> pointers(K);
+            hnsw.knnQuery(vectors[q].data(), labels.data(), distances.data(), pointers.data(), K);
+            loaded.knnQuery(vectors[q].data(), loaded_labels.data(), distances.data(), pointers.data(), K);
+            REQUIRE_EQ(labels, loaded_labels);
+            // Self is the closest item in Euclidean space only
+            if (distance == Euclidean) REQUIRE_EQ(q, labels[0]);
+        }
+    }
+}
+
+TEST_CASE("Float4 indices should persist their trained ranges") {
+    const int M = 12;
+    const int efConstruction = 100;
+    const size_t nbItems = 300;
+    const size_t K = 5;
+    const size_t dim = 32;
+    srand(seed);
+
+    std::vector<std::vector<float>> vectors;
+    auto hnsw = Index<float>(Euclidean, dim, Float4);
+    hnsw.initNewIndex(nbItems, M, efConstruction, seed);
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> item(dim);
+        for (size_t i = 0; i < dim; i++) {
+            item[i] = get_random_float(-1, 1);
+        }
+        vectors.push_back(item);
+        hnsw.space->train(item.data());
+    }
+    for (size_t id = 0; id < nbItems; id++) {
+        hnsw.addItem(vectors[id].data(), id);
+    }
+
+    const auto indexPath = "./hnsw-float4.bin";
+    hnsw.saveIndex(indexPath);
+    auto loaded = Index<float>(Euclidean, dim, Float4);
+    loaded.loadIndex(indexPath);
+    REQUIRE_FALSE(loaded.space->needs_initialization());
+    const auto params = static_cast<hnswlib::TrainParams*>(hnsw.space->get_dist_func_param());
+    const auto loaded_params = static_cast<hnswlib::TrainParams*>(loaded.space->get_dist_func_param());
+    for (size_t i = 0; i < dim; i++) {
+        REQUIRE_EQ(params->min[i], loaded_params->min[i]);
+        REQUIRE_EQ(params->diff[i], loaded_params->diff[i]);
+    }
+    for (size_t q = 0; q < 20; q++) {
+        std::vector<size_t> labels(K), loaded_labels(K);
+        std::vector<float> distances(K), loaded_distances(K);
+        std::vector<float*> pointers(K);
+        hnsw.knnQuery(vectors[q].data(), labels.data(), distances.data(), pointers.data(), K);
+        loaded.knnQuery(vectors[q].data(), loaded_labels.data(), loaded_distances.data(), pointers.data(), K);
+        REQUIRE_EQ(labels, loaded_labels);
+        REQUIRE_EQ(distances, loaded_distances);
+    }
+}
+
+TEST_CASE("Binary indices with thresholds should train them when loading float32 ones") {
+    const int M = 12;
+    const int efConstruction = 100;
+    const size_t nbItems = 200;
+    const size_t dim = 64;
+    srand(seed);
+
+    std::vector<std::vector<float>> vectors;
+    std::vector<float> mean(dim);
+    auto source = Index<float>(Euclidean, dim, Float32);
+    source.initNewIndex(nbItems, M, efConstruction, seed);
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> item(dim);
+        for (size_t i = 0; i < dim; i++) {
+            item[i] = get_random_float(0, 2);
+            mean[i] += item[i] / nbItems;
+        }
+        vectors.push_back(item);
+        source.addItem(item.data(), id);
+    }
+    const auto float32Path = "./hnsw-binary-source.bin";
+    source.saveIndex(float32Path);
+
+    auto hnsw = Index<float>(Euclidean, dim, Binary);
+    hnsw.useBinaryThresholds(true);
+    REQUIRE(hnsw.space->needs_initialization());
+    hnsw.loadIndex(float32Path);
+    REQUIRE_FALSE(hnsw.space->needs_initialization());
+    const auto params = static_cast<hnswlib::HammingParams*>(hnsw.space->get_dist_func_param());
+    for (size_t i = 0; i < dim; i++) {
+        REQUIRE(params->thresholds[i] == doctest::Approx(mean[i]).epsilon(1E-4));
+    }
+    std::vector<float> decoded(dim);
+    for (size_t id = 0; id < nbItems; id++) {
+        hnsw.decode(hnsw.getItem(id), decoded.data());
+        for (size_t i = 0; i < dim; i++) {
+            REQUIRE_EQ(vectors[id][i] > params->thresholds[i], decoded[i] > 0);
+        }
+    }
+
+    // Trained thresholds come back with the Binary index
+    const auto indexPath = "./hnsw-binary-thresholds.bin";
+    hnsw.saveIndex(indexPath);
+    auto loaded = Index<float>(Euclidean, dim, Binary);
+    loaded.useBinaryThresholds(true);
+    loaded.loadIndex(indexPath);
+    REQUIRE_FALSE(loaded.space->needs_initialization());
+    const auto loaded_params = static_cast<hnswlib::HammingParams*>(loaded.space->get_dist_func_param());
+    REQUIRE_EQ(params->thresholds, loaded_params->thresholds);
+}
+
+TEST_CASE("Searches inlining the distance kernel should match searches through the space") {
+    const int M = 12;
+    const int efConstruction = 100;
+    const size_t nbItems = 500;
+    const size_t K = 10;
+    srand(seed);
+    const std::vector<std::tuple<Precision, Distance>> indices {
+        std::make_tuple(Float32, Euclidean),
+        std::make_tuple(Float32, InnerProduct),
+        std::make_tuple(Float16, Euclidean),
+        std::make_tuple(BFloat16, Angular),
+    };
+    for (size_t dim: {64, 100, 128}) {
+        for (auto item: indices) {
+            const auto precision = std::get<0>(item);
+            const auto distance = std::get<1>(item);
+            CAPTURE(dim);
+            CAPTURE(distance);
+            CAPTURE(precision);
+            auto hnsw = Index<float>(distance, dim, precision);
+            hnsw.initNewIndex(nbItems, M, efConstruction, seed);
+            REQUIRE((hnsw.inlined_search == nullptr) == (dim == 100 || !hnswlib::cpu_supports_avx2_fma()));
+            std::vector<std::vector<float>> vectors;
+            for (size_t id = 0; id < nbItems; id++) {
+                std::vector<float> vector(dim);
+                for (size_t i = 0; i < dim; i++) {
+                    vector[i] = get_random_float(-1, 1);
+                }
+                hnsw.addItem(vector.data(), id);
+                vectors.push_back(vector);
+            }
+            for (size_t q = 0; q < 20; q++) {
+                std::vector<size_t> labels(K);
+                std::vector<float> distances(K);
+                std::vector<float*> pointers(K);
+                hnsw.knnQuery(vectors[q].data(), labels.data(), distances.data(), pointers.data(), K);
+                std::vector<float> norm_array;
+                auto expected = hnsw.appr_alg->searchKnn(hnsw.normalizeItem(vectors[q].data(), norm_array), K);
+                REQUIRE_EQ(K, expected.size());
+                for (int i = K - 1; i >= 0; i--) {
+                    REQUIRE_EQ(hnsw.appr_alg->getExternalLabel(expected.top().second), labels[i]);
+                    REQUIRE(is_approx_equal(expected.top().first, distances[i], 1E-5f));
+                    expected.pop();
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Norm slot indices should match regular Euclidean indices") {
+    const int M = 12;
+    const int efConstruction = 100;
+    const size_t nbItems = 500;
+    const size_t K = 5;
+    srand(seed);
+
+    REQUIRE_THROWS(Index<float>(InnerProduct, 16, Float32).useNormSlot(true));
+    REQUIRE_THROWS(Index<float>(Euclidean, 16, Float8).useNormSlot(true));
+    // The bruteforce search holds the distance of the space the slot replaces
+    auto bruteforce = Index<float>(Euclidean, 16, Float32);
+    bruteforce.enableBruteforceSearch();
+    REQUIRE_THROWS(bruteforce.useNormSlot(true));
+
+    for (size_t dim: {5, 40, 128}) {
+        std::vector<std::vector<float>> vectors;
+        for (size_t id = 0; id < nbItems; id++) {
+            std::vector<float> vector(dim);
+            for (size_t i = 0; i < dim; i++) {
+                vector[i] = get_random_float(-1, 1);
+            }
+            vectors.push_back(vector);
+        }
+        const auto float32Path = "./hnsw-norm-slot-source.bin";
+        auto source = Index<float>(Euclidean, dim, Float32);
+        source.initNewIndex(nbItems, M, efConstruction, seed);
+        for (size_t id = 0; id < nbItems; id++) {
+            source.addItem(vectors[id].data(), id);
+        }
+        source.saveIndex(float32Path);
+
+        for (auto precision: {Float32, Float16, BFloat16}) {
+            CAPTURE(dim);
+            CAPTURE(precision);
+            auto regular = Index<float>(Euclidean, dim, precision);
+            regular.initNewIndex(nbItems, M, efConstruction, seed);
+            auto hnsw = Index<float>(Euclidean, dim, precision);
+            hnsw.useNormSlot(true);
+            hnsw.initNewIndex(nbItems, M, efConstruction, seed);
+            REQUIRE_EQ(regular.space->get_data_size() + sizeof(float), hnsw.space->get_data_size());
+            REQUIRE(hnsw.inlined_search == nullptr);
+            REQUIRE_THROWS(hnsw.useNormSlot(false));
+            for (size_t id = 0; id < nbItems; id++) {
+                regular.addItem(vectors[id].data(), id);
+                hnsw.addItem(vectors[id].data(), id);
+            }
+            for (size_t id = 1; id < nbItems; id++) {
+                REQUIRE(is_approx_equal(regular.getDistanceBetweenLabels(0, id), hnsw.getDistanceBetweenLabels(0, id), 1E-4f));
+            }
+
+            // Loaded from the float32 index or from the index saved with its norms
+            const auto indexPath = "./hnsw-norm-slot.bin";
+            hnsw.saveIndex(indexPath);
+            auto loaded = Index<float>(Euclidean, dim, precision);
+            loaded.useNormSlot(true);
+            loaded.loadIndex(indexPath);
+            auto converted = Index<float>(Euclidean, dim, precision);
+            converted.useNormSlot(true);
+            converted.loadIndex(float32Path);
+            for (size_t q = 0; q < 20; q++) {
+                std::vector<size_t> labels(K), loaded_labels(K), converted_labels(K);
+                std::vector<float> distances(K), loaded_distances(K), converted_distances(K);
+                std::vector<float*> pointers(K);
+                hnsw.knnQuery(vectors[q].data(), labels.data(), distances.data(), pointers.data(), K);
+                loaded.knnQuery(vectors[q].data(), loaded_labels.data(), loaded_distances.data(), pointers.data(), K);
+                converted.knnQuery(vectors[q].data(), converted_labels.data(), converted_distances.data(), pointers.data(), K);
+                REQUIRE_EQ(q, labels[0]);
+                REQUIRE_EQ(labels, loaded_labels);
+                REQUIRE_EQ(distances, loaded_distances);
+                REQUIRE_EQ(q, converted_labels[0]);
+                for (size_t i = 0; i < K; i++) {
+                    REQUIRE(is_approx_equal(regular.getDistanceBetweenLabels(q, labels[i]), distances[i], 1E-2f));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("MIPS transformed indices should return inner product neighbours") {
+    const int M = 12;
+    const int efConstruction = 100;
+    const size_t nbItems = 500;
+    const size_t K = 5;
+    const size_t dim = 40;
+    const float max_norm = 4;
+    srand(seed);
+
+    REQUIRE_THROWS(Index<float>(Euclidean, dim, Float32).useMipsTransform(max_norm));
+    REQUIRE_THROWS(Index<float>(InnerProduct, dim, PQ).useMipsTransform(max_norm));
+    REQUIRE_THROWS(Index<float>(InnerProduct, dim, Float32).useMipsTransform(0));
+    auto bruteforce = Index<float>(InnerProduct, dim, Float32);
+    bruteforce.enableBruteforceSearch();
+    REQUIRE_THROWS(bruteforce.useMipsTransform(max_norm));
+
+    // Unnormalized items, norms between 0.5 and max_norm
+    std::vector<std::vector<float>> vectors;
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> vector(dim);
+        float norm = 0;
+        for (size_t i = 0; i < dim; i++) {
+            vector[i] = get_random_float(-1, 1);
+            norm += vector[i] * vector[i];
+        }
+        const auto scale = get_random_float(0.5f, max_norm) / std::sqrt(norm);
+        for (size_t i = 0; i < dim; i++) {
+            vector[i] *= scale;
+        }
+        vectors.push_back(vector);
+    }
+
+    // Built without the transform, its items are augmented when loaded by MIPS indices
+    auto plain = Index<float>(InnerProduct, dim, Float32);
+    plain.initNewIndex(nbItems, M, efConstruction, seed);
+    for (size_t id = 0; id < nbItems; id++) {
+        plain.addItem(vectors[id].data(), id);
+    }
+    const auto plainPath = "./hnsw-mips-plain.bin";
+    plain.saveIndex(plainPath);
+
+    for (auto precision: {Float32, Float16, BFloat16}) {
+        CAPTURE(precision);
+        auto hnsw = Index<float>(InnerProduct, dim, precision);
+        hnsw.useMipsTransform(max_norm);
+        hnsw.initNewIndex(nbItems, M, efConstruction, seed);
+        hnsw.enableBruteforceSearch();
+        REQUIRE_THROWS(hnsw.enableRerank(Float32, 10));
+        for (size_t id = 0; id < nbItems; id++) {
+            hnsw.addItem(vectors[id].data(), id);
+        }
+        std::vector<float> too_long(vectors[0]);
+        for (auto &x: too_long) x *= 2 * max_norm;
+        REQUIRE_THROWS(hnsw.addItem(too_long.data(), nbItems));
+
+        std::vector<float> decoded(dim);
+        hnsw.decode(hnsw.getItem(3), decoded.data());
+        for (size_t i = 0; i < dim; i++) {
+            REQUIRE(is_approx_equal(vectors[3][i], decoded[i], 1E-2f));
+        }
+
+        const auto indexPath = "./hnsw-mips.bin";
+        hnsw.saveIndex(indexPath);
+        auto loaded = Index<float>(InnerProduct, dim, precision);
+        loaded.useMipsTransform(max_norm);
+        loaded.loadIndex(indexPath);
+        auto converted = Index<float>(InnerProduct, dim, precision);
+        converted.useMipsTransform(max_norm);
+        converted.loadIndex(plainPath);
+        auto too_small = Index<float>(InnerProduct, dim, precision);
+        too_small.useMipsTransform(max_norm / 4);
+        REQUIRE_THROWS(too_small.loadIndex(plainPath));
+        hnsw.setEf(nbItems);
+        loaded.setEf(nbItems);
+        converted.setEf(nbItems);
+        for (size_t q = 0; q < 20; q++) {
+            std::vector<size_t> labels(K), exact_labels(K), loaded_labels(K), converted_labels(K);
+            std::vector<float> distances(K), exact_distances(K), loaded_distances(K), converted_distances(K);
+            std::vector<float*> pointers(K);
+            const auto query = vectors[nbItems - 1 - q].data();
+            hnsw.knnQuery(query, labels.data(), distances.data(), pointers.data(), K);
+            hnsw.knnQuery<true>(query, exact_labels.data(), exact_distances.data(), pointers.data(), K);
+            loaded.knnQuery(query, loaded_labels.data(), loaded_distances.data(), pointers.data(), K);
+            converted.knnQuery(query, converted_labels.data(), converted_distances.data(), pointers.data(), K);
+            REQUIRE_EQ(exact_labels, labels);
+            REQUIRE_EQ(labels, loaded_labels);
+            REQUIRE_EQ(distances, loaded_distances);
+            REQUIRE_EQ(labels, converted_labels);
+            REQUIRE_EQ(distances, converted_distances);
+            for (size_t i = 0; i < K; i++) {
+                float ip = 0;
+                for (size_t j = 0; j < dim; j++) {
+                    ip += query[j] * vectors[labels[i]][j];
+                }
+                REQUIRE(is_approx_equal(1.0f - ip, distances[i], 1E-2f));
+                REQUIRE(is_approx_equal(hnsw.getDistanceBetweenLabels(nbItems - 1 - q, labels[i]), distances[i], 1E-2f));
+                if (i > 0) REQUIRE(distances[i - 1] <= distances[i]);
+            }
+        }
+    }
+}
+
+TEST_CASE("Kendall indices on ranks should match float32 ones") {
+    const int M = 12;
+    const int efConstruction = 100;
+    const size_t nbItems = 300;
+    const size_t K = 5;
+    const size_t dim = 50;
+    srand(seed);
+
+    std::vector<std::vector<float>> vectors;
+    auto float32 = Index<float>(Kendall, dim, Float32);
+    float32.initNewIndex(nbItems, M, efConstruction, seed);
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> vector(dim);
+        for (size_t i = 0; i < dim; i++) {
+            vector[i] = get_random_float(-1, 1);
+        }
+        float32.addItem(vector.data(), id);
+        vectors.push_back(vector);
+    }
+    const auto float32Path = "./hnsw-kendall.bin";
+    float32.saveIndex(float32Path);
+
+    for (auto precision: {Float16, Float8}) {
+        CAPTURE(precision);
+        auto ranks = Index<float>(Kendall, dim, precision);
+        ranks.initNewIndex(nbItems, M, efConstruction, seed);
+        REQUIRE_EQ(dim * (precision == Float16 ? 2 : 1), ranks.space->get_data_size());
+        for (size_t id = 0; id < nbItems; id++) {
+            ranks.addItem(vectors[id].data(), id);
+        }
+        auto loaded = Index<float>(Kendall, dim, precision);
+        loaded.loadIndex(float32Path);
+        // Items decode to the ranks of their components
+        std::vector<float> decoded(dim);
+        loaded.decode(loaded.getItem(7), decoded.data());
+        for (size_t i = 0; i < dim; i++) {
+            for (size_t j = 0; j < dim; j++) {
+                REQUIRE_EQ(vectors[7][i] < vectors[7][j], decoded[i] < decoded[j]);
+            }
+        }
+        for (size_t q = 0; q < 20; q++) {
+            std::vector<size_t> labels(K), rank_labels(K), loaded_labels(K);
+            std::vector<float> distances(K), rank_distances(K), loaded_distances(K);
+            std::vector<float*> pointers(K);
+            float32.knnQuery(vectors[q].data(), labels.data(), distances.data(), pointers.data(), K);
+            ranks.knnQuery(vectors[q].data(), rank_labels.data(), rank_distances.data(), pointers.data(), K);
+            loaded.knnQuery(vectors[q].data(), loaded_labels.data(), loaded_distances.data(), pointers.data(), K);
+            REQUIRE_EQ(q, rank_labels[0]);
+            REQUIRE_EQ(distances, rank_distances);
+            REQUIRE_EQ(distances, loaded_distances);
+            for (size_t i = 0; i < K; i++) {
+                REQUIRE_EQ(float32.getDistanceBetweenLabels(q, labels[i]), ranks.getDistanceBetweenLabels(q, labels[i]));
+            }
+        }
+    }
+}
+TEST_CASE("Kendall Float8 indices above 256 components should store 16 bits ranks") {
+    const int M = 12;
+    const int efConstruction = 100;
+    const size_t nbItems = 100;
+    const size_t K = 5;
+    const size_t dim = 300;
+    srand(seed);
+
+    auto float32 = Index<float>(Kendall, dim, Float32);
+    auto ranks = Index<float>(Kendall, dim, Float8);
+    REQUIRE_EQ(dim * sizeof(uint16_t), ranks.space->get_data_size());
+    float32.initNewIndex(nbItems, M, efConstruction, seed);
+    ranks.initNewIndex(nbItems, M, efConstruction, seed);
+    std::vector<std::vector<float>> vectors;
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> vector(dim);
+        for (size_t i = 0; i < dim; i++) {
+            vector[i] = get_random_float(-1, 1);
+        }
+        float32.addItem(vector.data(), id);
+        ranks.addItem(vector.data(), id);
+        vectors.push_back(vector);
+    }
+    const auto float32Path = "./hnsw-kendall-300.bin";
+    float32.saveIndex(float32Path);
+    auto loaded = Index<float>(Kendall, dim, Float8);
+    loaded.loadIndex(float32Path);
+
+    std::vector<float> decoded(dim);
+    loaded.decode(loaded.getItem(3), decoded.data());
+    for (size_t i = 0; i < dim; i++) {
+        REQUIRE_EQ(std::count_if(vectors[3].begin(), vectors[3].end(), [&](float x) { return x < vectors[3][i]; }), decoded[i]);
+    }
+    for (size_t q = 0; q < 10; q++) {
+        std::vector<size_t> labels(K), rank_labels(K), loaded_labels(K);
+        std::vector<float> distances(K), rank_distances(K), loaded_distances(K);
+        std::vector<float*> pointers(K);
+        float32.knnQuery(vectors[q].data(), labels.data(), distances.data(), pointers.data(), K);
+        ranks.knnQuery(vectors[q].data(), rank_labels.data(), rank_distances.data(), pointers.data(), K);
+        loaded.knnQuery(vectors[q].data(), loaded_labels.data(), loaded_distances.data(), pointers.data(), K);
+        REQUIRE_EQ(q, rank_labels[0]);
+        REQUIRE_EQ(distances, rank_distances);
+        REQUIRE_EQ(distances, loaded_distances);
+    }
+}
@@ -1,4 +1,6 @@
 #include "common.h"
+#include <atomic>
+#include <thread>
 
 TEST_CASE("Search Euclidean in the index with <= K items should return all items with their distances") {
     const int M = 15;
@@ -103,4 +105,291 @@ TEST_CASE("Search InnerProduct in the index with <= K items should return all it
             }
         }
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Search on NUMA replicas should return the same results as the original index") {
+    const int M = 15;
+    const int efConstruction = 200;
+    const size_t nbItems = 1000;
+    const size_t K = 10;
+    const size_t dim = 32;
+    srand(seed);
+
+    auto hnsw = Index<float>(Euclidean, dim, Float32);
+    hnsw.initNewIndex(nbItems, M, efConstruction, seed);
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> item(dim);
+        for (size_t i = 0; i < dim; i++) {
+            item[i] = get_random_float(-1, 1);
+        }
+        hnsw.addItem(item.data(), id);
+    }
+
+    std::vector<std::vector<size_t>> expected_labels;
+    std::vector<std::vector<float>> queries;
+    for (size_t q = 0; q < 20; q++) {
+        std::vector<float> query(dim);
+        for (size_t i = 0; i < dim; i++) {
+            query[i] = get_random_float(-1, 1);
+        }
+        std::vector<size_t> labels(K);
+        std::vector<float> distances(K);
+        std::vector<float*> pointers(K);
+        hnsw.knnQuery(query.data(), labels.data(), distances.data(), pointers.data(), K);
+        queries.push_back(query);
+        expected_labels.push_back(labels);
+    }
+
+    // Copies beyond the number of nodes would never be searched
+    const auto nb_replicas = hnswlib::NumaTopology().getNbNodes();
+    REQUIRE_EQ(nb_replicas, hnsw.enableNumaReplicas(nb_replicas + 1));
+    for (size_t q = 0; q < queries.size(); q++) {
+        std::vector<size_t> labels(K);
+        std::vector<float> distances(K);
+        std::vector<float*> pointers(K);
+        const auto nb_results = hnsw.knnQuery(queries[q].data(), labels.data(), distances.data(), pointers.data(), K);
+        REQUIRE_EQ(K, nb_results);
+        REQUIRE_EQ(expected_labels[q], labels);
+    }
+
+    std::vector<float> item(dim, 0.f);
+    if (nb_replicas > 1) {
+        REQUIRE_THROWS(hnsw.addItem(item.data(), nbItems));
+    }
+}
+
+TEST_CASE("Two-stage search on binary codes should rerank candidates on full precision") {
+    const int M = 16;
+    const int efConstruction = 200;
+    const size_t nbItems = 2000;
+    const size_t K = 10;
+    const size_t dim = 128;
+    srand(seed);
+
+    std::vector<std::vector<float>> vectors;
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> item(dim);
+        for (size_t i = 0; i < dim; i++) {
+            item[i] = get_random_float(-1, 1);
+        }
+        vectors.push_back(item);
+    }
+    auto reference = Index<float>(Angular, dim, Float32);
+    reference.initBruteforce(nbItems);
+    auto graph = Index<float>(Angular, dim, Binary);
+    graph.initNewIndex(nbItems, M, efConstruction, seed);
+    graph.enableRerank(Float32, 200);
+    graph.setEf(200);
+    auto scan = Index<float>(Angular, dim, Binary);
+    scan.initBruteforce(nbItems);
+    scan.enableRerank(Float16, 200);
+    REQUIRE_THROWS(scan.enableRerank(Float8, 200));
+    scan.enableRerank(Float16, 200);
+    for (size_t id = 0; id < nbItems; id++) {
+        reference.addItem(vectors[id].data(), id);
+        graph.addItem(vectors[id].data(), id);
+        scan.addItem(vectors[id].data(), id);
+    }
+    REQUIRE_EQ(dim / 8, graph.space->get_data_size());
+
+    size_t nbFoundGraph = 0, nbFoundScan = 0;
+    const size_t nbQueries = 50;
+    for (size_t q = 0; q < nbQueries; q++) {
+        std::vector<float> query(dim);
+        for (size_t i = 0; i < dim; i++) {
+            query[i] = get_random_float(-1, 1);
+        }
+        std::vector<size_t> expected(K), labels(K);
+        std::vector<float> expected_distances(K), distances(K);
+        std::vector<float*> pointers(K);
+        reference.knnQuery(query.data(), expected.data(), expected_distances.data(), pointers.data(), K);
+        REQUIRE_EQ(K, graph.knnQuery(query.data(), labels.data(), distances.data(), pointers.data(), K));
+        for (size_t i = 0; i < K; i++) {
+            const auto found = std::find(expected.begin(), expected.end(), labels[i]);
+            if (found != expected.end()) {
+                // Reranked distances are the float32 ones
+                REQUIRE(distances[i] == doctest::Approx(expected_distances[found - expected.begin()]).epsilon(1E-5));
+                nbFoundGraph++;
+            }
+            if (i > 0) REQUIRE(distances[i - 1] <= distances[i]);
+        }
+        scan.knnQuery(query.data(), labels.data(), distances.data(), pointers.data(), K);
+        for (auto label: labels) {
+            nbFoundScan += std::count(expected.begin(), expected.end(), label);
+        }
+    }
+    const auto recallGraph = (float) nbFoundGraph / (nbQueries * K);
+    const auto recallScan = (float) nbFoundScan / (nbQueries * K);
+    CAPTURE(recallGraph);
+    CAPTURE(recallScan);
+    REQUIRE(recallGraph > 0.8f);
+    REQUIRE(recallScan > 0.8f);
+}
+
+TEST_CASE("Reranked searches should run while items are added") {
+    const int M = 16;
+    const int efConstruction = 100;
+    const size_t nbItems = 4000;
+    const size_t K = 10;
+    const size_t dim = 64;
+    srand(seed);
+
+    std::vector<std::vector<float>> vectors;
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> item(dim);
+        for (size_t i = 0; i < dim; i++) {
+            item[i] = get_random_float(-1, 1);
+        }
+        vectors.push_back(item);
+    }
+    auto hnsw = Index<float>(Euclidean, dim, Binary);
+    hnsw.initNewIndex(nbItems, M, efConstruction, seed);
+    hnsw.enableRerank(Float32, 50);
+    for (size_t id = 0; id < nbItems / 4; id++) {
+        hnsw.addItem(vectors[id].data(), id);
+    }
+
+    // Rows and vectors of the rerank store grow while searches read them
+    std::atomic<bool> adding(true);
+    std::thread writer([&]() {
+        for (size_t id = nbItems / 4; id < nbItems; id++) {
+            hnsw.addItem(vectors[id].data(), id);
+        }
+        adding = false;
+    });
+    size_t nbSearches = 0;
+    std::string error;
+    std::vector<size_t> labels(K);
+    std::vector<float> distances(K);
+    std::vector<float*> pointers(K);
+    // Checked once the writer is joined, graph searches concurrent to adds may return fewer items
+    while (error.empty() && (adding || nbSearches == 0)) {
+        try {
+            hnsw.knnQuery(vectors[nbSearches % nbItems].data(), labels.data(), distances.data(), pointers.data(), K);
+        } catch (const std::exception &e) {
+            error = e.what();
+        }
+        nbSearches++;
+    }
+    writer.join();
+    CAPTURE(nbSearches);
+    REQUIRE_EQ("", error);
+    REQUIRE_EQ(nbItems, hnsw.getNbItems());
+    REQUIRE_EQ(K, hnsw.knnQuery(vectors[0].data(), labels.data(), distances.data(), pointers.data(), K));
+}
+
+TEST_CASE("Items refused by the index should leave the rerank vectors unchanged") {
+    const int M = 16;
+    const int efConstruction = 100;
+    const size_t nbItems = 200;
+    const size_t K = 5;
+    const size_t dim = 32;
+    srand(seed);
+
+    std::vector<std::vector<float>> vectors;
+    auto hnsw = Index<float>(Euclidean, dim, Binary);
+    hnsw.initNewIndex(nbItems, M, efConstruction, seed);
+    hnsw.enableRerank(Float32, 50);
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> item(dim);
+        for (size_t i = 0; i < dim; i++) {
+            item[i] = get_random_float(-1, 1);
+        }
+        vectors.push_back(item);
+        hnsw.addItem(item.data(), id);
+    }
+    hnsw.freeze();
+
+    std::vector<size_t> labels(K), expected_labels(K);
+    std::vector<float> distances(K), expected_distances(K);
+    std::vector<float*> pointers(K);
+    hnsw.knnQuery(vectors[0].data(), expected_labels.data(), expected_distances.data(), pointers.data(), K);
+    // A new label, then an existing one with another vector
+    REQUIRE_THROWS(hnsw.addItem(vectors[1].data(), nbItems));
+    REQUIRE_THROWS(hnsw.addItem(vectors[1].data(), 0));
+    REQUIRE_EQ(nbItems, hnsw.rerank_store->size());
+    hnsw.knnQuery(vectors[0].data(), labels.data(), distances.data(), pointers.data(), K);
+    REQUIRE_EQ(expected_labels, labels);
+    REQUIRE_EQ(expected_distances, distances);
+    REQUIRE_EQ(0, labels[0]);
+    REQUIRE_EQ(0.f, distances[0]);
+}
+
+TEST_CASE("Rerank vectors should be served from memory or mapped from their file") {
+    const int M = 16;
+    const int efConstruction = 100;
+    const size_t nbItems = 1000;
+    const size_t K = 10;
+    const size_t dim = 64;
+    srand(seed);
+
+    std::vector<std::vector<float>> vectors;
+    auto reference = Index<float>(Euclidean, dim, Float32);
+    reference.initBruteforce(nbItems);
+    auto hnsw = Index<float>(Euclidean, dim, Int8Symmetric);
+    REQUIRE_THROWS(hnsw.saveRerankVectors("./hnsw-rerank.bin"));
+    hnsw.initNewIndex(nbItems, M, efConstruction, seed);
+    hnsw.enableRerank(Float32, 100);
+    hnsw.setEf(100);
+    for (size_t id = 0; id < nbItems; id++) {
+        std::vector<float> item(dim);
+        for (size_t i = 0; i < dim; i++) {
+            item[i] = get_random_float(-1, 1);
+        }
+        vectors.push_back(item);
+        hnsw.space->train(item.data());
+    }
+    for (size_t id = 0; id < nbItems; id++) {
+        reference.addItem(vectors[id].data(), id);
+        hnsw.addItem(vectors[id].data(), id);
+    }
+    const auto indexPath = "./hnsw-rerank-index.bin";
+    const auto vectorsPath = "./hnsw-rerank.bin";
+    hnsw.saveIndex(indexPath);
+    hnsw.saveRerankVectors(vectorsPath);
+
+    std::vector<std::vector<float>> queries;
+    std::vector<std::vector<size_t>> expected_labels;
+    size_t nbFound = 0;
+    for (size_t q = 0; q < 20; q++) {
+        std::vector<float> query(dim);
+        for (size_t i = 0; i < dim; i++) {
+            query[i] = get_random_float(-1, 1);
+        }
+        std::vector<size_t> expected(K), labels(K);
+        std::vector<float> distances(K);
+        std::vector<float*> pointers(K);
+        reference.knnQuery(query.data(), expected.data(), distances.data(), pointers.data(), K);
+        hnsw.knnQuery(query.data(), labels.data(), distances.data(), pointers.data(), K);
+        for (auto label: labels) {
+            nbFound += std::count(expected.begin(), expected.end(), label);
+        }
+        queries.push_back(query);
+        expected_labels.push_back(labels);
+    }
+    const auto recall = (float) nbFound / (queries.size() * K);
+    CAPTURE(recall);
+    REQUIRE(recall > 0.95f);
+
+    for (auto use_mmap: {false, true}) {
+        CAPTURE(use_mmap);
+        auto loaded = Index<float>(Euclidean, dim, Int8Symmetric);
+        loaded.loadIndex(indexPath);
+        loaded.setEf(100);
+        REQUIRE_THROWS(loaded.loadRerankVectors(vectorsPath, use_mmap));
+        // Vectors must be loaded in the precision they were saved with
+        loaded.enableRerank(Float16, 100);
+        REQUIRE_THROWS(loaded.loadRerankVectors(vectorsPath, use_mmap));
+        loaded.enableRerank(Float32, 100);
+        loaded.loadRerankVectors(vectorsPath, use_mmap);
+        for (size_t q = 0; q < queries.size(); q++) {
+            std::vector<size_t> labels(K);
+            std::vector<float> distances(K);
+            std::vector<float*> pointers(K);
+            loaded.knnQuery(queries[q].data(), labels.data(), distances.data(), pointers.data(), K);
+            REQUIRE_EQ(expected_labels[q], labels);
+        }
+        if (use_mmap) {
+            REQUIRE_THROWS(loaded.addItem(vectors[0].data(), nbItems));
+        }
+    }
+}
@@ -0,0 +1,189 @@
+#include "common.h"
+#include <thread>
+
+static std::vector<std::vector<float>> get_clustered_vectors(size_t nb_vectors, size_t dim, size_t nb_clusters) {
+    std::vector<std::vector<float>> centers(nb_clusters, std::vector<float>(dim));
+    for (auto &center: centers) {
+        for (auto &component: center) component = get_random_float(-1, 1);
+    }
+    std::vector<std::vector<float>> vectors;
+    for (size_t i = 0; i < nb_vectors; i++) {
+        std::vector<float> vector(centers[i % nb_clusters]);
+        for (auto &component: vector) component += get_random_float(-0.1, 0.1);
+        vectors.push_back(vector);
+    }
+    return vectors;
+}
+
+TEST_CASE("PQ distances should match distances between decoded vectors") {
+    srand(seed);
+    // Uneven sub-spaces when m doesn't divide the dimension
+    for (auto dim: {16, 22}) {
+        for (auto inner_product: {false, true}) {
+            CAPTURE(dim);
+            CAPTURE(inner_product);
+            hnswlib::PQSpace space(dim, inner_product);
+            const auto m = space.get_data_size();
+            REQUIRE_EQ(dim / 4, m);
+            REQUIRE(space.needs_initialization());
+            const auto vectors = get_clustered_vectors(1000, dim, 20);
+            for (const auto &vector: vectors) {
+                space.train(vector.data());
+            }
+            REQUIRE_FALSE(space.needs_initialization());
+            space.complete_training();
+            const auto params = static_cast<const hnswlib::PQParams *>(space.get_dist_func_param());
+            REQUIRE_THROWS(space.train(vectors[0].data()));
+
+            const auto exact_func = inner_product ? hnswlib::InnerProductSpace<float>(dim).get_dist_func()
+                                                  : hnswlib::L2Space<float>(dim).get_dist_func();
+            const size_t dim_param = dim;
+            std::vector<uint8_t> code1(m), code2(m);
+            std::vector<float> decoded1(dim), decoded2(dim);
+            std::vector<char> query_buffer;
+            for (size_t i = 0; i + 1 < 100; i++) {
+                hnswlib::encode_pq_vector(vectors[i].data(), code1.data(), params);
+                hnswlib::encode_pq_vector(vectors[i + 1].data(), code2.data(), params);
+                hnswlib::decode_pq_vector(code1.data(), decoded1.data(), params);
+                hnswlib::decode_pq_vector(code2.data(), decoded2.data(), params);
+
+                // Reconstruction within the spread of the clusters
+                const auto error = hnswlib::L2Space<float>(dim).get_dist_func()(vectors[i].data(), decoded1.data(), &dim_param);
+                REQUIRE(error < dim * 0.01f);
+
+                const auto sdc = space.get_dist_func()(code1.data(), code2.data(), params);
+                REQUIRE(sdc == doctest::Approx(exact_func(decoded1.data(), decoded2.data(), &dim_param)).epsilon(1e-4));
+
+                const auto query = space.prepare_query(vectors[i].data(), query_buffer);
+                const auto adc = space.get_search_dist_func()(query, code2.data(), params);
+                REQUIRE(adc == doctest::Approx(exact_func(vectors[i].data(), decoded2.data(), &dim_param)).epsilon(1e-4));
+            }
+        }
+    }
+}
+
+TEST_CASE("PQ indices should find neighbours and persist their codebooks") {
+    const int M = 16;
+    const int efConstruction = 100;
+    const size_t nbItems = 2000;
+    const size_t K = 10;
+    const size_t dim = 32;
+    srand(seed);
+
+    for (auto distance: {Euclidean, InnerProduct}) {
+        CAPTURE(distance);
+        const auto vectors = get_clustered_vectors(nbItems, dim, 50);
+        auto reference = Index<float>(distance, dim, Float32);
+        reference.initNewIndex(nbItems, M, efConstruction, seed);
+        reference.enableBruteforceSearch();
+        auto hnsw = Index<float>(distance, dim, PQ);
+        REQUIRE(hnsw.space->needs_initialization());
+        hnsw.initNewIndex(nbItems, M, efConstruction, seed);
+        hnsw.setEf(100);
+        for (const auto &vector: vectors) {
+            hnsw.space->train(vector.data());
+        }
+        for (size_t id = 0; id < nbItems; id++) {
+            reference.addItem(const_cast<float *>(vectors[id].data()), id);
+            hnsw.addItem(const_cast<float *>(vectors[id].data()), id);
+        }
+        REQUIRE_EQ(dim / 4, hnsw.space->get_data_size());
+
+        // Recall of the PQ graph against exhaustive search on the original vectors
+        const size_t nbQueries = 50;
+        const auto queries = get_clustered_vectors(nbQueries, dim, 50);
+        std::vector<std::vector<size_t>> results;
+        size_t nbFound = 0;
+        for (const auto &query: queries) {
+            std::vector<size_t> expected(K), labels(K);
+            std::vector<float> distances(K);
+            std::vector<float*> pointers(K);
+            reference.knnQuery<true>(const_cast<float *>(query.data()), expected.data(), distances.data(), pointers.data(), K);
+            hnsw.knnQuery(const_cast<float *>(query.data()), labels.data(), distances.data(), pointers.data(), K);
+            for (auto label: labels) {
+                nbFound += std::count(expected.begin(), expected.end(), label);
+            }
+            results.push_back(labels);
+        }
+        const auto recall = (float) nbFound / (nbQueries * K);
+        CAPTURE(recall);
+        // Items of the right cluster picked at random would give 0.25
+        REQUIRE(recall > 0.4f);
+
+        // Codebooks are saved with the index, the loaded index serves the same results
+        const auto indexPath = "./hnsw-pq.bin";
+        hnsw.saveIndex(indexPath);
+        auto loaded = Index<float>(distance, dim, PQ);
+        loaded.loadIndex(indexPath);
+        REQUIRE_FALSE(loaded.space->needs_initialization());
+        loaded.setEf(100);
+        for (size_t q = 0; q < nbQueries; q++) {
+            std::vector<size_t> labels(K);
+            std::vector<float> distances(K);
+            std::vector<float*> pointers(K);
+            loaded.knnQuery(const_cast<float *>(queries[q].data()), labels.data(), distances.data(), pointers.data(), K);
+            REQUIRE_EQ(results[q], labels);
+        }
+
+        // Float32 indices are trained on and encoded when loaded as PQ
+        const auto float32Path = "./hnsw-pq-float32.bin";
+        reference.saveIndex(float32Path);
+        auto encoded = Index<float>(distance, dim, PQ);
+        encoded.loadIndex(float32Path);
+        REQUIRE_FALSE(encoded.space->needs_initialization());
+        REQUIRE_EQ(nbItems, encoded.getNbItems());
+        std::vector<size_t> labels(K);
+        std::vector<float> distances(K);
+        std::vector<float*> pointers(K);
+        encoded.knnQuery(const_cast<float *>(vectors[0].data()), labels.data(), distances.data(), pointers.data(), K);
+        // Items are assigned to clusters round robin, neighbours come from the cluster of the query
+        for (auto label: labels) {
+            REQUIRE_EQ(0, label % 50);
+        }
+    }
+}
+
+TEST_CASE("PQ codebooks should be fit once when threads add their first items together") {
+    const size_t nbItems = 1000;
+    const size_t dim = 32;
+    const size_t m = 4;
+    const size_t nbThreads = 4;
+    srand(seed);
+
+    const auto vectors = get_clustered_vectors(nbItems, dim, 20);
+    auto hnsw = Index<float>(Euclidean, dim, PQ);
+    REQUIRE_THROWS(hnsw.usePQSubspaces(0));
+    REQUIRE_THROWS(hnsw.usePQSubspaces(dim + 1));
+    hnsw.usePQSubspaces(m);
+    REQUIRE_EQ(m, hnsw.space->get_data_size());
+    for (const auto &vector: vectors) {
+        hnsw.space->train(vector.data());
+    }
+    hnsw.initNewIndex(nbItems, 16, 100, seed);
+    REQUIRE_THROWS(hnsw.usePQSubspaces(m));
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nbThreads; t++) {
+        threads.emplace_back([&hnsw, &vectors, t, nbThreads]() {
+            for (size_t id = t; id < vectors.size(); id += nbThreads) {
+                hnsw.addItem(const_cast<float *>(vectors[id].data()), id);
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    REQUIRE_EQ(nbItems, hnsw.getNbItems());
+
+    // Each item stays nearest to itself with the codebooks every thread encoded with
+    std::vector<size_t> labels(1);
+    std::vector<float> distances(1);
+    std::vector<float*> pointers(1);
+    hnsw.setEf(100);
+    size_t nbFound = 0;
+    for (size_t id = 0; id < nbItems; id += 10) {
+        hnsw.knnQuery(const_cast<float *>(vectors[id].data()), labels.data(), distances.data(), pointers.data(), 1);
+        nbFound += labels[0] % 20 == id % 20;
+    }
+    REQUIRE(nbFound > 90);
+}